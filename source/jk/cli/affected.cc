@@ -0,0 +1,233 @@
+// Copyright (c) 2020 - present, Hawtian Wang (twistoy.wang@gmail.com)
+//
+
+#include "jk/cli/affected.hh"
+
+#include <algorithm>
+#include <cstdint>
+#include <filesystem>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/strings/ascii.h"
+#include "absl/strings/str_join.h"
+#include "args.hxx"
+#include "fmt/format.h"
+#include "jk/cli/loader.hh"
+#include "jk/common/path.hh"
+#include "jk/core/error.h"
+#include "jk/core/executor/script.hh"
+#include "jk/core/models/build_package.hh"
+#include "jk/core/models/build_package_factory.hh"
+#include "jk/core/models/build_rule_factory.hh"
+#include "jk/core/models/helpers.hh"
+#include "jk/core/models/rule_graph.hh"
+#include "jk/core/models/session.hh"
+#include "jk/impls/actions.hh"
+#include "jk/impls/rules/cc_library.hh"
+#include "jk/impls/rules/cc_test.hh"
+#include "jk/impls/rules/proto_library.hh"
+#include "jk/impls/rules/shell_script.hh"
+#include "jk/utils/logging.hh"
+#include "range/v3/view/transform.hpp"
+
+namespace jk::cli {
+
+static auto logger = utils::Logger("cli::affected");
+
+//! Project-relative path of a file to `ObjectId` of rules owning it
+using FileOwners = absl::flat_hash_map<std::string, std::vector<uint32_t>>;
+
+//! Reverse index from files to rules.
+struct Owners {
+  //! Files and data directories listed by rules
+  FileOwners Files;
+
+  //! Package directories to all rules of the package
+  FileOwners Packages;
+};
+
+static std::string owner_key(const fs::path &file) {
+  auto p = file.lexically_normal();
+  if (!p.has_filename()) {
+    p = p.parent_path();
+  }
+  return p == "." ? "" : p.string();
+}
+
+static void add_owner(FileOwners *owners, const fs::path &file, uint32_t id) {
+  (*owners)[owner_key(file)].push_back(id);
+}
+
+//! Builds the reverse index from files to rules. A rule owns its BUILD file
+//! and the project marker, which is also the project configuration. A cc
+//! rule also owns its expanded sources, headers and the package's
+//! `nolint.txt`, which changes what is linted. A cc_test owns its `data`, and
+//! a proto_library owns the protos its protos import.
+static Owners build_owners(core::models::Session *session,
+                           core::models::BuildPackageFactory *package_factory) {
+  const auto &root = session->Project->ProjectRoot.Path;
+
+  Owners owners;
+  for (auto rule : core::models::IterAllRules(package_factory)) {
+    const auto &pkg = rule->Package->Path.Path;
+    auto id         = rule->Base->ObjectId;
+
+    add_owner(&owners.Packages, pkg, id);
+    add_owner(&owners.Files, pkg / "BUILD", id);
+    add_owner(&owners.Files, session->ProjectMarker, id);
+
+    if (auto cc = dynamic_cast<impls::rules::CCLibrary *>(rule); cc) {
+      add_owner(&owners.Files, pkg / "nolint.txt", id);
+      for (const auto &f : cc->ExpandedSourceFiles) {
+        add_owner(&owners.Files, pkg / f, id);
+      }
+      for (const auto &f : cc->ExpandedHeaderFiles) {
+        add_owner(&owners.Files, pkg / f, id);
+      }
+    } else if (auto sh = dynamic_cast<impls::rules::ShellScript *>(rule); sh) {
+      add_owner(&owners.Files, pkg / sh->Script, id);
+    }
+
+    if (auto test = dynamic_cast<impls::rules::CCTest *>(rule); test) {
+      for (const auto &f : test->Data) {
+        add_owner(&owners.Files, pkg / f, id);
+      }
+    } else if (auto proto = dynamic_cast<impls::rules::ProtoLibrary *>(rule);
+               proto) {
+      for (const auto &f : proto->ExpandedSourceFiles) {
+        for (const auto &import :
+             session->ProtoImports.TransitiveImports(root, root / pkg / f)) {
+          add_owner(&owners.Files, fs::path(import).lexically_relative(root),
+                    id);
+        }
+      }
+    }
+  }
+  return owners;
+}
+
+//! Returns rules owning project-relative `file`: rules listing it, or listing
+//! a data directory it's in. Otherwise rules of the package it's in. Returns
+//! nullptr if it's not in any loaded package.
+static const std::vector<uint32_t> *find_owners(const Owners &owners,
+                                                const fs::path &file) {
+  if (auto it = owners.Files.find(owner_key(file)); it != owners.Files.end()) {
+    return &it->second;
+  }
+
+  for (auto dir = fs::path(owner_key(file)).parent_path();;
+       dir      = dir.parent_path()) {
+    if (auto it = owners.Files.find(dir.string()); it != owners.Files.end()) {
+      return &it->second;
+    }
+    if (auto it = owners.Packages.find(dir.string());
+        it != owners.Packages.end()) {
+      return &it->second;
+    }
+    if (dir.empty()) {
+      return nullptr;
+    }
+  }
+}
+
+void Affected(args::Subparser &parser) {
+  args::ValueFlagList<std::string> files(
+      parser, "files",
+      "Changed files, relative to project root. Read from stdin if not given",
+      {"files"});
+  args::ValueFlagList<std::string> defines(
+      parser, "defines", "Defines variables used in BUILD files",
+      {'d', "defines"});
+  args::Flag old_style(parser, "old_style", "Rule pattern in old-style",
+                       {"old"});
+  args::Flag strict(parser, "strict",
+                    "Fail if any changed file is not owned by any rule",
+                    {"strict"});
+  args::PositionalList<std::string> rules_name(
+      parser, "RULE", "Rules to check, with everything they depend on");
+
+  parser.Parse();
+
+  auto session = NewSession({});
+  AddGlobalVariables(session.get(), args::get(defines));
+  auto rules_id =
+      ParseRuleIds(session.get(), args::get(rules_name), args::get(old_style));
+  if (rules_id.empty()) {
+    JK_THROW(core::JKBuildError("No rule given."));
+  }
+
+  std::vector<std::string> changed = args::get(files);
+  if (!files) {
+    std::string line;
+    while (std::getline(std::cin, line)) {
+      absl::StripAsciiWhitespace(&line);
+      if (!line.empty()) {
+        changed.push_back(std::move(line));
+      }
+    }
+  }
+
+  auto package_factory = std::make_unique<core::models::BuildPackageFactory>();
+  auto rule_factory    = std::make_unique<core::models::BuildRuleFactory>();
+  RegisterRuleTypes(rule_factory.get());
+
+  auto interp =
+      std::make_unique<core::executor::ScriptInterpreter>(session.get());
+
+  impls::LoadBuildFiles(
+      session.get(), interp.get(), package_factory.get(), rule_factory.get(),
+      rules_id | ranges::views::transform([](auto &id) -> decltype(auto) {
+        return *id.PackageName;
+      }));
+  impls::PrepareDependencies(session.get(), package_factory.get(),
+                             core::models::IterAllRules(package_factory.get()));
+  impls::PrepareRules(session.get(),
+                      core::models::IterAllRules(package_factory.get()));
+
+  auto owners = build_owners(session.get(), package_factory.get());
+
+  std::vector<uint32_t> seeds;
+  std::vector<std::string> unowned;
+  for (const auto &f : changed) {
+    fs::path p(f);
+    if (p.is_absolute()) {
+      p = fs::relative(p, session->Project->ProjectRoot.Path);
+    }
+
+    auto ids = find_owners(owners, p);
+    if (ids == nullptr) {
+      logger->warn("{} is not owned by any rule", f);
+      unowned.push_back(f);
+      continue;
+    }
+    seeds.insert(seeds.end(), ids->begin(), ids->end());
+  }
+
+  if (strict && !unowned.empty()) {
+    JK_THROW(core::JKBuildError("{} files are not owned by any rule: {}",
+                                unowned.size(), absl::StrJoin(unowned, ", ")));
+  }
+
+  std::vector<std::string> res;
+  for (auto id : session->Graph->ReverseClosure(seeds)) {
+    auto rule = session->Graph->Rule(id);
+    if (rule->Base->Type.IsCC() && rule->Base->Type.IsBinary()) {
+      res.push_back(
+          fmt::format("//{}:{}", rule->Base->PackageName, rule->Base->Name));
+    }
+  }
+
+  std::sort(res.begin(), res.end());
+  for (const auto &label : res) {
+    std::cout << label << '\n';
+  }
+  std::cout.flush();
+}
+
+}  // namespace jk::cli
+
+// vim: fdm=marker
@@ -0,0 +1,212 @@
+// Copyright (c) 2020 - present, Hawtian Wang (twistoy.wang@gmail.com)
+//
+
+#include "jk/cli/cache_exec.hh"
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "args.hxx"
+#include "fmt/format.h"
+#include "jk/common/content_store.hh"
+#include "jk/common/path.hh"
+#include "jk/common/process.hh"
+#include "jk/utils/digest.hh"
+#include "jk/utils/logging.hh"
+#include "jk/utils/str.hh"
+
+namespace jk::cli {
+
+static auto logger = utils::Logger("cache_exec");
+
+// Bump it if the layout of cached entries changed.
+static constexpr std::string_view kCacheVersion = "jk-cache-exec-2";
+
+struct CompileInvocation {
+  fs::path Object;
+  std::optional<fs::path> DepFile;
+  //! Command to get the preprocessed source
+  std::vector<std::string> PreprocessArgv;
+};
+
+//! Returns if `arg` makes the compiler write outputs we don't know about.
+static bool is_uncacheable_flag(const std::string &arg) {
+  return arg == "-ftest-coverage" || arg == "--coverage" ||
+         utils::StringStartsWith(arg, "-save-temps") ||
+         utils::StringStartsWith(arg, "-fdump-") || arg == "-gsplit-dwarf" ||
+         arg == "-" || arg == "-E" || arg == "-S";
+}
+
+static std::optional<CompileInvocation> parse_invocation(
+    const std::vector<std::string> &argv) {
+  CompileInvocation res;
+  bool compile_only = false;
+  bool gen_deps     = false;
+  std::optional<std::string> object;
+  std::optional<std::string> depfile;
+
+  res.PreprocessArgv.push_back(argv[0]);
+  for (size_t i = 1; i < argv.size(); i++) {
+    const auto &arg = argv[i];
+    bool has_value  = i + 1 < argv.size();
+
+    if (arg == "-c") {
+      compile_only = true;
+    } else if (arg == "-o" && has_value) {
+      object = argv[++i];
+    } else if (arg == "-MD" || arg == "-MMD") {
+      gen_deps = true;
+    } else if (arg == "-MP") {
+      // only affects the depfile
+    } else if (arg == "-MF" && has_value) {
+      depfile = argv[++i];
+    } else if ((arg == "-MT" || arg == "-MQ") && has_value) {
+      ++i;
+    } else if (is_uncacheable_flag(arg)) {
+      return {};
+    } else {
+      res.PreprocessArgv.push_back(arg);
+    }
+  }
+
+  if (!compile_only || !object) {
+    return {};
+  }
+
+  res.Object = object.value();
+  if (gen_deps) {
+    // same as gcc: replace the suffix of output with '.d'
+    res.DepFile =
+        depfile ? fs::path{depfile.value()}
+                : fs::path{object.value()}.replace_extension(".d");
+  }
+  res.PreprocessArgv.push_back("-E");
+  return res;
+}
+
+//! Returns the cache key of this compile command, or empty if the command
+//! should not be cached.
+static std::optional<std::string> compute_key(
+    const std::vector<std::string> &argv, const CompileInvocation &inv) {
+  utils::Digest digest;
+  auto update = [&digest](std::string_view s) {
+    digest.Update(s).Update(std::string_view{"\0", 1});
+  };
+
+  update(kCacheVersion);
+
+  // the compiler itself, a reinstalled compiler invalidates everything
+  auto compiler = common::FindProgram(argv[0]);
+  struct stat st;
+  if (!compiler || ::stat(compiler->c_str(), &st) != 0) {
+    return {};
+  }
+  update(fs::absolute(*compiler).string());
+  update(std::to_string(st.st_size));
+  update(std::to_string(st.st_mtime));
+
+  // debug info records the working directory
+  update(fs::current_path().string());
+
+  // normalized command line: make leaves empty words when variables are empty
+  for (const auto &arg : argv) {
+    if (!arg.empty()) {
+      update(arg);
+    }
+  }
+
+  // preprocessed source, covers all included headers
+  auto rc = common::RunProcess(inv.PreprocessArgv, [&digest](auto chunk) {
+    digest.Update(chunk);
+  });
+  if (rc != 0) {
+    return {};
+  }
+
+  return digest.HexDigest();
+}
+
+//! Writes output of the compiler into stderr, where diagnostics are
+//! expected.
+static void print_diagnostics(const fs::path &diagnostics) {
+  std::ifstream ifs(diagnostics, std::ios::binary);
+  if (ifs.peek() != std::ifstream::traits_type::eof()) {
+    std::cerr << ifs.rdbuf();
+  }
+}
+
+void CacheExec(args::Subparser &parser) {
+  args::ValueFlag<std::string> cache_dir(parser, "cache_dir",
+                                         "Directory of the compile cache",
+                                         {"cache-dir"});
+  args::ValueFlag<uint64_t> max_size(
+      parser, "max_size", "Max size of the compile cache in MiB",
+      {"max-size"}, 5120);
+  args::PositionalList<std::string> command_args(
+      parser, "COMMAND", "Compile command, after '--'.");
+
+  parser.Parse();
+
+  std::vector<std::string> argv = args::get(command_args);
+  if (argv.empty()) {
+    JK_THROW(core::JKBuildError("No command given."));
+  }
+
+  auto inv = parse_invocation(argv);
+  if (!cache_dir || !inv) {
+    logger->debug("not cacheable, run {} directly", argv[0]);
+    common::ExecProcess(argv);
+  }
+
+  auto key = compute_key(argv, inv.value());
+  if (!key) {
+    // let the compiler report errors
+    common::ExecProcess(argv);
+  }
+
+  common::ContentStore store(args::get(cache_dir),
+                             args::get(max_size) * 1024 * 1024);
+
+  // compiler output, warnings mostly, replayed on hits as if it compiled
+  auto diagnostics = fs::path{
+      fmt::format("{}.{}.diag", inv->Object.string(), ::getpid())};
+  common::ContentStore::Files files{{"object", inv->Object},
+                                    {"diagnostics", diagnostics}};
+  if (inv->DepFile) {
+    files.emplace_back("depfile", inv->DepFile.value());
+  }
+
+  std::error_code ec;
+  fs::create_directories(inv->Object.parent_path(), ec);
+  if (store.Restore(key.value(), files)) {
+    logger->debug("cache hit: {}", inv->Object.string());
+    print_diagnostics(diagnostics);
+    fs::remove(diagnostics, ec);
+    return;
+  }
+
+  common::ProcessOptions options;
+  options.LogFile = diagnostics;
+  auto rc         = common::RunProcess(argv, options).ExitCode;
+  print_diagnostics(diagnostics);
+  if (rc != 0) {
+    fs::remove(diagnostics, ec);
+    std::exit(rc);
+  }
+
+  store.Store(key.value(), files);
+  fs::remove(diagnostics, ec);
+}
+
+}  // namespace jk::cli
+
+// vim: fdm=marker
@@ -0,0 +1,38 @@
+// Copyright (c) 2020 - present, Hawtian Wang (twistoy.wang@gmail.com)
+//
+
+#include "jk/cli/deps_log.hh"
+
+#include <string>
+
+#include "args.hxx"
+#include "jk/common/depfile.hh"
+#include "jk/core/error.h"
+#include "jk/utils/logging.hh"
+
+namespace jk::cli {
+
+void DepsLog(args::Subparser &parser) {
+  args::ValueFlag<std::string> log(
+      parser, "log", "Dependency file of all objects of a rule", {"log"});
+  args::Flag compact(parser, "compact",
+                     "Merge depfiles appended to the journal into the "
+                     "dependency file",
+                     {"compact"});
+
+  parser.Parse();
+
+  if (!log) {
+    JK_THROW(core::JKBuildError("No log given."));
+  }
+  // depfiles are appended by compile commands themselves
+  if (!compact) {
+    JK_THROW(core::JKBuildError("Only --compact is supported."));
+  }
+
+  common::CompactDepsLog(args::get(log));
+}
+
+}  // namespace jk::cli
+
+// vim: fdm=marker
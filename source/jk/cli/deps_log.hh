@@ -0,0 +1,14 @@
+// Copyright (c) 2020 - present, Hawtian Wang (twistoy.wang@gmail.com)
+//
+
+#pragma once  // NOLINT(build/header_guard)
+
+#include "args.hxx"
+
+namespace jk::cli {
+
+void DepsLog(args::Subparser &parser);
+
+}  // namespace jk::cli
+
+// vim: fdm=marker
@@ -3,272 +3,129 @@
 
 #include "jk/cli/download.hh"
 
-#include <curl/curl.h>
-#include <openssl/sha.h>
-
 #include <chrono>
 #include <cstdlib>
-#include <fstream>
 #include <iostream>
-#include <memory>
 #include <optional>
-#include <sstream>
 #include <string>
 #include <vector>
 
 #include "args.hxx"
+#include "jk/common/content_store.hh"
+#include "jk/common/download.hh"
 #include "jk/common/path.hh"
 #include "jk/core/error.h"
 #include "jk/utils/bytes.hh"
+#include "jk/utils/digest.hh"
 #include "jk/utils/logging.hh"
 #include "jk/utils/progress.hh"
 #include "jk/utils/str.hh"
 
 namespace jk::cli {
 
-static std::optional<std::string> read_proxy_settings() {
-  auto http_proxy = getenv("HTTP_PROXY");
-  if (http_proxy) {
-    return http_proxy;
-  }
-  return {};
-}
-
-static std::string sha256_hash_string(
-    unsigned char hash[SHA256_DIGEST_LENGTH]) {
-  std::ostringstream oss;
-  for (auto i = 0; i < SHA256_DIGEST_LENGTH; i++) {
-    oss << fmt::format("{:02x}", hash[i]);
-  }
-  return oss.str();
-}
-
-static std::string HashFile(const common::AbsolutePath &file,
-                            const std::string &method) {
-  if (method == "sha256") {
-    FILE *fp = fopen(file.Stringify().c_str(), "rb");
-    if (!fp) {
-      JK_THROW(core::JKBuildError("Open file {} error.", file));
-      return "";
-    }
-
-    unsigned char hash[SHA256_DIGEST_LENGTH];
-    SHA256_CTX sha256;
-    SHA256_Init(&sha256);
-    const int bufSize = 32768;
-    uint8_t *buffer   = static_cast<uint8_t *>(malloc(bufSize));
-    int bytesRead     = 0;
-    if (!buffer) {
-      JK_THROW(core::JKBuildError("Not enough memory"));
-    }
-    while ((bytesRead = fread(buffer, 1, bufSize, fp))) {
-      SHA256_Update(&sha256, buffer, bytesRead);
-    }
-    SHA256_Final(hash, &sha256);
+static auto logger = utils::Logger("download");
 
-    auto res = sha256_hash_string(hash);
-
-    fclose(fp);
-    free(buffer);
-    return res;
+//! $JK_DOWNLOAD_CACHE, or `jk/downloads` in the user's cache directory.
+static std::optional<fs::path> default_cache_dir() {
+  if (auto dir = getenv("JK_DOWNLOAD_CACHE"); dir && *dir) {
+    return fs::path{dir};
   }
-
-  JK_THROW(core::JKBuildError("Not supported."));
-}
-
-class CURLEasyGuard {
- public:
-  explicit CURLEasyGuard(CURL *easy) : Easy(easy) {
+  if (auto dir = getenv("XDG_CACHE_HOME"); dir && *dir) {
+    return fs::path{dir} / "jk" / "downloads";
   }
-
-  ~CURLEasyGuard() {
-    if (this->Easy) {
-      ::curl_easy_cleanup(this->Easy);
-    }
+  if (auto dir = getenv("HOME"); dir && *dir) {
+    return fs::path{dir} / ".cache" / "jk" / "downloads";
   }
-
-  CURLEasyGuard(const CURLEasyGuard &)            = delete;
-  CURLEasyGuard &operator=(const CURLEasyGuard &) = delete;
-
-  void release() {
-    this->Easy = nullptr;
-  }
-
- private:
-  ::CURL *Easy;
-};
-
-static void Fail(const std::string &stage, const std::string &msg) {
-  JK_THROW(core::JKBuildError("{}: {}", stage, msg));
-}
-
-static void CheckCurlResult(::CURLcode result, const std::string &msg) {
-  if (result != CURLE_OK) {
-    Fail(msg, ::curl_easy_strerror(result));
-  }
-}
-
-static size_t WriteToFileCallback(void *ptr, size_t size, size_t nmemb,
-                                  void *data) {
-  int realsize        = static_cast<int>(size * nmemb);
-  std::ofstream *fout = static_cast<std::ofstream *>(data);
-  const char *chPtr   = static_cast<char *>(ptr);
-  fout->write(chPtr, realsize);
-  return realsize;
+  return {};
 }
 
-static size_t FileCommandCurlDebugCallback(::CURL *, curl_infotype type,
-                                           char *chPtr, size_t size,
-                                           void *data) {
-  switch (type) {
-    case CURLINFO_TEXT:
-    case CURLINFO_HEADER_IN:
-    case CURLINFO_HEADER_OUT:
-      break;
-    case CURLINFO_DATA_IN:
-    case CURLINFO_DATA_OUT:
-    case CURLINFO_SSL_DATA_IN:
-    case CURLINFO_SSL_DATA_OUT: {
-      std::cout << fmt::format("[%{}bytes data]", size) << std::endl;
-    } break;
-    default:
-      break;
-  }
-  return 0;
-}
-
-static curl_off_t previous_dl = 0;
-static std::chrono::time_point<std::chrono::high_resolution_clock> start_ts =
-    std::chrono::high_resolution_clock::now();
-
-static int FileDownloadProgressCallback(void *clientp, curl_off_t dltotal,
-                                        curl_off_t dlnow, curl_off_t ultotal,
-                                        curl_off_t ulnow) {
-  utils::ProgressBar *helper = reinterpret_cast<utils::ProgressBar *>(clientp);
-
-  static_cast<void>(ultotal);
-  static_cast<void>(ulnow);
-
-  auto ts    = std::chrono::high_resolution_clock::now();
-  auto delta = dlnow - previous_dl;
-  if (delta == 0) {
-    return 0;
-  }
-
-  std::chrono::duration<double> diff = ts - start_ts;
-
-  previous_dl = dlnow;
-
-  auto speed = dlnow / diff.count();
-
-  auto msg = fmt::format("{}/{} {}/s", utils::BytesCount(dlnow),
-                         utils::BytesCount(dltotal), utils::BytesCount(speed));
-
-  helper->Print(std::cout, dlnow, dltotal, msg);
-
-  return 0;
+//! Key of the file with `checksum` in the download cache, checksums of
+//! different methods never share an entry.
+static std::string cache_key(const common::Checksum &checksum) {
+  return utils::Digest()
+      .Update(checksum.Method)
+      .Update(":")
+      .Update(checksum.Hex)
+      .HexDigest();
 }
 
 static void Download(const std::string &url, const common::AbsolutePath &output,
-                     const std::string &sha256, bool verbose, int timeout,
-                     int inactivity_timeout, uint32_t column_size) {
-  if (fs::exists(output.Path) &&
-      utils::EqualIgnoreCase(HashFile(output, "sha256"), sha256)) {
+                     const std::optional<common::Checksum> &checksum,
+                     uint32_t connections, uint32_t column_size,
+                     const std::optional<common::ContentStore> &cache) {
+  if (checksum && fs::exists(output.Path) &&
+      utils::HashFile(output.Path, checksum->Method) == checksum->Hex) {
     std::cout << "File exists" << std::endl;
     return;
   }
-  common::AssumeFolder(output.Path.parent_path());
-
-  // std::cout << "Start download..." << std::endl;
-
-  ::CURL *curl;
-  ::curl_global_init(CURL_GLOBAL_DEFAULT);
-  curl = ::curl_easy_init();
-  if (!curl) {
-    Fail("init", "Error in initializing curl.");
-  }
-
-  CURLEasyGuard guard(curl);
-  ::CURLcode res = ::curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
-  CheckCurlResult(res, "DOWNLOAD cannot set url");
-
-  // enable HTTP ERROR parsing
-  res = ::curl_easy_setopt(curl, CURLOPT_FAILONERROR, 1);
-  CheckCurlResult(res, "DOWNLOAD cannot set http failure option");
-
-  res = ::curl_easy_setopt(curl, CURLOPT_USERAGENT, "curl/" LIBCURL_VERSION);
-  CheckCurlResult(res, "DOWNLOAD cannot set user agent option");
-
-  res = ::curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, WriteToFileCallback);
-  CheckCurlResult(res, "DOWNLOAD cannot set write function");
-
-  res = ::curl_easy_setopt(curl, CURLOPT_DEBUGFUNCTION,
-                           FileCommandCurlDebugCallback);
-  CheckCurlResult(res, "DOWNLOAD cannot set debug function");
-
-  std::ofstream fout(output.Stringify(), std::ios::out | std::ios::binary);
-
-  res = ::curl_easy_setopt(curl, CURLOPT_WRITEDATA, &fout);
-  CheckCurlResult(res, "DOWNLOAD cannot set write data");
-
-  res = ::curl_easy_setopt(curl, CURLOPT_DEBUGDATA, nullptr);
-  CheckCurlResult(res, "DOWNLOAD cannot set debug data");
-
-  res = ::curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
-  CheckCurlResult(res, "DOWNLOAD cannot set follow-redirect option");
-
-  if (verbose) {
-    res = ::curl_easy_setopt(curl, CURLOPT_VERBOSE, 1);
-    CheckCurlResult(res, "DOWNLOAD cannot set verbose: ");
-  }
 
-  if (timeout > 0) {
-    res = ::curl_easy_setopt(curl, CURLOPT_TIMEOUT, timeout);
-    CheckCurlResult(res, "DOWNLOAD cannot set timeout: ");
-  }
-
-  if (inactivity_timeout > 0) {
-    // Give up if there is no progress for a long time.
-    ::curl_easy_setopt(curl, CURLOPT_LOW_SPEED_LIMIT, 1);
-    ::curl_easy_setopt(curl, CURLOPT_LOW_SPEED_TIME, inactivity_timeout);
-  }
-
-  if (auto proxy = read_proxy_settings(); proxy) {
-    ::curl_easy_setopt(curl, CURLOPT_PROXY, proxy.value().c_str());
-    CheckCurlResult(res, "DOWNLOAD catnot set proxy value");
+  // Files are keyed by their checksums, so checkouts share one copy. The lock
+  // makes concurrent builds wait for the first one, instead of downloading
+  // the same file again.
+  std::optional<common::ContentStore::EntryLock> lock;
+  auto key = checksum ? cache_key(checksum.value()) : "";
+  if (cache) {
+    lock.emplace(cache->Lock(key));
+    if (cache->Restore(key, {{"file", output.Path}})) {
+      // entries are read-only, but that doesn't stop everyone
+      if (utils::HashFile(output.Path, checksum->Method) == checksum->Hex) {
+        std::cout << "File restored from download cache" << std::endl;
+        return;
+      }
+      logger->warn("download cache of {} is corrupted, download it again",
+                   output.Stringify());
+      cache->Remove(key);
+      std::error_code ec;
+      fs::remove(output.Path, ec);
+    }
   }
 
   utils::ProgressBar bar(column_size);
+  auto start_ts    = std::chrono::steady_clock::now();
+  uint64_t started = 0;
+  bool first       = true;
+
+  common::DownloadOptions options;
+  options.Expected    = checksum;
+  options.Connections = connections;
+  options.OnProgress  = [&](uint64_t now, uint64_t total) {
+    // bytes resumed from last run don't count in speed
+    if (first) {
+      started = now;
+      first   = false;
+    }
+    std::chrono::duration<double> diff =
+        std::chrono::steady_clock::now() - start_ts;
+    auto speed = diff.count() > 0 ? (now - started) / diff.count() : 0;
 
-  res = ::curl_easy_setopt(curl, CURLOPT_NOPROGRESS, 0);
-  CheckCurlResult(res, "DOWNLOAD cannot set noprogress value");
-
-  res = ::curl_easy_setopt(curl, CURLOPT_XFERINFOFUNCTION,
-                           FileDownloadProgressCallback);
-  CheckCurlResult(res, "DOWNLOAD cannot set progress function");
-
-  res = ::curl_easy_setopt(curl, CURLOPT_XFERINFODATA,
-                           reinterpret_cast<void *>(&bar));
-  CheckCurlResult(res, "DOWNLOAD cannot set progress data");
-
-  start_ts = std::chrono::high_resolution_clock::now();
-  res      = ::curl_easy_perform(curl);
-  guard.release();
-  ::curl_easy_cleanup(curl);
+    auto msg = fmt::format("{}/{} {}/s", utils::BytesCount(now),
+                           utils::BytesCount(total), utils::BytesCount(speed));
+    bar.Print(std::cout, now, total, msg);
+  };
 
-  ::curl_global_cleanup();
-  fout.flush();
-  fout.close();
+  common::Download(url, output.Path, options);
 
-  auto actual = HashFile(output, "sha256");
-  if (!utils::EqualIgnoreCase(actual, sha256)) {
-    JK_THROW(core::JKBuildError(
-        "Sha256 mismatch, for file: {}, expect: {}, actual: {}, status: {}",
-        output, sha256, actual, ::curl_easy_strerror(res)));
+  if (cache) {
+    cache->Store(key, {{"file", output.Path}});
+    logger->debug("stored {} into download cache", output.Stringify());
   }
 }
 
 void DownloadFile(args::Subparser &parser) {
+  args::ValueFlag<uint32_t> connections(
+      parser, "connections",
+      "Max concurrent connections, if the server accepts ranges",
+      {"connections"}, 4);
+  args::ValueFlag<std::string> cache_dir(
+      parser, "cache_dir",
+      "Directory of the download cache, default to $JK_DOWNLOAD_CACHE or "
+      "~/.cache/jk/downloads",
+      {"cache-dir"});
+  args::ValueFlag<uint64_t> cache_max_size(
+      parser, "cache_max_size", "Max size of the download cache in MiB",
+      {"cache-max-size"}, 10240);
+  args::Flag no_cache(parser, "no_cache", "Don't use the download cache",
+                      {"no-cache"});
   args::PositionalList<std::string> positional(parser, "pos", "...");
   parser.Parse();
 
@@ -280,8 +137,23 @@ void DownloadFile(args::Subparser &parser) {
 
   uint32_t column_size = std::atoi(args[3].c_str());
 
-  Download(args[0], common::AbsolutePath(fs::path{args[1]}), args[2], false, 0,
-           0, column_size);
+  // `method:hex`, or hex of sha256
+  std::optional<common::Checksum> checksum;
+  if (!args[2].empty()) {
+    checksum = common::Checksum::Parse(args[2]);
+  }
+
+  // without a checksum, there is no key to find the file by
+  std::optional<common::ContentStore> cache;
+  auto dir = cache_dir ? std::optional<fs::path>{args::get(cache_dir)}
+                       : default_cache_dir();
+  if (!no_cache && dir && checksum) {
+    cache.emplace(dir.value(), args::get(cache_max_size) * 1024 * 1024,
+                  common::ContentStore::Placement::Link);
+  }
+
+  Download(args[0], common::AbsolutePath(fs::path{args[1]}), checksum,
+           args::get(connections), column_size, cache);
 }
 
 }  // namespace jk::cli
@@ -13,12 +13,11 @@
 #include <vector>
 
 #include "args.hxx"
+#include "jk/cli/loader.hh"
 #include "jk/common/counter.hh"
 #include "jk/common/path.hh"
 #include "jk/core/error.h"
 #include "jk/core/executor/script.hh"
-#include "jk/core/executor/worker_pool.hh"
-#include "jk/core/filesystem/expander.hh"
 #include "jk/core/filesystem/project.hh"
 #include "jk/core/models/build_package.hh"
 #include "jk/core/models/build_package_factory.hh"
@@ -36,12 +35,6 @@
 #include "jk/impls/compilers/makefile/root_compiler.hh"
 #include "jk/impls/compilers/makefile/shell_script_compiler.hh"
 #include "jk/impls/compilers/nop_compiler.hh"
-#include "jk/impls/rules/cc_binary.hh"
-#include "jk/impls/rules/cc_library.hh"
-#include "jk/impls/rules/cc_test.hh"
-#include "jk/impls/rules/proto_library.hh"
-#include "jk/impls/rules/shell_script.hh"
-#include "jk/impls/writers/file_writer.hh"
 #include "jk/utils/assert.hh"
 #include "jk/utils/logging.hh"
 #include "jk/utils/str.hh"
@@ -56,17 +49,6 @@ namespace jk::cli {
 
 static auto logger = utils::Logger("cli::gen");
 
-static auto release_git_version_file_content = R"(
-// Generated by JK, JK Version )" JK_VERSION
-                                               R"(//
-
-#pragma once  // NOLINT(build/header_guard)
-
-#if !defined(BUILD_TIME)
-#define BUILD_TIME __DATE__ " "  __TIME__
-#endif
-)";
-
 void Generate(args::Subparser &parser) {
   args::ValueFlag<std::string> format(parser, "FORMAT",
                                       "Output format. 'makefile' or 'ninja'",
@@ -80,81 +62,42 @@ void Generate(args::Subparser &parser) {
       parser, "extra_flags", "Define extra flags", {'e', "extra"});
   args::Flag old_style(parser, "old_style", "Rule pattern in old-style",
                        {"old"});
+  args::ValueFlagList<std::string> build_types(
+      parser, "build_type",
+      "Only generate given build types, others will be generated on demand",
+      {"build-type"});
+  args::Flag unity(parser, "unity", "Merge sources into unity sources",
+                   {"unity"});
+  args::ValueFlag<uint32_t> unity_batch(
+      parser, "unity_batch", "Sources per unity source, used with --unity",
+      {"unity-batch"}, 8);
 
   args::PositionalList<std::string> rules_name(parser, "RULE", "Rules...");
 
   parser.Parse();
 
-  auto session = std::make_unique<core::models::Session>();
-
-  session->Project = core::filesystem::JKProject::ResolveFrom(
-      common::AbsolutePath{fs::current_path()});
-  session->WriterFactory.reset(new impls::writers::FileWriterFactory());
-  session->Executor.reset(new core::executor::WorkerPool(10));
-  session->Executor->Start();
-  session->PatternExpander =
-      std::make_unique<core::filesystem::DefaultPatternExpander>();
+  auto session = NewSession(args::get(build_types));
   session->CompilationDatabase = std::make_unique<core::generators::Compiledb>(
       session->Project->ProjectRoot);
 
-  if (defines) {
-    for (const auto &str : args::get(defines)) {
-      std::vector<std::string> parts;
-      utils::SplitString(str, std::back_inserter(parts), '=');
-      if (parts.size() == 1) {
-        session->GlobalVariables[parts[0]] = "";
-      } else {
-        session->GlobalVariables[parts[0]] = parts[1];
-      }
-    }
-  }
+  AddGlobalVariables(session.get(), args::get(defines));
 
   if (extra_flags) {
     session->ExtraFlags = args::get(extra_flags);
   }
+
+  session->UnityBuild        = args::get(unity);
+  session->DefaultUnityBatch = args::get(unity_batch);
   auto output_format = args::get(format);
 
-  std::vector<core::models::BuildRuleId> rules_id;
-  if (args::get(old_style)) {
-    session->ProjectMarker = "BLADE_ROOT";
-
-    for (const auto &str : rules_name) {
-      if (!utils::StringEndsWith(str, "BUILD")) {
-        JK_THROW(core::JKBuildError("Only support rule file named 'BUILD'."));
-      }
-
-      auto id = core::models::ParseIdString(fmt::format("//{}:...", str));
-      utils::assertion::boolean.expect(
-          id.Position == core::models::RuleRelativePosition::kAbsolute,
-          "Only absolute rule is allowed in command-line.");
-      assert(id.Position == core::models::RuleRelativePosition::kAbsolute);
-      rules_id.push_back(std::move(id));
-    }
-  } else {
-    for (const auto &str : rules_name) {
-      auto id = core::models::ParseIdString(str);
-      utils::assertion::boolean.expect(
-          id.Position == core::models::RuleRelativePosition::kAbsolute,
-          "Only absolute rule is allowed in command-line.");
-      rules_id.push_back(std::move(id));
-    }
-  }
+  auto rules_id =
+      ParseRuleIds(session.get(), args::get(rules_name), args::get(old_style));
 
   auto package_factory  = std::make_unique<core::models::BuildPackageFactory>();
   auto rule_factory     = std::make_unique<core::models::BuildRuleFactory>();
   auto compiler_factory = std::make_unique<impls::compilers::CompilerFactory>();
 
-  rule_factory->AddSimpleCreator<impls::rules::CCLibrary>("cc_library");
-  rule_factory->AddSimpleCreator<impls::rules::CCBinary>("cc_binary");
-  rule_factory->AddSimpleCreator<impls::rules::CCTest>("cc_test");
-  rule_factory->AddSimpleCreator<impls::rules::ShellScript>("shell_script");
-  rule_factory->AddSimpleCreator<impls::rules::ProtoLibrary>("proto_library");
-
-  core::executor::ScriptInterpreter::AddFunc("cc_library");
-  core::executor::ScriptInterpreter::AddFunc("cc_binary");
-  core::executor::ScriptInterpreter::AddFunc("cc_test");
-  core::executor::ScriptInterpreter::AddFunc("proto_library");
-  core::executor::ScriptInterpreter::AddFunc("shell_script");
+  RegisterRuleTypes(rule_factory.get());
 
   compiler_factory->Register<impls::compilers::makefile::CCLibraryCompiler>(
       "makefile", "cc_library");
@@ -183,20 +126,7 @@ void Generate(args::Subparser &parser) {
 
   impls::compilers::makefile::RootCompiler root_compiler;
 
-  auto arg_rules =
-      rules_id |
-      ranges::views::transform(
-          [&](const core::models::BuildRuleId &id)
-              -> ranges::any_view<core::models::BuildRule *> {
-            auto [pkg, new_pkg] =
-                package_factory->PackageUnsafe(*id.PackageName);
-            if (id.RuleName == "...") {
-              // all
-              return pkg->IterRules();
-            }
-            return ranges::views::single(pkg->RulesMap[id.RuleName].get());
-          }) |
-      ranges::views::join | ranges::to_vector;
+  auto arg_rules = ResolveRules(package_factory.get(), rules_id);
 
   root_compiler.Compile(session.get(), scc, arg_rules);
 
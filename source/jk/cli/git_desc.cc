@@ -0,0 +1,38 @@
+// Copyright (c) 2020 - present, Hawtian Wang (twistoy.wang@gmail.com)
+//
+
+#include "jk/cli/git_desc.hh"
+
+#include <string>
+
+#include "args.hxx"
+#include "jk/common/version_stamp.hh"
+#include "jk/core/error.h"
+#include "jk/utils/logging.hh"
+
+namespace jk::cli {
+
+static auto logger = utils::Logger("cli::git_desc");
+
+void GitDesc(args::Subparser &parser) {
+  args::ValueFlag<std::string> output(
+      parser, "output", "Make fragment to write", {"output"});
+  args::ValueFlag<std::string> dir(parser, "dir",
+                                   "Directory in the git repository", {"dir"},
+                                   ".");
+
+  parser.Parse();
+
+  if (!output) {
+    JK_THROW(core::JKBuildError("No output given."));
+  }
+
+  auto git_desc = common::GitDescribe(args::get(dir));
+  if (common::WriteGitDescFragment(args::get(output), git_desc)) {
+    logger->debug("update {}, git desc: {}", args::get(output), git_desc);
+  }
+}
+
+}  // namespace jk::cli
+
+// vim: fdm=marker
@@ -7,12 +7,21 @@
 
 #include "args.hxx"
 #include "fmt/core.h"
+#include "jk/cli/affected.hh"
+#include "jk/cli/cache_exec.hh"
 #include "jk/cli/cli.hh"
+#include "jk/cli/deps_log.hh"
 #include "jk/cli/download.hh"
 #include "jk/cli/echo_color.hh"
 #include "jk/cli/gen.hh"
+#include "jk/cli/git_desc.hh"
+#include "jk/cli/lint_files.hh"
+#include "jk/cli/pool_exec.hh"
 #include "jk/cli/progress.hh"
+#include "jk/cli/proto_imports.hh"
+#include "jk/cli/query.hh"
 #include "jk/cli/rm.hh"
+#include "jk/cli/run_test.hh"
 #include "jk/cli/_parse.hh"
 #include "jk/version.h"
 
@@ -34,6 +43,22 @@ Cli::Cli() {
   NewSubCommand("download", "Download file...", &DownloadFile);
   NewSubCommand("delete_file", "Delete files...", &RmFiles);
   NewSubCommand("_parse", "Internal parse file", &_Parse);
+  NewSubCommand("cache_exec", "Run compile command with local cache...",
+                &CacheExec);
+  NewSubCommand("test", "Run tests concurrently...", &RunTests);
+  NewSubCommand("pool_exec", "Run command in a limited job pool...",
+                &PoolExec);
+  NewSubCommand("lint_files", "Lint files with cache...", &LintFiles);
+  NewSubCommand("query", "Query dependencies between rules...", &Query);
+  NewSubCommand("git_desc", "Write git describe into a make fragment...",
+                &GitDesc);
+  NewSubCommand("deps_log", "Merge depfiles into dependency file of a rule...",
+                &DepsLog);
+  NewSubCommand("proto_imports",
+                "Write imported protos into a make fragment...",
+                &ProtoImports);
+  NewSubCommand("affected", "Print binaries and tests affected by files...",
+                &Affected);
   // Add commands
 }
 
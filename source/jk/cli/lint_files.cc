@@ -0,0 +1,135 @@
+// Copyright (c) 2020 - present, Hawtian Wang (twistoy.wang@gmail.com)
+//
+
+#include "jk/cli/lint_files.hh"
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <future>
+#include <iostream>
+#include <iterator>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "args.hxx"
+#include "fmt/format.h"
+#include "jk/common/content_store.hh"
+#include "jk/common/lint.hh"
+#include "jk/common/path.hh"
+#include "jk/common/process.hh"
+#include "jk/core/executor/worker_pool.hh"
+#include "jk/utils/str.hh"
+
+namespace jk::cli {
+
+//! Files passed to one cpplint process.
+static constexpr size_t kBatchSize = 64;
+
+static std::vector<std::string> cpplint_argv(const std::string &cpplint) {
+  if (utils::StringEndsWith(cpplint, ".py")) {
+    return {"python3", cpplint, "--quiet"};
+  }
+  return {cpplint, "--quiet"};
+}
+
+static void print_log(const fs::path &log_file) {
+  std::ifstream ifs(log_file);
+  std::cerr << ifs.rdbuf();
+}
+
+void LintFiles(args::Subparser &parser) {
+  args::ValueFlag<std::string> cpplint(parser, "cpplint", "Path of cpplint",
+                                       {"cpplint"}, "cpplint");
+  args::ValueFlag<std::string> cache_dir(parser, "cache_dir",
+                                         "Directory of the lint cache",
+                                         {"cache-dir"});
+  args::ValueFlag<std::string> log_dir_arg(
+      parser, "log_dir", "Directory of cpplint logs", {"log-dir"},
+      fs::temp_directory_path().string());
+  args::ValueFlag<uint64_t> max_size(parser, "max_size",
+                                     "Max size of the lint cache in MiB",
+                                     {"max-size"}, 64);
+  args::ValueFlag<uint32_t> jobs(parser, "jobs",
+                                 "Number of concurrent cpplint processes",
+                                 {'j', "jobs"},
+                                 std::thread::hardware_concurrency());
+  args::PositionalList<std::string> files_arg(parser, "FILE",
+                                              "Files to lint, after '--'.");
+
+  parser.Parse();
+
+  const auto &linter = args::get(cpplint);
+  std::optional<common::ContentStore> store;
+  if (cache_dir) {
+    store.emplace(args::get(cache_dir), args::get(max_size) * 1024 * 1024);
+  }
+
+  auto batches = common::MakeLintBatches(args::get(files_arg), linter,
+                                         store ? &store.value() : nullptr,
+                                         kBatchSize);
+  if (batches.empty()) {
+    return;
+  }
+
+  // lint commands of many rules may run at the same time
+  auto log_dir = fs::path(args::get(log_dir_arg)) /
+                 fmt::format("jk-lint-{}", static_cast<int>(::getpid()));
+  fs::create_directories(log_dir);
+  for (size_t i = 0; i < batches.size(); i++) {
+    batches[i].LogFile = log_dir / fmt::format("{}.log", i);
+  }
+
+  std::vector<std::future<int>> futures;
+  {
+    core::executor::WorkerPool pool(
+        std::max<uint32_t>(std::min<uint32_t>(args::get(jobs), batches.size()),
+                           1u));
+    pool.Start();
+
+    for (const auto &batch : batches) {
+      futures.push_back(pool.Push([&linter, &batch]() {
+        auto argv = cpplint_argv(linter);
+        std::copy(std::begin(batch.Files), std::end(batch.Files),
+                  std::back_inserter(argv));
+
+        common::ProcessOptions options;
+        options.LogFile = batch.LogFile;
+        return common::RunProcess(argv, options).ExitCode;
+      }));
+    }
+
+    for (auto &f : futures) {
+      f.wait();
+    }
+  }
+
+  bool failed = false;
+  for (size_t i = 0; i < batches.size(); i++) {
+    const auto &batch = batches[i];
+    auto rc           = futures[i].get();
+
+    if (rc != 0) {
+      failed = true;
+      print_log(batch.LogFile);
+    }
+    if (store) {
+      common::StoreLintResults(batch, rc, store.value());
+    }
+  }
+
+  std::error_code ec;
+  fs::remove_all(log_dir, ec);
+
+  if (failed) {
+    std::exit(1);
+  }
+}
+
+}  // namespace jk::cli
+
+// vim: fdm=marker
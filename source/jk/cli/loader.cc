@@ -0,0 +1,173 @@
+// Copyright (c) 2020 - present, Hawtian Wang (twistoy.wang@gmail.com)
+//
+
+#include "jk/cli/loader.hh"
+
+#include <cassert>
+#include <filesystem>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include "absl/strings/ascii.h"
+#include "fmt/format.h"
+#include "jk/common/path.hh"
+#include "jk/core/error.h"
+#include "jk/core/executor/script.hh"
+#include "jk/core/executor/worker_pool.hh"
+#include "jk/core/filesystem/expander.hh"
+#include "jk/core/filesystem/project.hh"
+#include "jk/core/models/build_package.hh"
+#include "jk/impls/rules/cc_binary.hh"
+#include "jk/impls/rules/cc_library.hh"
+#include "jk/impls/rules/cc_test.hh"
+#include "jk/impls/rules/proto_library.hh"
+#include "jk/impls/rules/shell_script.hh"
+#include "jk/impls/writers/file_writer.hh"
+#include "jk/utils/assert.hh"
+#include "jk/utils/str.hh"
+
+namespace jk::cli {
+
+std::unique_ptr<core::models::Session> NewSession(
+    const std::vector<std::string> &build_types) {
+  auto session = std::make_unique<core::models::Session>();
+
+  session->Project = core::filesystem::JKProject::ResolveFrom(
+      common::AbsolutePath{fs::current_path()});
+  session->WriterFactory.reset(new impls::writers::FileWriterFactory());
+  session->Executor.reset(new core::executor::WorkerPool(10));
+  session->Executor->Start();
+  session->PatternExpander =
+      std::make_unique<core::filesystem::DefaultPatternExpander>();
+
+  std::unordered_set<std::string> wanted_build_types;
+  for (const auto &build_type : build_types) {
+    // throws if not defined
+    wanted_build_types.insert(
+        session->Project->Config()
+            .BuildType(absl::AsciiStrToUpper(build_type))
+            .name);
+  }
+
+  session->BuildTypes.clear();
+  for (const auto &type_config : session->Project->Config().build_types) {
+    if (wanted_build_types.empty() ||
+        wanted_build_types.contains(type_config.name)) {
+      session->BuildTypes.push_back(type_config.name);
+    }
+  }
+
+  return session;
+}
+
+void AddGlobalVariables(core::models::Session *session,
+                        const std::vector<std::string> &defines) {
+  for (const auto &str : defines) {
+    std::vector<std::string> parts;
+    utils::SplitString(str, std::back_inserter(parts), '=');
+    if (parts.size() == 1) {
+      session->GlobalVariables[parts[0]] = "";
+    } else {
+      session->GlobalVariables[parts[0]] = parts[1];
+    }
+  }
+}
+
+std::vector<core::models::BuildRuleId> ParseRuleIds(
+    core::models::Session *session, const std::vector<std::string> &names,
+    bool old_style) {
+  std::vector<core::models::BuildRuleId> rules_id;
+  if (old_style) {
+    session->ProjectMarker = "BLADE_ROOT";
+
+    for (const auto &str : names) {
+      if (!utils::StringEndsWith(str, "BUILD")) {
+        JK_THROW(core::JKBuildError("Only support rule file named 'BUILD'."));
+      }
+
+      auto id = core::models::ParseIdString(fmt::format("//{}:...", str));
+      utils::assertion::boolean.expect(
+          id.Position == core::models::RuleRelativePosition::kAbsolute,
+          "Only absolute rule is allowed in command-line.");
+      assert(id.Position == core::models::RuleRelativePosition::kAbsolute);
+      rules_id.push_back(std::move(id));
+    }
+  } else {
+    for (const auto &str : names) {
+      auto id = core::models::ParseIdString(str);
+      utils::assertion::boolean.expect(
+          id.Position == core::models::RuleRelativePosition::kAbsolute,
+          "Only absolute rule is allowed in command-line.");
+      rules_id.push_back(std::move(id));
+    }
+  }
+  return rules_id;
+}
+
+std::vector<core::models::BuildRuleId> AllPackagesRuleIds(
+    core::models::Session *session) {
+  const auto &root = session->Project->ProjectRoot.Path;
+  std::vector<core::models::BuildRuleId> rules_id;
+  for (auto it = fs::recursive_directory_iterator(
+           root, fs::directory_options::skip_permission_denied);
+       it != fs::recursive_directory_iterator(); ++it) {
+    if (!it->is_directory()) {
+      continue;
+    }
+    if (utils::StringStartsWith(it->path().filename().string(), ".") ||
+        it->path() == session->Project->BuildRoot.Path) {
+      it.disable_recursion_pending();
+      continue;
+    }
+    if (fs::exists(it->path() / "BUILD")) {
+      rules_id.push_back(core::models::ParseIdString(fmt::format(
+          "//{}:...", fs::relative(it->path(), root).string())));
+    }
+  }
+  return rules_id;
+}
+
+std::vector<core::models::BuildRule *> ResolveRules(
+    core::models::BuildPackageFactory *package_factory,
+    const std::vector<core::models::BuildRuleId> &rules_id) {
+  std::vector<core::models::BuildRule *> res;
+  for (const auto &id : rules_id) {
+    auto [pkg, new_pkg] = package_factory->PackageUnsafe(*id.PackageName);
+    if (id.RuleName == "...") {
+      // all
+      for (auto rule : pkg->IterRules()) {
+        res.push_back(rule);
+      }
+      continue;
+    }
+
+    auto it = pkg->RulesMap.find(id.RuleName);
+    if (it == pkg->RulesMap.end()) {
+      JK_THROW(core::JKBuildError("No rule named '{}' in package '{}'",
+                                  id.RuleName, id.PackageName.value()));
+    }
+    res.push_back(it->second.get());
+  }
+  return res;
+}
+
+void RegisterRuleTypes(core::models::BuildRuleFactory *rule_factory) {
+  rule_factory->AddSimpleCreator<impls::rules::CCLibrary>("cc_library");
+  rule_factory->AddSimpleCreator<impls::rules::CCBinary>("cc_binary");
+  rule_factory->AddSimpleCreator<impls::rules::CCTest>("cc_test");
+  rule_factory->AddSimpleCreator<impls::rules::ShellScript>("shell_script");
+  rule_factory->AddSimpleCreator<impls::rules::ProtoLibrary>("proto_library");
+
+  core::executor::ScriptInterpreter::AddFunc("cc_library");
+  core::executor::ScriptInterpreter::AddFunc("cc_binary");
+  core::executor::ScriptInterpreter::AddFunc("cc_test");
+  core::executor::ScriptInterpreter::AddFunc("proto_library");
+  core::executor::ScriptInterpreter::AddFunc("shell_script");
+}
+
+}  // namespace jk::cli
+
+// vim: fdm=marker
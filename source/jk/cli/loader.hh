@@ -0,0 +1,50 @@
+// Copyright (c) 2020 - present, Hawtian Wang (twistoy.wang@gmail.com)
+//
+
+#pragma once  // NOLINT(build/header_guard)
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "jk/core/models/build_package_factory.hh"
+#include "jk/core/models/build_rule.hh"
+#include "jk/core/models/build_rule_factory.hh"
+#include "jk/core/models/dependent.hh"
+#include "jk/core/models/session.hh"
+
+namespace jk::cli {
+
+//! Creates a session of the project which contains current directory.
+//! `build_types` limits build types of the session if not empty, others will
+//! be rejected if not defined in configuration.
+std::unique_ptr<core::models::Session> NewSession(
+    const std::vector<std::string> &build_types);
+
+//! Parses `NAME=VALUE` items into global variables of BUILD files.
+void AddGlobalVariables(core::models::Session *session,
+                        const std::vector<std::string> &defines);
+
+//! Parses rule ids given in command-line. Old style only accepts paths of
+//! BUILD files.
+std::vector<core::models::BuildRuleId> ParseRuleIds(
+    core::models::Session *session, const std::vector<std::string> &names,
+    bool old_style);
+
+//! Returns `//PACKAGE:...` of every package in the project, directories
+//! with a BUILD file. Hidden directories and the build root are skipped.
+std::vector<core::models::BuildRuleId> AllPackagesRuleIds(
+    core::models::Session *session);
+
+//! Returns loaded rules of `rules_id`, rule name `...` means all rules in the
+//! package.
+std::vector<core::models::BuildRule *> ResolveRules(
+    core::models::BuildPackageFactory *package_factory,
+    const std::vector<core::models::BuildRuleId> &rules_id);
+
+//! Registers all builtin rule types, and their functions in BUILD files.
+void RegisterRuleTypes(core::models::BuildRuleFactory *rule_factory);
+
+}  // namespace jk::cli
+
+// vim: fdm=marker
@@ -0,0 +1,118 @@
+// Copyright (c) 2020 - present, Hawtian Wang (twistoy.wang@gmail.com)
+//
+
+#include "jk/cli/pool_exec.hh"
+
+#include <fcntl.h>
+#include <sys/file.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "args.hxx"
+#include "jk/common/path.hh"
+#include "jk/common/process.hh"
+#include "jk/core/error.h"
+#include "jk/utils/logging.hh"
+
+namespace jk::cli {
+
+static auto logger = utils::Logger("pool_exec");
+
+//! Returns physical memory in MiB, 0 if unknown.
+static uint64_t physical_memory() {
+  std::ifstream ifs("/proc/meminfo");
+  std::string key;
+  uint64_t value;
+  std::string unit;
+  while (ifs >> key >> value >> unit) {
+    if (key == "MemTotal:") {
+      return value / 1024;
+    }
+  }
+  return 0;
+}
+
+static int open_slot(const fs::path &pool_dir, uint32_t index) {
+  auto slot = pool_dir / std::to_string(index);
+  // no O_CLOEXEC, the lock should be held by the command we exec
+  int fd = ::open(slot.c_str(), O_RDWR | O_CREAT, 0644);
+  if (fd < 0) {
+    JK_THROW(core::JKBuildError("open {} failed: {}", slot.string(),
+                                strerror(errno)));
+  }
+  return fd;
+}
+
+//! Takes one of `slots` slots in `pool_dir`, the slot is released when this
+//! process (or the command replaced it) exits.
+static void acquire_slot(const fs::path &pool_dir, uint32_t slots) {
+  std::vector<int> fds;
+  for (uint32_t i = 0; i < slots; i++) {
+    fds.push_back(open_slot(pool_dir, i));
+  }
+
+  auto wait = std::chrono::milliseconds(10);
+  while (true) {
+    for (uint32_t i = 0; i < slots; i++) {
+      if (::flock(fds[i], LOCK_EX | LOCK_NB) == 0) {
+        for (uint32_t j = 0; j < slots; j++) {
+          if (j != i) {
+            ::close(fds[j]);
+          }
+        }
+        logger->debug("got slot {} of {}", i, slots);
+        return;
+      }
+    }
+
+    std::this_thread::sleep_for(wait);
+    wait = std::min(wait * 2, std::chrono::milliseconds(500));
+  }
+}
+
+void PoolExec(args::Subparser &parser) {
+  args::ValueFlag<std::string> pool_dir(
+      parser, "pool_dir", "Directory holds slots of the pool", {"pool-dir"},
+      args::Options::Required);
+  args::ValueFlag<uint32_t> slots(
+      parser, "slots", "Size of the pool, 0 to decide by physical memory",
+      {"slots"}, 0);
+  args::ValueFlag<uint64_t> memory_per_slot(
+      parser, "memory_per_slot",
+      "Memory reserved for each slot in MiB, used if slots is 0",
+      {"memory-per-slot"}, 4096);
+  args::PositionalList<std::string> command_args(parser, "COMMAND",
+                                                 "Command, after '--'.");
+
+  parser.Parse();
+
+  std::vector<std::string> argv = args::get(command_args);
+  if (argv.empty()) {
+    JK_THROW(core::JKBuildError("No command given."));
+  }
+
+  uint32_t size = args::get(slots);
+  if (size == 0) {
+    auto memory = physical_memory();
+    auto per_slot = std::max<uint64_t>(args::get(memory_per_slot), 1);
+    size = std::max<uint64_t>(memory / per_slot, 1);
+    size = std::min(size, std::max(std::thread::hardware_concurrency(), 1u));
+  }
+
+  fs::create_directories(args::get(pool_dir));
+  acquire_slot(args::get(pool_dir), size);
+
+  common::ExecProcess(argv);
+}
+
+}  // namespace jk::cli
+
+// vim: fdm=marker
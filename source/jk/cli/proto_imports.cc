@@ -0,0 +1,46 @@
+// Copyright (c) 2020 - present, Hawtian Wang (twistoy.wang@gmail.com)
+//
+
+#include "jk/cli/proto_imports.hh"
+
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include "args.hxx"
+#include "jk/common/proto_imports.hh"
+#include "jk/core/error.h"
+#include "jk/utils/logging.hh"
+
+namespace jk::cli {
+
+static auto logger = utils::Logger("cli::proto_imports");
+
+void ProtoImports(args::Subparser &parser) {
+  args::ValueFlag<std::string> output(
+      parser, "output", "Make fragment to write", {"output"});
+  args::ValueFlag<std::string> root(
+      parser, "root", "Directory imports are resolved from", {"root"}, ".");
+  args::PositionalList<std::string> files(parser, "FILES", "Proto files");
+
+  parser.Parse();
+
+  if (!output) {
+    JK_THROW(core::JKBuildError("No output given."));
+  }
+
+  std::filesystem::path root_dir = args::get(root);
+  std::vector<std::filesystem::path> protos;
+  for (const auto &file : args::get(files)) {
+    protos.push_back(root_dir / file);
+  }
+
+  common::ProtoImportScanner scanner;
+  auto imports = scanner.TransitiveImports(root_dir, protos);
+  common::WriteProtoImportsFragment(args::get(output), imports);
+  logger->debug("update {}, {} imports", args::get(output), imports.size());
+}
+
+}  // namespace jk::cli
+
+// vim: fdm=marker
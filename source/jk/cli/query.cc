@@ -0,0 +1,209 @@
+// Copyright (c) 2020 - present, Hawtian Wang (twistoy.wang@gmail.com)
+//
+
+#include "jk/cli/query.hh"
+
+#include <cctype>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "args.hxx"
+#include "fmt/format.h"
+#include "jk/cli/loader.hh"
+#include "jk/core/error.h"
+#include "jk/core/executor/script.hh"
+#include "jk/core/models/build_package_factory.hh"
+#include "jk/core/models/build_rule_factory.hh"
+#include "jk/core/models/helpers.hh"
+#include "jk/core/models/rule_graph.hh"
+#include "jk/impls/actions.hh"
+#include "jk/utils/logging.hh"
+#include "nlohmann/json.hpp"
+#include "range/v3/view/transform.hpp"
+
+namespace jk::cli {
+
+static auto logger = utils::Logger("cli::query");
+
+struct QueryExpression {
+  std::string Function;
+  //! Each argument is a rule id, `...` means all rules in the package
+  std::vector<std::string> Arguments;
+};
+
+static std::string_view strip(std::string_view s) {
+  while (!s.empty() && std::isspace(s.front())) {
+    s.remove_prefix(1);
+  }
+  while (!s.empty() && std::isspace(s.back())) {
+    s.remove_suffix(1);
+  }
+  return s;
+}
+
+//! Parses `FUNCTION(ARG[, ARG]...)`
+static QueryExpression parse_expression(std::string_view expr) {
+  expr       = strip(expr);
+  auto left  = expr.find('(');
+  auto right = expr.rfind(')');
+  if (left == std::string_view::npos || right != expr.size() - 1 ||
+      right < left) {
+    JK_THROW(core::JKBuildError("Invalid query expression '{}'.", expr));
+  }
+
+  QueryExpression res;
+  res.Function = strip(expr.substr(0, left));
+
+  auto args = expr.substr(left + 1, right - left - 1);
+  while (!args.empty()) {
+    auto comma = args.find(',');
+    auto arg   = strip(args.substr(0, comma));
+    if (arg.empty()) {
+      JK_THROW(core::JKBuildError("Empty argument in query expression '{}'.",
+                                  expr));
+    }
+    res.Arguments.emplace_back(arg);
+    if (comma == std::string_view::npos) {
+      break;
+    }
+    args.remove_prefix(comma + 1);
+  }
+
+  uint32_t expected = 0;
+  if (res.Function == "deps" || res.Function == "rdeps") {
+    expected = 1;
+  } else if (res.Function == "somepath" || res.Function == "allpaths") {
+    expected = 2;
+  } else {
+    JK_THROW(core::JKBuildError("Unknown query function '{}'.", res.Function));
+  }
+  if (res.Arguments.size() != expected) {
+    JK_THROW(core::JKBuildError("Query function '{}' expects {} argument(s).",
+                                res.Function, expected));
+  }
+
+  return res;
+}
+
+static std::string label(core::models::BuildRule *rule) {
+  return fmt::format("//{}:{}", rule->Base->PackageName, rule->Base->Name);
+}
+
+void Query(args::Subparser &parser) {
+  args::ValueFlag<std::string> output(
+      parser, "output", "Output format. 'label' or 'json'", {"output"},
+      "label");
+  args::ValueFlagList<std::string> defines(
+      parser, "defines", "Defines variables used in BUILD files",
+      {'d', "defines"});
+  args::Positional<std::string> expression(
+      parser, "EXPR",
+      "deps(X), rdeps(X), somepath(X, Y) or allpaths(X, Y), where X and Y are "
+      "rule ids");
+  args::PositionalList<std::string> universe(
+      parser, "RULE",
+      "Rules loaded before querying, rdeps and allpaths only find rules "
+      "loaded. Default is all packages in the project for rdeps and "
+      "allpaths, rules in EXPR otherwise");
+
+  parser.Parse();
+
+  if (!expression) {
+    JK_THROW(core::JKBuildError("No query expression given."));
+  }
+  if (args::get(output) != "label" && args::get(output) != "json") {
+    JK_THROW(core::JKBuildError("Unknown output format '{}'.",
+                                args::get(output)));
+  }
+
+  auto expr    = parse_expression(args::get(expression));
+  auto session = NewSession({});
+  AddGlobalVariables(session.get(), args::get(defines));
+
+  std::vector<std::vector<core::models::BuildRuleId>> arguments_id;
+  for (const auto &arg : expr.Arguments) {
+    arguments_id.push_back(ParseRuleIds(session.get(), {arg}, false));
+  }
+  auto rules_id = ParseRuleIds(session.get(), args::get(universe), false);
+  // dependents are found only if loaded
+  if (rules_id.empty() &&
+      (expr.Function == "rdeps" || expr.Function == "allpaths")) {
+    rules_id = AllPackagesRuleIds(session.get());
+  }
+  for (const auto &ids : arguments_id) {
+    rules_id.insert(rules_id.end(), ids.begin(), ids.end());
+  }
+
+  auto package_factory = std::make_unique<core::models::BuildPackageFactory>();
+  auto rule_factory    = std::make_unique<core::models::BuildRuleFactory>();
+  RegisterRuleTypes(rule_factory.get());
+
+  auto interp =
+      std::make_unique<core::executor::ScriptInterpreter>(session.get());
+
+  // only dependencies are needed, rules are not prepared
+  impls::LoadBuildFiles(
+      session.get(), interp.get(), package_factory.get(), rule_factory.get(),
+      rules_id | ranges::views::transform([](auto &id) -> decltype(auto) {
+        return *id.PackageName;
+      }));
+  impls::PrepareDependencies(session.get(), package_factory.get(),
+                             core::models::IterAllRules(package_factory.get()));
+
+  std::vector<std::vector<uint32_t>> arguments;
+  for (const auto &ids : arguments_id) {
+    std::vector<uint32_t> nodes;
+    for (auto rule : ResolveRules(package_factory.get(), ids)) {
+      nodes.push_back(rule->Base->ObjectId);
+    }
+    arguments.push_back(std::move(nodes));
+  }
+
+  const auto &graph = *session->Graph;
+  auto start        = std::chrono::steady_clock::now();
+
+  std::vector<uint32_t> res;
+  if (expr.Function == "deps") {
+    res = graph.Closure(arguments[0]);
+  } else if (expr.Function == "rdeps") {
+    res = graph.ReverseClosure(arguments[0]);
+  } else if (expr.Function == "somepath") {
+    res = graph.SomePath(arguments[0], arguments[1]);
+  } else {
+    res = graph.AllPaths(arguments[0], arguments[1]);
+  }
+
+  logger->debug("{} on {} rules, {} results in {}us", expr.Function,
+                graph.Size(), res.size(),
+                std::chrono::duration_cast<std::chrono::microseconds>(
+                    std::chrono::steady_clock::now() - start)
+                    .count());
+
+  if (args::get(output) == "json") {
+    auto doc = nlohmann::json::array();
+    for (auto id : res) {
+      auto rule = graph.Rule(id);
+      doc.push_back({
+          {"label", label(rule)},
+          {"type", rule->Base->TypeName},
+      });
+    }
+    std::cout << doc.dump(2) << std::endl;
+    return;
+  }
+
+  for (auto id : res) {
+    std::cout << label(graph.Rule(id)) << '\n';
+  }
+  std::cout.flush();
+}
+
+}  // namespace jk::cli
+
+// vim: fdm=marker
@@ -3,45 +3,93 @@
 
 #include "jk/cli/rm.hh"
 
+#include <algorithm>
+#include <fstream>
+#include <future>
 #include <iostream>
+#include <mutex>
 #include <string>
+#include <vector>
 
 #include "args.hxx"
 #include "jk/common/path.hh"
+#include "jk/core/executor/worker_pool.hh"
 #include "jk/utils/str.hh"
 
 namespace jk::cli {
 
+//! Files removed by one task of the pool.
+static constexpr size_t kBatchSize = 256;
+
+static void remove_file(fs::path fp, bool silent, std::mutex *output_mutex) {
+  if (fp.is_relative()) {
+    fp = fs::current_path() / fp;
+  }
+
+  std::error_code ec;
+  auto status = fs::symlink_status(fp, ec);
+  if (ec || !fs::exists(status)) {
+    return;
+  }
+
+  std::string message;
+  if (fs::is_directory(status)) {
+    fs::remove_all(fp);
+    message = fmt::format("Deleted directory {}", fp.string());
+  } else {
+    fs::remove(fp);
+    message = fmt::format("Deleted regular file {}", fp.string());
+  }
+
+  if (!silent) {
+    std::lock_guard lk(*output_mutex);
+    std::cout << message << std::endl;
+  }
+}
+
 void RmFiles(args::Subparser &parser) {
   args::Flag silent(parser, "silent", "silent ver", {"silent"});
+  args::ValueFlagList<std::string> manifests(
+      parser, "manifest", "File listing files to be deleted, one per line.",
+      {"manifest"});
   args::PositionalList<std::string> files_args(parser, "FILES",
                                                "Files to be deleted.");
 
   parser.Parse();
 
   auto files = args::get(files_args);
+  for (const auto &manifest : args::get(manifests)) {
+    std::ifstream ifs(manifest);
+    std::string line;
+    while (std::getline(ifs, line)) {
+      if (!line.empty()) {
+        files.push_back(std::move(line));
+      }
+    }
+  }
 
-  for (const auto &file : files) {
-    auto fp = fs::path(file);
-    if (fp.is_relative()) {
-      fp = fs::current_path() / fp;
+  std::mutex output_mutex;
+  if (files.size() <= kBatchSize) {
+    for (const auto &file : files) {
+      remove_file(file, args::get(silent), &output_mutex);
     }
+    return;
+  }
 
-    if (fs::exists(fp)) {
-      if (fs::is_directory(fp)) {
-        fs::remove_all(fp);
-        if (!args::get(silent)) {
-          std::cout << fmt::format("Deleted directory {}", fp.string())
-                    << std::endl;
-        }
-      } else {
-        fs::remove(fp);
-        if (!args::get(silent)) {
-          std::cout << fmt::format("Deleted regular file {}", fp.string())
-                    << std::endl;
-        }
+  // unlinking is bound by metadata syscalls, run them concurrently
+  std::vector<std::future<void>> futures;
+  core::executor::WorkerPool pool;
+  pool.Start();
+  for (size_t begin = 0; begin < files.size(); begin += kBatchSize) {
+    auto end = std::min(files.size(), begin + kBatchSize);
+    futures.push_back(pool.Push([&, begin, end]() {
+      for (auto i = begin; i < end; i++) {
+        remove_file(files[i], args::get(silent), &output_mutex);
       }
-    }
+    }));
+  }
+  for (auto &f : futures) {
+    f.get();
   }
 }
 
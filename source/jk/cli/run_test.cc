@@ -0,0 +1,442 @@
+// Copyright (c) 2020 - present, Hawtian Wang (twistoy.wang@gmail.com)
+//
+
+#include "jk/cli/run_test.hh"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <future>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "args.hxx"
+#include "fmt/format.h"
+#include "jk/cli/loader.hh"
+#include "jk/common/content_store.hh"
+#include "jk/common/path.hh"
+#include "jk/common/process.hh"
+#include "jk/core/error.h"
+#include "jk/core/executor/script.hh"
+#include "jk/core/executor/worker_pool.hh"
+#include "jk/core/models/build_package.hh"
+#include "jk/core/models/build_package_factory.hh"
+#include "jk/core/models/build_rule_factory.hh"
+#include "jk/core/models/helpers.hh"
+#include "jk/impls/actions.hh"
+#include "jk/impls/rules/cc_test.hh"
+#include "jk/utils/digest.hh"
+#include "jk/utils/logging.hh"
+#include "range/v3/view/transform.hpp"
+
+namespace jk::cli {
+
+static auto logger = utils::Logger("cli::test");
+
+// Bump it if the layout of cached entries changed.
+static constexpr std::string_view kCacheVersion = "jk-test-cache-1";
+
+struct TestJob {
+  impls::rules::CCTest *Rule;
+  std::string Binary;
+  uint32_t ShardIndex;
+  uint32_t ShardCount;
+  std::chrono::milliseconds Timeout;
+  fs::path LogFile;
+  std::vector<std::pair<std::string, std::string>> Env;
+  //! Resolved `data` of the rule
+  std::vector<fs::path> DataFiles;
+
+  std::string Name() const {
+    if (ShardCount == 1) {
+      return Rule->Base->FullQualifiedName;
+    }
+    return fmt::format("{} (shard {}/{})", Rule->Base->FullQualifiedName,
+                       ShardIndex + 1, ShardCount);
+  }
+};
+
+struct TestResult {
+  bool Passed;
+  //! Result is restored from cache
+  bool Cached;
+  //! Why it failed
+  std::string Message;
+  common::ProcessResult Process;
+};
+
+//! Test rules in `rules` and their dependencies.
+static std::vector<impls::rules::CCTest *> collect_tests(
+    const std::vector<core::models::BuildRule *> &rules) {
+  std::vector<bool> visited(core::models::__CurrentObjectId(), false);
+  std::vector<impls::rules::CCTest *> res;
+
+  auto dfs = [&visited, &res](core::models::BuildRule *r, auto &&dfs) {
+    if (visited[r->Base->ObjectId]) {
+      return;
+    }
+    visited[r->Base->ObjectId] = true;
+    if (auto test = dynamic_cast<impls::rules::CCTest *>(r); test) {
+      res.push_back(test);
+    }
+
+    for (auto n : r->Dependencies) {
+      dfs(n, dfs);
+    }
+  };
+
+  for (auto r : rules) {
+    dfs(r, dfs);
+  }
+  return res;
+}
+
+//! Returns the cache key of `job`, covers the binary, data files and the
+//! environment. Returns empty if any input is missing.
+static std::optional<std::string> test_cache_key(const TestJob &job) {
+  utils::Digest digest;
+  auto update = [&digest](std::string_view s) {
+    digest.Update(s).Update(std::string_view{"\0", 1});
+  };
+
+  update(kCacheVersion);
+  update(utils::HashFile(job.Binary));
+
+  for (const auto &data : job.DataFiles) {
+    if (fs::is_regular_file(data)) {
+      update(data.string());
+      update(utils::HashFile(data));
+    } else if (fs::is_directory(data)) {
+      std::vector<fs::path> files;
+      for (const auto &entry : fs::recursive_directory_iterator(data)) {
+        if (entry.is_regular_file()) {
+          files.push_back(entry.path());
+        }
+      }
+      std::sort(files.begin(), files.end());
+      for (const auto &file : files) {
+        update(file.string());
+        update(utils::HashFile(file));
+      }
+    } else {
+      return {};
+    }
+  }
+
+  for (const auto &[key, value] : job.Env) {
+    update(key);
+    update(value);
+  }
+
+  return digest.HexDigest();
+}
+
+static TestResult run_test_job(const TestJob &job,
+                               const common::ContentStore *cache) {
+  TestResult res{false, false, "", {}};
+
+  if (!fs::exists(job.Binary)) {
+    res.Message = fmt::format("{} not found, build it first", job.Binary);
+    return res;
+  }
+
+  fs::create_directories(job.LogFile.parent_path());
+
+  std::optional<std::string> key;
+  if (cache != nullptr) {
+    key = test_cache_key(job);
+  }
+  if (key && cache->Restore(key.value(), {{"log", job.LogFile}})) {
+    // only passed results are cached
+    res.Passed = true;
+    res.Cached = true;
+    return res;
+  }
+
+  common::ProcessOptions options;
+  options.LogFile = job.LogFile;
+  options.Timeout = job.Timeout;
+  options.Env     = job.Env;
+
+  res.Process = common::RunProcess({job.Binary}, options);
+  if (res.Process.TimedOut) {
+    res.Message = fmt::format("timed out after {}s",
+                              job.Timeout.count() / 1000);
+  } else if (res.Process.ExitCode != 0) {
+    res.Message = fmt::format("exited with code {}", res.Process.ExitCode);
+  } else {
+    res.Passed = true;
+    if (key) {
+      cache->Store(key.value(), {{"log", job.LogFile}});
+    }
+  }
+  return res;
+}
+
+static std::string escape_xml(std::string_view raw) {
+  std::string res;
+  res.reserve(raw.size());
+  for (char ch : raw) {
+    switch (ch) {
+      case '<':
+        res += "&lt;";
+        break;
+      case '>':
+        res += "&gt;";
+        break;
+      case '&':
+        res += "&amp;";
+        break;
+      case '"':
+        res += "&quot;";
+        break;
+      default:
+        if (static_cast<unsigned char>(ch) < 0x20 && ch != '\n' &&
+            ch != '\t') {
+          // not allowed in XML 1.0
+          break;
+        }
+        res += ch;
+    }
+  }
+  return res;
+}
+
+//! Returns at most last `max_size` bytes of file `p`.
+static std::string read_tail(const fs::path &p, std::size_t max_size) {
+  std::ifstream ifs(p, std::ios::binary);
+  if (!ifs) {
+    return {};
+  }
+  ifs.seekg(0, std::ios::end);
+  auto size = static_cast<std::size_t>(ifs.tellg());
+  ifs.seekg(size > max_size ? size - max_size : 0);
+  return {std::istreambuf_iterator<char>{ifs},
+          std::istreambuf_iterator<char>{}};
+}
+
+static void write_junit(const fs::path &p, const std::vector<TestJob> &jobs,
+                        const std::vector<TestResult> &results,
+                        std::chrono::milliseconds elapsed) {
+  auto failures = std::count_if(results.begin(), results.end(),
+                                [](const auto &r) {
+                                  return !r.Passed;
+                                });
+
+  std::ofstream ofs(p);
+  if (!ofs) {
+    JK_THROW(core::JKBuildError("Could not write junit report to {}.",
+                                p.string()));
+  }
+
+  ofs << R"(<?xml version="1.0" encoding="UTF-8"?>)" << '\n';
+  ofs << fmt::format(
+      R"(<testsuites name="jk" tests="{}" failures="{}" time="{:.3f}">)",
+      jobs.size(), failures, elapsed.count() / 1000.0)
+      << '\n';
+  for (std::size_t i = 0; i < jobs.size(); i++) {
+    const auto &job    = jobs[i];
+    const auto &result = results[i];
+
+    ofs << fmt::format(
+        R"(  <testsuite name="{}" tests="1" failures="{}" time="{:.3f}">)",
+        escape_xml(job.Name()), result.Passed ? 0 : 1,
+        result.Process.Elapsed.count() / 1000.0)
+        << '\n';
+    ofs << fmt::format(
+        R"(    <testcase name="{}" classname="{}" time="{:.3f}">)",
+        escape_xml(job.Name()), escape_xml(job.Rule->Base->PackageName),
+        result.Process.Elapsed.count() / 1000.0)
+        << '\n';
+    if (!result.Passed) {
+      ofs << fmt::format(R"(      <failure message="{}">{}</failure>)",
+                         escape_xml(result.Message),
+                         escape_xml(read_tail(job.LogFile, 64 * 1024)))
+          << '\n';
+    }
+    ofs << "    </testcase>\n";
+    ofs << "  </testsuite>\n";
+  }
+  ofs << "</testsuites>\n";
+}
+
+void RunTests(args::Subparser &parser) {
+  args::ValueFlag<std::string> build_type(
+      parser, "build_type", "Build type of test binaries, default is the first",
+      {"build-type"});
+  args::ValueFlag<uint32_t> jobs(parser, "jobs", "Tests run concurrently",
+                                 {'j', "jobs"},
+                                 std::thread::hardware_concurrency());
+  args::ValueFlag<uint32_t> timeout(
+      parser, "timeout", "Default timeout of each test in seconds",
+      {"timeout"}, 300);
+  args::ValueFlag<std::string> junit(parser, "junit",
+                                     "Write a JUnit XML report to this file",
+                                     {"junit"});
+  args::Flag nocache(parser, "nocache",
+                     "Run all tests, even if a passed result is cached",
+                     {"nocache"});
+  args::ValueFlagList<std::string> defines(
+      parser, "defines", "Defines variables used in BUILD files",
+      {'d', "defines"});
+  args::Flag old_style(parser, "old_style", "Rule pattern in old-style",
+                       {"old"});
+  args::PositionalList<std::string> rules_name(parser, "RULE", "Rules...");
+
+  parser.Parse();
+
+  auto session = NewSession(
+      build_type ? std::vector<std::string>{args::get(build_type)}
+                 : std::vector<std::string>{});
+  AddGlobalVariables(session.get(), args::get(defines));
+  auto rules_id =
+      ParseRuleIds(session.get(), args::get(rules_name), args::get(old_style));
+
+  auto package_factory = std::make_unique<core::models::BuildPackageFactory>();
+  auto rule_factory    = std::make_unique<core::models::BuildRuleFactory>();
+  RegisterRuleTypes(rule_factory.get());
+
+  auto interp =
+      std::make_unique<core::executor::ScriptInterpreter>(session.get());
+
+  impls::LoadBuildFiles(
+      session.get(), interp.get(), package_factory.get(), rule_factory.get(),
+      rules_id | ranges::views::transform([](auto &id) -> decltype(auto) {
+        return *id.PackageName;
+      }));
+  impls::PrepareDependencies(session.get(), package_factory.get(),
+                             core::models::IterAllRules(package_factory.get()));
+  impls::PrepareRules(session.get(),
+                      core::models::IterAllRules(package_factory.get()));
+
+  auto tests = collect_tests(ResolveRules(package_factory.get(), rules_id));
+  const auto &test_build_type = session->BuildTypes.front();
+
+  std::vector<TestJob> test_jobs;
+  for (auto rule : tests) {
+    auto binary = rule->WorkingFolder.Sub(test_build_type, rule->Base->Name);
+    auto timeout_seconds =
+        rule->Timeout > 0 ? rule->Timeout : args::get(timeout);
+    auto package_root = session->Project->Resolve(rule->Package->Path.Path);
+
+    std::vector<fs::path> data_files;
+    for (const auto &data : rule->Data) {
+      data_files.push_back(package_root.Sub(data).Path);
+    }
+
+    for (uint32_t i = 0; i < rule->ShardCount; i++) {
+      auto env = rule->Env;
+      if (rule->ShardCount > 1) {
+        env.emplace_back("GTEST_TOTAL_SHARDS",
+                         std::to_string(rule->ShardCount));
+        env.emplace_back("GTEST_SHARD_INDEX", std::to_string(i));
+      }
+
+      test_jobs.push_back(TestJob{
+          rule,
+          binary.Stringify(),
+          i,
+          rule->ShardCount,
+          std::chrono::seconds(timeout_seconds),
+          rule->WorkingFolder.Sub(test_build_type,
+                                  fmt::format("test.{}.log", i))
+              .Path,
+          std::move(env),
+          data_files,
+      });
+    }
+  }
+
+  // sharded tests are usually the slowest ones, start them first
+  std::stable_sort(test_jobs.begin(), test_jobs.end(),
+                   [](const TestJob &lhs, const TestJob &rhs) {
+                     return lhs.ShardCount > rhs.ShardCount;
+                   });
+
+  // tests are run in the project root, same as 'make test'
+  fs::current_path(session->Project->ProjectRoot.Path);
+
+  std::optional<common::ContentStore> cache;
+  if (!args::get(nocache)) {
+    cache.emplace(session->Project->BuildRoot.Sub(".test_cache").Path,
+                  uint64_t{1024} * 1024 * 1024);
+  }
+
+  auto start = std::chrono::steady_clock::now();
+
+  std::mutex output_mutex;
+  std::vector<std::future<TestResult>> futures;
+  {
+    core::executor::WorkerPool pool(std::max(args::get(jobs), 1u));
+    pool.Start();
+
+    for (const auto &job : test_jobs) {
+      futures.push_back(pool.Push([&job, &output_mutex, &cache]() {
+        auto res = run_test_job(job, cache ? &cache.value() : nullptr);
+
+        std::lock_guard lk(output_mutex);
+        if (res.Cached) {
+          std::cout << fmt::format("[ CACHED ] {}", job.Name()) << std::endl;
+        } else if (res.Passed) {
+          std::cout << fmt::format("[ PASSED ] {} ({:.2f}s)", job.Name(),
+                                   res.Process.Elapsed.count() / 1000.0)
+                    << std::endl;
+        } else {
+          std::cout << fmt::format("[ FAILED ] {}, {}, log: {}", job.Name(),
+                                   res.Message, job.LogFile.string())
+                    << std::endl;
+        }
+        return res;
+      }));
+    }
+
+    for (auto &f : futures) {
+      f.wait();
+    }
+  }
+
+  auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+      std::chrono::steady_clock::now() - start);
+
+  std::vector<TestResult> results;
+  for (auto &f : futures) {
+    results.push_back(f.get());
+  }
+
+  if (junit) {
+    write_junit(args::get(junit), test_jobs, results, elapsed);
+  }
+
+  auto failures = std::count_if(results.begin(), results.end(),
+                                [](const auto &r) {
+                                  return !r.Passed;
+                                });
+  auto cached = std::count_if(results.begin(), results.end(),
+                              [](const auto &r) {
+                                return r.Cached;
+                              });
+  std::cout << fmt::format("{} tests, {} failed, {} cached, in {:.2f}s",
+                           results.size(), failures, cached,
+                           elapsed.count() / 1000.0)
+            << std::endl;
+
+  // stop workers of the session before leaving
+  session->Executor.reset();
+
+  if (failures > 0) {
+    std::exit(1);
+  }
+}
+
+}  // namespace jk::cli
+
+// vim: fdm=marker
@@ -0,0 +1,314 @@
+// Copyright (c) 2020 - present, Hawtian Wang (twistoy.wang@gmail.com)
+//
+
+#include "jk/common/content_store.hh"
+
+#include <fcntl.h>
+#include <linux/fs.h>
+#include <sys/file.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#include "fmt/format.h"
+#include "jk/core/error.h"
+#include "jk/utils/logging.hh"
+
+namespace jk::common {
+
+namespace fs = std::filesystem;
+
+static auto logger = utils::Logger("content_store");
+
+//! An entry takes at least a block on disk, even if its files are empty,
+//! like entries of the lint cache. Counted so they are evicted too.
+static constexpr uint64_t kMinEntrySize = 4096;
+
+//! Size of entry `entry` counted by the store.
+static uint64_t entry_size(const fs::path &entry) {
+  std::error_code ec;
+  uint64_t size = 0;
+  for (const auto &file : fs::directory_iterator(entry, ec)) {
+    size += file.file_size(ec);
+  }
+  return std::max(size, kMinEntrySize);
+}
+
+ContentStore::ContentStore(fs::path root, uint64_t max_size,
+                           Placement placement)
+    : root_(std::move(root)), max_size_(max_size), placement_(placement) {
+}
+
+ContentStore::EntryLock::EntryLock(int fd) : fd_(fd) {
+}
+
+ContentStore::EntryLock::EntryLock(EntryLock &&other) noexcept
+    : fd_(other.fd_) {
+  other.fd_ = -1;
+}
+
+ContentStore::EntryLock::~EntryLock() {
+  if (fd_ >= 0) {
+    ::close(fd_);
+  }
+}
+
+auto ContentStore::Lock(std::string_view key) const -> EntryLock {
+  std::error_code ec;
+  auto lock_file = root_ / "locks" / fmt::format("{}.lock", key);
+  fs::create_directories(lock_file.parent_path(), ec);
+
+  while (true) {
+    int fd = ::open(lock_file.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd < 0) {
+      JK_THROW(core::JKBuildError("Open lock file {} error.",
+                                  lock_file.string()));
+    }
+    while (::flock(fd, LOCK_EX) != 0) {
+      if (errno != EINTR) {
+        ::close(fd);
+        JK_THROW(
+            core::JKBuildError("Lock file {} error.", lock_file.string()));
+      }
+    }
+
+    // `Evict` may have removed the file while we were waiting, then the lock
+    // excludes nobody opening it after
+    struct stat locked {};
+    struct stat current {};
+    if (::fstat(fd, &locked) == 0 && ::stat(lock_file.c_str(), &current) == 0 &&
+        locked.st_dev == current.st_dev && locked.st_ino == current.st_ino) {
+      return EntryLock{fd};
+    }
+    ::close(fd);
+  }
+}
+
+auto ContentStore::place_file(const fs::path &from, const fs::path &to,
+                              std::error_code &ec) const -> bool {
+  if (placement_ == Placement::Link) {
+    fs::create_hard_link(from, to, ec);
+    if (!ec) {
+      return true;
+    }
+
+    // different filesystem, try to share extents at least
+    int src = ::open(from.c_str(), O_RDONLY | O_CLOEXEC);
+    int dst = src < 0 ? -1
+                      : ::open(to.c_str(), O_WRONLY | O_CREAT | O_TRUNC |
+                                               O_CLOEXEC,
+                               0644);
+    bool cloned = dst >= 0 && ::ioctl(dst, FICLONE, src) == 0;
+    if (src >= 0) {
+      ::close(src);
+    }
+    if (dst >= 0) {
+      ::close(dst);
+    }
+    if (cloned) {
+      ec.clear();
+      return true;
+    }
+  }
+  return fs::copy_file(from, to, fs::copy_options::overwrite_existing, ec);
+}
+
+auto ContentStore::entry_path(std::string_view key) const -> fs::path {
+  return root_ / key.substr(0, 2) / key;
+}
+
+auto ContentStore::Restore(std::string_view key, const Files &files) const
+    -> bool {
+  std::error_code ec;
+  auto entry = entry_path(key);
+  if (!fs::is_directory(entry, ec)) {
+    return false;
+  }
+
+  for (const auto &[name, path] : files) {
+    auto tmp = fs::path(fmt::format("{}.{}.tmp", path.string(), ::getpid()));
+    fs::create_directories(path.parent_path(), ec);
+    fs::remove(tmp, ec);
+    if (!place_file(entry / name, tmp, ec)) {
+      fs::remove(tmp, ec);
+      return false;
+    }
+    fs::rename(tmp, path, ec);
+    if (ec) {
+      fs::remove(tmp, ec);
+      return false;
+    }
+  }
+
+  // mark as recently used
+  fs::last_write_time(entry, fs::file_time_type::clock::now(), ec);
+  return true;
+}
+
+void ContentStore::Store(std::string_view key, const Files &files) const {
+  std::error_code ec;
+  auto entry = entry_path(key);
+  if (fs::exists(entry, ec)) {
+    return;
+  }
+
+  auto tmp = root_ / "tmp" / fmt::format("{}.{}", key, ::getpid());
+  fs::create_directories(tmp, ec);
+  for (const auto &[name, path] : files) {
+    if (!place_file(path, tmp / name, ec)) {
+      logger->debug("failed to store {}: {}", path.string(), ec.message());
+      fs::remove_all(tmp, ec);
+      return;
+    }
+  }
+
+  // linked files share the inode with the workspace, modifying one of them
+  // in place would corrupt the entry and every other place restored from it
+  if (placement_ == Placement::Link) {
+    for (const auto &[name, path] : files) {
+      fs::permissions(tmp / name,
+                      fs::perms::owner_write | fs::perms::group_write |
+                          fs::perms::others_write,
+                      fs::perm_options::remove, ec);
+    }
+  }
+
+  fs::create_directories(entry.parent_path(), ec);
+  fs::rename(tmp, entry, ec);
+  if (ec) {
+    // someone else published the same entry first
+    fs::remove_all(tmp, ec);
+    return;
+  }
+
+  auto size = entry_size(entry);
+
+  // walking the whole store on every write is too expensive, only do it once
+  // the counted size exceeds the limit
+  if (update_size([size](uint64_t total) {
+        return total + size;
+      }) > max_size_) {
+    Evict();
+  }
+}
+
+auto ContentStore::update_size(
+    const std::function<uint64_t(uint64_t)> &update) const -> uint64_t {
+  std::error_code ec;
+  fs::create_directories(root_, ec);
+  auto counter = root_ / "size";
+
+  int fd = ::open(counter.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+  if (fd < 0) {
+    logger->debug("failed to open {}: {}", counter.string(), strerror(errno));
+    return 0;
+  }
+  while (::flock(fd, LOCK_EX) != 0 && errno == EINTR) {
+  }
+
+  char buf[32] = {};
+  uint64_t total = 0;
+  auto n         = ::pread(fd, buf, sizeof(buf) - 1, 0);
+  if (n > 0) {
+    total = std::strtoull(buf, nullptr, 10);
+  }
+
+  total        = update(total);
+  auto content = std::to_string(total);
+  if (::pwrite(fd, content.data(), content.size(), 0) !=
+          static_cast<ssize_t>(content.size()) ||
+      ::ftruncate(fd, static_cast<off_t>(content.size())) != 0) {
+    logger->debug("failed to write {}: {}", counter.string(), strerror(errno));
+  }
+  ::close(fd);
+  return total;
+}
+
+void ContentStore::Remove(std::string_view key) const {
+  std::error_code ec;
+  auto entry = entry_path(key);
+  auto size = entry_size(entry);
+  if (fs::remove_all(entry, ec) > 0) {
+    update_size([size](uint64_t total) {
+      return total > size ? total - size : 0;
+    });
+  }
+}
+
+void ContentStore::remove_unused_locks() const {
+  std::error_code ec;
+  for (const auto &file : fs::directory_iterator(root_ / "locks", ec)) {
+    int fd = ::open(file.path().c_str(), O_RDWR | O_CLOEXEC);
+    if (fd < 0) {
+      continue;
+    }
+    // held ones are in use, `Lock` retries if it locked a removed file
+    if (::flock(fd, LOCK_EX | LOCK_NB) == 0) {
+      fs::remove(file.path(), ec);
+    }
+    ::close(fd);
+  }
+}
+
+void ContentStore::Evict() const {
+  struct Entry {
+    fs::path Path;
+    fs::file_time_type LastUsed;
+    uint64_t Size;
+  };
+
+  std::error_code ec;
+  std::vector<Entry> entries;
+  uint64_t total = 0;
+
+  for (const auto &bucket : fs::directory_iterator(root_, ec)) {
+    if (!bucket.is_directory(ec) || bucket.path().filename() == "tmp" ||
+        bucket.path().filename() == "locks") {
+      continue;
+    }
+    for (const auto &entry : fs::directory_iterator(bucket.path(), ec)) {
+      auto size = entry_size(entry.path());
+      total += size;
+      entries.push_back(
+          Entry{entry.path(), fs::last_write_time(entry.path(), ec), size});
+    }
+  }
+
+  remove_unused_locks();
+
+  if (total <= max_size_) {
+    update_size([total](uint64_t) {
+      return total;
+    });
+    return;
+  }
+
+  std::sort(std::begin(entries), std::end(entries),
+            [](const Entry &a, const Entry &b) {
+              return a.LastUsed < b.LastUsed;
+            });
+
+  // leave some room, so we don't evict again on the next write
+  auto target = max_size_ / 10 * 9;
+  for (const auto &entry : entries) {
+    if (total <= target) {
+      break;
+    }
+    fs::remove_all(entry.Path, ec);
+    total -= entry.Size;
+  }
+  // entries stored while walking are counted again by the next eviction
+  update_size([total](uint64_t) {
+    return total;
+  });
+  logger->debug("evicted {}, size now {}", root_.string(), total);
+}
+
+}  // namespace jk::common
@@ -0,0 +1,93 @@
+// Copyright (c) 2020 - present, Hawtian Wang (twistoy.wang@gmail.com)
+//
+
+#pragma once  // NOLINT(build/header_guard)
+
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace jk::common {
+
+//! A local content-addressed store. Each entry is a directory named by its
+//! key, holding one or more named files. Entries are published by atomic
+//! rename, so concurrent writers never expose half-written entries.
+//!
+//! Keys are expected to be hex digests. Least recently used entries are
+//! evicted once the store grows larger than `max_size` bytes. The size is
+//! counted in the `size` file of the store by writers, so the store is only
+//! walked when it's probably full. An entry counts at least 4 KiB, a block on
+//! disk, even if its files are empty.
+class ContentStore {
+ public:
+  //! pairs of (name in entry, path on disk)
+  using Files = std::vector<std::pair<std::string, std::filesystem::path>>;
+
+  //! How files are put into and out of the store. `Link` tries a hardlink,
+  //! then a reflink, before falling back to copy; files placed this way share
+  //! data with the store, and must be replaced instead of modified in place.
+  //! Files of entries stored by `Link` are read-only.
+  enum class Placement { Copy, Link };
+
+  //! Holds the exclusive lock of an entry, released when destroyed.
+  class EntryLock {
+   public:
+    explicit EntryLock(int fd);
+    ~EntryLock();
+
+    EntryLock(EntryLock &&other) noexcept;
+    EntryLock(const EntryLock &)            = delete;
+    EntryLock &operator=(const EntryLock &) = delete;
+    EntryLock &operator=(EntryLock &&)      = delete;
+
+   private:
+    int fd_;
+  };
+
+  ContentStore(std::filesystem::path root, uint64_t max_size,
+               Placement placement = Placement::Copy);
+
+  //! Copies files of entry `key` to their paths. Returns false if the entry,
+  //! or any file of it, doesn't exist.
+  bool Restore(std::string_view key, const Files &files) const;
+
+  //! Stores files as entry `key`. Existing entry will be kept.
+  void Store(std::string_view key, const Files &files) const;
+
+  //! Removes entry `key`, e.g. once its contents are found to be corrupted.
+  void Remove(std::string_view key) const;
+
+  //! Removes least recently used entries until the store fits `max_size`,
+  //! and resets the size counter to the real size. Lock files nobody holds
+  //! are removed too.
+  void Evict() const;
+
+  //! Blocks until this process is the only one holding the lock of `key`.
+  //! Producers take it before the restore-or-store sequence, so an expensive
+  //! entry is produced once, and others restore it after.
+  EntryLock Lock(std::string_view key) const;
+
+ private:
+  std::filesystem::path entry_path(std::string_view key) const;
+
+  //! Replaces the size counter with `update(counter)` under its lock.
+  //! Returns the new size.
+  uint64_t update_size(const std::function<uint64_t(uint64_t)> &update) const;
+
+  //! Removes lock files of `Lock` not held by anyone.
+  void remove_unused_locks() const;
+
+  //! Places `from` at `to`, by the placement of this store.
+  bool place_file(const std::filesystem::path &from,
+                  const std::filesystem::path &to, std::error_code &ec) const;
+
+  std::filesystem::path root_;
+  uint64_t max_size_;
+  Placement placement_;
+};
+
+}  // namespace jk::common
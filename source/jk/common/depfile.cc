@@ -0,0 +1,182 @@
+// Copyright (c) 2020 - present, Hawtian Wang (twistoy.wang@gmail.com)
+//
+
+#include "jk/common/depfile.hh"
+
+#include <fcntl.h>
+#include <sys/file.h>
+#include <unistd.h>
+
+#include <cctype>
+#include <cerrno>
+#include <fstream>
+#include <iterator>
+#include <set>
+#include <string>
+#include <utility>
+
+#include "fmt/format.h"
+#include "jk/core/error.h"
+#include "jk/utils/logging.hh"
+
+namespace jk::common {
+
+namespace fs = std::filesystem;
+
+//! Splits `line` by unescaped whitespaces, escapes are kept.
+static std::vector<std::string> split_words(std::string_view line) {
+  std::vector<std::string> res;
+  std::string word;
+  for (size_t i = 0; i < line.size(); i++) {
+    auto ch = line[i];
+    if (ch == '\\' && i + 1 < line.size() && line[i + 1] == ' ') {
+      word += line.substr(i, 2);
+      i++;
+    } else if (std::isspace(static_cast<unsigned char>(ch))) {
+      if (!word.empty()) {
+        res.push_back(std::move(word));
+        word.clear();
+      }
+    } else {
+      word.push_back(ch);
+    }
+  }
+  if (!word.empty()) {
+    res.push_back(std::move(word));
+  }
+  return res;
+}
+
+DependencyMap ParseDepfile(std::string_view content) {
+  DependencyMap res;
+
+  std::string line;
+  auto parse_line = [&res, &line]() {
+    // the separator is the first ':' followed by a whitespace or the end
+    size_t colon = 0;
+    while ((colon = line.find(':', colon)) != std::string::npos) {
+      if (colon + 1 == line.size() ||
+          std::isspace(static_cast<unsigned char>(line[colon + 1]))) {
+        break;
+      }
+      colon++;
+    }
+    if (colon == std::string::npos) {
+      return;
+    }
+
+    auto deps = split_words(std::string_view{line}.substr(colon + 1));
+    if (deps.empty()) {
+      return;
+    }
+    for (auto &target : split_words(std::string_view{line}.substr(0, colon))) {
+      res[std::move(target)] = deps;
+    }
+  };
+
+  for (size_t i = 0; i < content.size(); i++) {
+    auto ch = content[i];
+    if (ch == '\\' && i + 1 < content.size() && content[i + 1] == '\n') {
+      // continuation
+      line.push_back(' ');
+      i++;
+    } else if (ch == '\\' && i + 2 < content.size() &&
+               content[i + 1] == '\r' && content[i + 2] == '\n') {
+      line.push_back(' ');
+      i += 2;
+    } else if (ch == '\n') {
+      parse_line();
+      line.clear();
+    } else {
+      line.push_back(ch);
+    }
+  }
+  parse_line();
+
+  return res;
+}
+
+std::string FormatDependencies(const DependencyMap &deps) {
+  std::string res;
+  std::set<std::string_view> prerequisites;
+  for (const auto &[target, files] : deps) {
+    res += target;
+    res += ':';
+    for (const auto &f : files) {
+      res += " \\\n ";
+      res += f;
+      prerequisites.insert(f);
+    }
+    res += "\n\n";
+  }
+
+  for (auto f : prerequisites) {
+    res += f;
+    res += ":\n\n";
+  }
+  return res;
+}
+
+static std::string read_file(const fs::path &p) {
+  std::ifstream ifs(p);
+  return {std::istreambuf_iterator<char>{ifs},
+          std::istreambuf_iterator<char>{}};
+}
+
+fs::path DepsJournalFile(const fs::path &log) {
+  return log.string() + ".journal";
+}
+
+//! Locks the lock file of `log`, so compactions by different make processes
+//! don't race. Returns the locked file descriptor.
+static int lock_deps_log(const fs::path &log, int operation) {
+  auto lock_file = fs::path(log.string() + ".lock");
+  int fd = ::open(lock_file.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+  if (fd < 0) {
+    JK_THROW(core::JKBuildError("Open lock file {} error.",
+                                lock_file.string()));
+  }
+  while (::flock(fd, operation) != 0) {
+    if (errno != EINTR) {
+      ::close(fd);
+      JK_THROW(core::JKBuildError("Lock file {} error.", lock_file.string()));
+    }
+  }
+  return fd;
+}
+
+void CompactDepsLog(const fs::path &log) {
+  std::error_code ec;
+  fs::create_directories(log.parent_path(), ec);
+  int fd = lock_deps_log(log, LOCK_EX);
+
+  auto journal = DepsJournalFile(log);
+  auto deps    = ParseDepfile(read_file(log));
+  if (fs::exists(journal, ec)) {
+    for (auto &[target, files] : ParseDepfile(read_file(journal))) {
+      deps[target] = std::move(files);
+    }
+  }
+
+  // readers never see a partially written log
+  auto tmp = fs::path(fmt::format("{}.{}.tmp", log.string(), ::getpid()));
+  {
+    std::ofstream ofs(tmp);
+    ofs << FormatDependencies(deps);
+    if (!ofs) {
+      ::close(fd);
+      JK_THROW(core::JKBuildError("Could not write to {}.", tmp.string()));
+    }
+  }
+  fs::rename(tmp, log, ec);
+  if (!ec) {
+    fs::remove(journal, ec);
+  }
+  ::close(fd);
+  if (ec) {
+    JK_THROW(core::JKBuildError("Update {} error: {}", log.string(),
+                                ec.message()));
+  }
+}
+
+}  // namespace jk::common
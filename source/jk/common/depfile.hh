@@ -0,0 +1,35 @@
+// Copyright (c) 2020 - present, Hawtian Wang (twistoy.wang@gmail.com)
+//
+
+#pragma once  // NOLINT(build/header_guard)
+
+#include <filesystem>
+#include <map>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace jk::common {
+
+//! Prerequisites of each target. Paths are kept escaped as in Makefiles.
+using DependencyMap = std::map<std::string, std::vector<std::string>>;
+
+//! Parses rules of a depfile written by `-MD`/`-MMD` or `FormatDependencies`.
+//! Rules without prerequisites, like phony targets of `-MP`, are skipped.
+DependencyMap ParseDepfile(std::string_view content);
+
+//! Formats `deps` as Makefile rules, and an empty rule for each
+//! prerequisite, same as `-MP`, so removed headers don't break the build.
+std::string FormatDependencies(const DependencyMap &deps);
+
+//! Journal of depfiles appended since `log` was compacted last time.
+//! Compile commands append their depfiles to it from the shell.
+std::filesystem::path DepsJournalFile(const std::filesystem::path &log);
+
+//! Merges the journal of `log` into `log`, one dependency file of many
+//! objects, and removes the journal. Rules in the journal replace rules of
+//! the same target in `log`, later ones win. `log` is always written, even
+//! if there was nothing to merge.
+void CompactDepsLog(const std::filesystem::path &log);
+
+}  // namespace jk::common
@@ -0,0 +1,627 @@
+// Copyright (c) 2020 - present, Hawtian Wang (twistoy.wang@gmail.com)
+//
+
+#include "jk/common/download.hh"
+
+#include <curl/curl.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "fmt/format.h"
+#include "jk/core/error.h"
+#include "jk/utils/digest.hh"
+#include "jk/utils/logging.hh"
+#include "jk/utils/str.hh"
+
+namespace jk::common {
+
+namespace fs = std::filesystem;
+
+static auto logger = utils::Logger("download");
+
+// Bump it if the layout of state files changed.
+static constexpr std::string_view kStateVersion = "jk-download-1";
+
+static constexpr uint64_t kUnknownSize = std::numeric_limits<uint64_t>::max();
+
+struct RemoteFile {
+  //! Server accepts `Range` requests
+  bool Ranges = false;
+  uint64_t Size = kUnknownSize;
+  //! ETag or Last-Modified, tells if the file changed between two runs
+  std::string Validator;
+};
+
+struct Segment {
+  uint64_t Begin;
+  //! Exclusive, `kUnknownSize` if the size is unknown
+  uint64_t End;
+  //! Next byte to write, bytes in [Begin, Next) are on disk
+  uint64_t Next;
+
+  uint32_t Retries = 0;
+  ::CURL *Easy     = nullptr;
+  //! The server answered a ranged request with the whole file
+  bool RangeIgnored = false;
+  bool Checked      = false;
+};
+
+struct Transfer {
+  int Fd;
+  bool Ranged;
+  std::vector<Segment> Segments;
+
+  //! Digest of bytes in [0, Hashed), empty if not verified
+  std::unique_ptr<utils::Digest> Digest;
+  uint64_t Hashed = 0;
+
+  uint64_t Downloaded() const {
+    uint64_t res = 0;
+    for (const auto &seg : Segments) {
+      res += seg.Next - seg.Begin;
+    }
+    return res;
+  }
+};
+
+Checksum Checksum::Parse(std::string_view s) {
+  Checksum res;
+  if (auto colon = s.find(':'); colon != std::string_view::npos) {
+    res.Method = utils::ToLower(std::string(s.substr(0, colon)));
+    res.Hex    = utils::ToLower(std::string(s.substr(colon + 1)));
+  } else {
+    res.Method = "sha256";
+    res.Hex    = utils::ToLower(std::string(s));
+  }
+  // throws if openssl doesn't know it
+  utils::Digest{res.Method};
+  return res;
+}
+
+struct SegmentWriter {
+  Transfer *T;
+  Segment *Seg;
+};
+
+static void init_curl() {
+  static std::once_flag once;
+  std::call_once(once, [] {
+    ::curl_global_init(CURL_GLOBAL_DEFAULT);
+  });
+}
+
+static void check(::CURLcode result, std::string_view msg) {
+  if (result != CURLE_OK) {
+    JK_THROW(
+        core::JKBuildError("{}: {}", msg, ::curl_easy_strerror(result)));
+  }
+}
+
+//! Sets options shared by all requests.
+static void setup_easy(::CURL *curl, const std::string &url,
+                       const DownloadOptions &options) {
+  check(::curl_easy_setopt(curl, CURLOPT_URL, url.c_str()),
+        "DOWNLOAD cannot set url");
+  // enable HTTP ERROR parsing
+  check(::curl_easy_setopt(curl, CURLOPT_FAILONERROR, 1L),
+        "DOWNLOAD cannot set http failure option");
+  check(::curl_easy_setopt(curl, CURLOPT_USERAGENT, "curl/" LIBCURL_VERSION),
+        "DOWNLOAD cannot set user agent option");
+  check(::curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L),
+        "DOWNLOAD cannot set follow-redirect option");
+
+  if (options.Verbose) {
+    check(::curl_easy_setopt(curl, CURLOPT_VERBOSE, 1L),
+          "DOWNLOAD cannot set verbose");
+  }
+  if (options.Timeout > 0) {
+    check(::curl_easy_setopt(curl, CURLOPT_TIMEOUT,
+                             static_cast<long>(options.Timeout)),
+          "DOWNLOAD cannot set timeout");
+  }
+  if (options.InactivityTimeout > 0) {
+    // Give up if there is no progress for a long time.
+    ::curl_easy_setopt(curl, CURLOPT_LOW_SPEED_LIMIT, 1L);
+    ::curl_easy_setopt(curl, CURLOPT_LOW_SPEED_TIME,
+                       static_cast<long>(options.InactivityTimeout));
+  }
+  if (auto proxy = getenv("HTTP_PROXY"); proxy) {
+    check(::curl_easy_setopt(curl, CURLOPT_PROXY, proxy),
+          "DOWNLOAD cannot set proxy value");
+  }
+}
+
+static std::string_view strip(std::string_view s) {
+  while (!s.empty() && std::isspace(static_cast<unsigned char>(s.front()))) {
+    s.remove_prefix(1);
+  }
+  while (!s.empty() && std::isspace(static_cast<unsigned char>(s.back()))) {
+    s.remove_suffix(1);
+  }
+  return s;
+}
+
+static size_t probe_header_callback(char *buffer, size_t size, size_t nitems,
+                                    void *data) {
+  auto remote = static_cast<RemoteFile *>(data);
+  auto len    = size * nitems;
+  auto line   = strip(std::string_view{buffer, len});
+
+  // headers of all responses are passed on redirects, only the last counts
+  if (utils::StringStartsWith(line, "HTTP/")) {
+    *remote = RemoteFile{};
+    return len;
+  }
+
+  auto colon = line.find(':');
+  if (colon == std::string_view::npos) {
+    return len;
+  }
+  auto name  = line.substr(0, colon);
+  auto value = strip(line.substr(colon + 1));
+  if (utils::EqualIgnoreCase(name, "accept-ranges")) {
+    remote->Ranges = utils::EqualIgnoreCase(value, "bytes");
+  } else if (utils::EqualIgnoreCase(name, "etag")) {
+    remote->Validator = std::string(value);
+  } else if (utils::EqualIgnoreCase(name, "last-modified") &&
+             remote->Validator.empty()) {
+    remote->Validator = std::string(value);
+  }
+  return len;
+}
+
+//! Asks the server about the file with a HEAD request. Servers failing it are
+//! treated as not accepting ranges.
+static RemoteFile probe(const std::string &url,
+                        const DownloadOptions &options) {
+  RemoteFile remote;
+
+  std::unique_ptr<::CURL, decltype(&::curl_easy_cleanup)> curl(
+      ::curl_easy_init(), &::curl_easy_cleanup);
+  if (!curl) {
+    JK_THROW(core::JKBuildError("init: Error in initializing curl."));
+  }
+  setup_easy(curl.get(), url, options);
+  ::curl_easy_setopt(curl.get(), CURLOPT_NOBODY, 1L);
+  ::curl_easy_setopt(curl.get(), CURLOPT_HEADERFUNCTION,
+                     probe_header_callback);
+  ::curl_easy_setopt(curl.get(), CURLOPT_HEADERDATA, &remote);
+
+  if (auto rc = ::curl_easy_perform(curl.get()); rc != CURLE_OK) {
+    logger->debug("probe {} failed: {}", url, ::curl_easy_strerror(rc));
+    return {};
+  }
+
+  curl_off_t length = -1;
+  ::curl_easy_getinfo(curl.get(), CURLINFO_CONTENT_LENGTH_DOWNLOAD_T, &length);
+  if (length >= 0) {
+    remote.Size = static_cast<uint64_t>(length);
+  }
+  if (remote.Size == kUnknownSize || remote.Size == 0) {
+    remote.Ranges = false;
+  }
+  return remote;
+}
+
+//! Splits a file of `size` bytes into segments.
+static std::vector<Segment> make_segments(uint64_t size,
+                                          const DownloadOptions &options) {
+  auto min_size = std::max<uint64_t>(options.MinSegmentSize, 1);
+  auto count    = std::clamp<uint64_t>((size + min_size - 1) / min_size, 1,
+                                    std::max(options.Connections, 1u));
+  auto step     = (size + count - 1) / count;
+
+  std::vector<Segment> res;
+  for (uint64_t begin = 0; begin < size; begin += step) {
+    auto end = std::min(size, begin + step);
+    res.push_back(Segment{begin, end, begin});
+  }
+  return res;
+}
+
+// State file:
+//   version
+//   url
+//   size validator
+//   begin end next    (one line per segment)
+static void save_state(const fs::path &state_file, const std::string &url,
+                       const RemoteFile &remote, const Transfer &transfer) {
+  auto tmp = fs::path(fmt::format("{}.{}.tmp", state_file.string(), ::getpid()));
+  {
+    std::ofstream ofs(tmp);
+    ofs << kStateVersion << '\n' << url << '\n';
+    ofs << remote.Size << ' ' << remote.Validator << '\n';
+    for (const auto &seg : transfer.Segments) {
+      ofs << seg.Begin << ' ' << seg.End << ' ' << seg.Next << '\n';
+    }
+  }
+  std::error_code ec;
+  fs::rename(tmp, state_file, ec);
+  if (ec) {
+    fs::remove(tmp, ec);
+  }
+}
+
+//! Returns segments of an interrupted download, if it downloads the same file.
+static std::optional<std::vector<Segment>> load_state(
+    const fs::path &state_file, const fs::path &part_file,
+    const std::string &url, const RemoteFile &remote) {
+  std::error_code ec;
+  std::ifstream ifs(state_file);
+  if (!ifs || !fs::exists(part_file, ec)) {
+    return {};
+  }
+
+  std::string version, state_url, line;
+  std::getline(ifs, version);
+  std::getline(ifs, state_url);
+  std::getline(ifs, line);
+  if (version != kStateVersion || state_url != url) {
+    return {};
+  }
+
+  auto space = line.find(' ');
+  if (space == std::string::npos ||
+      line.substr(0, space) != std::to_string(remote.Size) ||
+      line.substr(space + 1) != remote.Validator) {
+    return {};
+  }
+
+  std::vector<Segment> res;
+  uint64_t begin, end, next;
+  while (ifs >> begin >> end >> next) {
+    if (begin > next || next > end || end > remote.Size) {
+      return {};
+    }
+    res.push_back(Segment{begin, end, next});
+  }
+  if (res.empty() || fs::file_size(part_file, ec) != remote.Size) {
+    return {};
+  }
+  return res;
+}
+
+static size_t write_segment_callback(char *ptr, size_t size, size_t nmemb,
+                                     void *data) {
+  auto writer   = static_cast<SegmentWriter *>(data);
+  auto transfer = writer->T;
+  auto seg      = writer->Seg;
+  auto len      = size * nmemb;
+
+  if (transfer->Ranged && !seg->Checked) {
+    long code = 0;
+    ::curl_easy_getinfo(seg->Easy, CURLINFO_RESPONSE_CODE, &code);
+    if (code != 206) {
+      seg->RangeIgnored = true;
+      return 0;
+    }
+    seg->Checked = true;
+  }
+
+  if (seg->End != kUnknownSize && seg->Next + len > seg->End) {
+    seg->RangeIgnored = true;
+    return 0;
+  }
+
+  size_t written = 0;
+  while (written < len) {
+    auto rc = ::pwrite(transfer->Fd, ptr + written, len - written,
+                       static_cast<off_t>(seg->Next + written));
+    if (rc < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return 0;
+    }
+    written += rc;
+  }
+
+  // bytes continuing the hashed prefix are hashed right away, others are read
+  // back by `hash_part` once the prefix reaches them
+  if (transfer->Digest && seg->Next == transfer->Hashed) {
+    transfer->Digest->Update({ptr, len});
+    transfer->Hashed += len;
+  }
+
+  seg->Next += len;
+  return len;
+}
+
+//! Extends the hashed prefix over bytes already on disk, which arrived before
+//! the prefix reached them.
+static void hash_part(Transfer *transfer) {
+  if (!transfer->Digest) {
+    return;
+  }
+
+  char buf[64 * 1024];
+  for (const auto &seg : transfer->Segments) {
+    if (transfer->Hashed < seg.Begin || transfer->Hashed >= seg.End) {
+      continue;
+    }
+    while (transfer->Hashed < seg.Next) {
+      auto want = std::min<uint64_t>(sizeof(buf), seg.Next - transfer->Hashed);
+      auto rc   = ::pread(transfer->Fd, buf, want,
+                          static_cast<off_t>(transfer->Hashed));
+      if (rc < 0 && errno == EINTR) {
+        continue;
+      }
+      if (rc <= 0) {
+        JK_THROW(core::JKBuildError("Read downloaded file error."));
+      }
+      transfer->Digest->Update({buf, static_cast<size_t>(rc)});
+      transfer->Hashed += rc;
+    }
+    if (seg.Next != seg.End) {
+      // still downloading, the rest will be hashed as it arrives
+      return;
+    }
+  }
+}
+
+class MultiTransfer {
+ public:
+  MultiTransfer(const std::string &url, const DownloadOptions &options,
+                const RemoteFile &remote, Transfer *transfer)
+      : url_(url),
+        options_(options),
+        transfer_(transfer),
+        multi_(::curl_multi_init()) {
+    if (!multi_) {
+      JK_THROW(core::JKBuildError("init: Error in initializing curl."));
+    }
+    if (!remote.Validator.empty() &&
+        !utils::StringStartsWith(remote.Validator, "W/")) {
+      // the server sends the whole file if it changed, caught by the 206 check
+      auto header = fmt::format("If-Range: {}", remote.Validator);
+      headers_    = ::curl_slist_append(nullptr, header.c_str());
+    }
+    writers_.reserve(transfer->Segments.size());
+    for (auto &seg : transfer->Segments) {
+      writers_.push_back(SegmentWriter{transfer, &seg});
+    }
+  }
+
+  ~MultiTransfer() {
+    for (auto &seg : transfer_->Segments) {
+      stop(&seg);
+    }
+    ::curl_multi_cleanup(multi_);
+    ::curl_slist_free_all(headers_);
+  }
+
+  MultiTransfer(const MultiTransfer &)            = delete;
+  MultiTransfer &operator=(const MultiTransfer &) = delete;
+
+  //! Runs until all segments finished. Calls `on_tick` about every second, and
+  //! on every activity.
+  void Run(const std::function<void()> &on_tick) {
+    for (size_t i = 0; i < transfer_->Segments.size(); i++) {
+      if (!finished(transfer_->Segments[i])) {
+        start(i);
+      }
+    }
+
+    while (active_ > 0) {
+      int running = 0;
+      ::curl_multi_perform(multi_, &running);
+
+      int left = 0;
+      while (auto msg = ::curl_multi_info_read(multi_, &left)) {
+        if (msg->msg != CURLMSG_DONE) {
+          continue;
+        }
+        void *seg = nullptr;
+        ::curl_easy_getinfo(msg->easy_handle, CURLINFO_PRIVATE, &seg);
+        on_done(static_cast<Segment *>(seg), msg->data.result);
+      }
+
+      on_tick();
+      if (active_ > 0) {
+        ::curl_multi_poll(multi_, nullptr, 0, 1000, nullptr);
+      }
+    }
+  }
+
+ private:
+  bool finished(const Segment &seg) const {
+    return seg.End != kUnknownSize && seg.Next == seg.End;
+  }
+
+  void start(size_t index) {
+    auto seg = &transfer_->Segments[index];
+    seg->Easy    = ::curl_easy_init();
+    seg->Checked = false;
+    if (!seg->Easy) {
+      JK_THROW(core::JKBuildError("init: Error in initializing curl."));
+    }
+
+    setup_easy(seg->Easy, url_, options_);
+    ::curl_easy_setopt(seg->Easy, CURLOPT_WRITEFUNCTION,
+                       write_segment_callback);
+    ::curl_easy_setopt(seg->Easy, CURLOPT_WRITEDATA, &writers_[index]);
+    ::curl_easy_setopt(seg->Easy, CURLOPT_PRIVATE, static_cast<void *>(seg));
+    if (transfer_->Ranged) {
+      auto range = fmt::format("{}-{}", seg->Next, seg->End - 1);
+      check(::curl_easy_setopt(seg->Easy, CURLOPT_RANGE, range.c_str()),
+            "DOWNLOAD cannot set range");
+      if (headers_) {
+        ::curl_easy_setopt(seg->Easy, CURLOPT_HTTPHEADER, headers_);
+      }
+    }
+
+    ::curl_multi_add_handle(multi_, seg->Easy);
+    active_++;
+  }
+
+  void stop(Segment *seg) {
+    if (seg->Easy) {
+      ::curl_multi_remove_handle(multi_, seg->Easy);
+      ::curl_easy_cleanup(seg->Easy);
+      seg->Easy = nullptr;
+      active_--;
+    }
+  }
+
+  void on_done(Segment *seg, ::CURLcode result) {
+    stop(seg);
+
+    if (seg->RangeIgnored) {
+      JK_THROW(core::JKBuildError(
+          "Download {} failed: the file changed on server, or the server "
+          "ignored range requests.",
+          url_));
+    }
+    if (result == CURLE_OK && (seg->End == kUnknownSize || finished(*seg))) {
+      return;
+    }
+    if (result == CURLE_HTTP_RETURNED_ERROR ||
+        seg->Retries >= options_.Retries) {
+      JK_THROW(core::JKBuildError(
+          "Download {} failed: {}", url_,
+          result == CURLE_OK ? "connection closed before all data received"
+                             : ::curl_easy_strerror(result)));
+    }
+
+    seg->Retries++;
+    logger->debug("retry bytes {}-{} of {}: {}", seg->Next, seg->End, url_,
+                  ::curl_easy_strerror(result));
+    if (!transfer_->Ranged) {
+      // can't continue from the middle, start over
+      seg->Next = seg->Begin;
+      if (transfer_->Digest) {
+        transfer_->Digest =
+            std::make_unique<utils::Digest>(options_.Expected->Method);
+        transfer_->Hashed = 0;
+      }
+      if (::ftruncate(transfer_->Fd, 0) != 0) {
+        JK_THROW(core::JKBuildError("Truncate file of {} error.", url_));
+      }
+    }
+    start(seg - transfer_->Segments.data());
+  }
+
+  const std::string &url_;
+  const DownloadOptions &options_;
+  Transfer *transfer_;
+
+  ::CURLM *multi_;
+  ::curl_slist *headers_ = nullptr;
+  std::vector<SegmentWriter> writers_;
+  uint32_t active_ = 0;
+};
+
+void Download(const std::string &url, const fs::path &output,
+              const DownloadOptions &options) {
+  init_curl();
+
+  std::error_code ec;
+  fs::create_directories(output.parent_path(), ec);
+
+  auto part_file  = fs::path(output.string() + ".part");
+  auto state_file = fs::path(output.string() + ".part.state");
+
+  auto remote = probe(url, options);
+
+  Transfer transfer;
+  transfer.Ranged = remote.Ranges;
+  if (transfer.Ranged) {
+    if (auto segments = load_state(state_file, part_file, url, remote);
+        segments) {
+      logger->debug("resume {} from {}", url, part_file.string());
+      transfer.Segments = std::move(segments.value());
+    } else {
+      transfer.Segments = make_segments(remote.Size, options);
+    }
+  } else {
+    transfer.Segments.push_back(Segment{0, remote.Size, 0});
+  }
+
+  bool resumed = transfer.Downloaded() > 0;
+  transfer.Fd  = ::open(part_file.c_str(),
+                        O_RDWR | O_CREAT | O_CLOEXEC | (resumed ? 0 : O_TRUNC),
+                        0644);
+  if (transfer.Fd < 0) {
+    JK_THROW(core::JKBuildError("Open file {} error.", part_file.string()));
+  }
+  std::unique_ptr<int, void (*)(int *)> fd_guard(&transfer.Fd, [](int *fd) {
+    ::close(*fd);
+  });
+
+  if (transfer.Ranged) {
+    if (::ftruncate(transfer.Fd, static_cast<off_t>(remote.Size)) != 0) {
+      JK_THROW(core::JKBuildError("Allocate file {} error.",
+                                  part_file.string()));
+    }
+  } else {
+    fs::remove(state_file, ec);
+  }
+
+  if (options.Expected) {
+    transfer.Digest =
+        std::make_unique<utils::Digest>(options.Expected->Method);
+  }
+
+  auto total = remote.Size == kUnknownSize ? 0 : remote.Size;
+  auto last_save = std::chrono::steady_clock::now();
+  auto on_tick   = [&]() {
+    hash_part(&transfer);
+    if (options.OnProgress) {
+      options.OnProgress(transfer.Downloaded(), total);
+    }
+    auto now = std::chrono::steady_clock::now();
+    if (transfer.Ranged && now - last_save > std::chrono::seconds(1)) {
+      save_state(state_file, url, remote, transfer);
+      last_save = now;
+    }
+  };
+
+  try {
+    MultiTransfer multi(url, options, remote, &transfer);
+    multi.Run(on_tick);
+  } catch (...) {
+    if (transfer.Ranged) {
+      // keep what we have got for the next run
+      save_state(state_file, url, remote, transfer);
+    }
+    throw;
+  }
+  if (transfer.Digest) {
+    hash_part(&transfer);
+    auto actual = transfer.Digest->HexDigest();
+    if (actual != options.Expected->Hex) {
+      fd_guard.reset();
+      fs::remove(part_file, ec);
+      fs::remove(state_file, ec);
+      JK_THROW(core::JKBuildError(
+          "{} mismatch, for file: {}, expect: {}, actual: {}",
+          options.Expected->Method, output.string(), options.Expected->Hex,
+          actual));
+    }
+  }
+  fd_guard.reset();
+
+  fs::rename(part_file, output, ec);
+  if (ec) {
+    JK_THROW(core::JKBuildError("Rename {} to {} error: {}",
+                                part_file.string(), output.string(),
+                                ec.message()));
+  }
+  fs::remove(state_file, ec);
+}
+
+}  // namespace jk::common
@@ -0,0 +1,57 @@
+// Copyright (c) 2020 - present, Hawtian Wang (twistoy.wang@gmail.com)
+//
+
+#pragma once  // NOLINT(build/header_guard)
+
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <optional>
+#include <string>
+#include <string_view>
+
+namespace jk::common {
+
+struct Checksum {
+  //! Digest name known by openssl, like "sha256", "sha512" or "blake2b512"
+  std::string Method;
+  //! Lower-case hex digest
+  std::string Hex;
+
+  //! Parses `method:hex`, or a bare hex digest of sha256. Throws if the method
+  //! is not supported.
+  static Checksum Parse(std::string_view s);
+};
+
+struct DownloadOptions {
+  //! Expected checksum of the file, not checked if empty
+  std::optional<Checksum> Expected;
+  //! Max concurrent connections, if the server accepts ranges
+  uint32_t Connections = 4;
+  //! Files are not split into segments smaller than it
+  uint64_t MinSegmentSize = 8 * 1024 * 1024;
+  //! Times to retry one segment after its connection dropped
+  uint32_t Retries = 3;
+  //! Seconds, 0 for no limit
+  int Timeout = 0;
+  //! Gives up if no data received for this seconds, 0 for no limit
+  int InactivityTimeout = 0;
+  bool Verbose = false;
+  //! Called with (downloaded bytes, total bytes), total is 0 if unknown
+  std::function<void(uint64_t, uint64_t)> OnProgress;
+};
+
+//! Downloads `url` into `output`.
+//!
+//! If the server accepts ranges, the file is downloaded in segments over
+//! several connections. Data goes into `<output>.part` first, with
+//! `<output>.part.state` recording progress of each segment, so an
+//! interrupted download resumes from where it stopped. `output` only appears
+//! after the whole file was downloaded and verified. The checksum is computed
+//! as data arrives, so verifying doesn't read the file again.
+//!
+//! Throws `JKBuildError` on failure.
+void Download(const std::string &url, const std::filesystem::path &output,
+              const DownloadOptions &options);
+
+}  // namespace jk::common
@@ -0,0 +1,153 @@
+// Copyright (c) 2020 - present, Hawtian Wang (twistoy.wang@gmail.com)
+//
+
+#include "jk/common/lint.hh"
+
+#include <sys/stat.h>
+
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include "jk/common/process.hh"
+#include "jk/utils/digest.hh"
+#include "jk/utils/logging.hh"
+#include "jk/utils/str.hh"
+
+namespace jk::common {
+
+namespace fs = std::filesystem;
+
+static auto logger = utils::Logger("lint");
+
+// Bump it if the layout of cached entries changed.
+static constexpr std::string_view kCacheVersion = "jk-lint-cache-1";
+
+std::string LinterIdentity(const std::string &cpplint) {
+  std::string res = cpplint;
+  auto program    = FindProgram(cpplint);
+  struct stat st;
+  if (program && ::stat(program->c_str(), &st) == 0) {
+    for (const auto &part :
+         {fs::absolute(*program).string(), std::to_string(st.st_size),
+          std::to_string(st.st_mtime)}) {
+      res.push_back('\0');
+      res += part;
+    }
+  }
+  return res;
+}
+
+//! Calls `on_config` with path and contents of each CPPLINT.cfg applied to
+//! `file`, from its directory up to the one with `set noparent`, or the
+//! root, same as cpplint.
+template<typename F>
+static void walk_configs(const std::string &file, F &&on_config) {
+  std::error_code ec;
+  auto dir = fs::absolute(file, ec).parent_path();
+  while (!dir.empty()) {
+    auto config = dir / "CPPLINT.cfg";
+    if (std::ifstream ifs(config); ifs) {
+      std::string content{std::istreambuf_iterator<char>{ifs},
+                          std::istreambuf_iterator<char>{}};
+      on_config(config.string(), content);
+      if (content.find("set noparent") != std::string::npos) {
+        return;
+      }
+    }
+    if (dir == dir.parent_path()) {
+      return;
+    }
+    dir = dir.parent_path();
+  }
+}
+
+std::optional<std::string> LintCacheKey(std::string_view linter,
+                                        const std::string &file) {
+  std::ifstream ifs(file, std::ios::binary);
+  if (!ifs) {
+    return {};
+  }
+
+  utils::Digest digest;
+  auto update = [&digest](std::string_view s) {
+    digest.Update(s).Update(std::string_view{"\0", 1});
+  };
+  update(kCacheVersion);
+  update(linter);
+  // cpplint checks header guards and include orders by path
+  update(file);
+  walk_configs(file, [&update](const std::string &path,
+                               const std::string &content) {
+    update(path);
+    update(content);
+  });
+
+  char buf[64 * 1024];
+  while (ifs.read(buf, sizeof(buf)) || ifs.gcount() > 0) {
+    digest.Update(std::string_view{buf, static_cast<size_t>(ifs.gcount())});
+  }
+  return digest.HexDigest();
+}
+
+std::vector<LintBatch> MakeLintBatches(const std::vector<std::string> &files,
+                                       std::string_view cpplint,
+                                       const ContentStore *store,
+                                       size_t batch_size) {
+  // entries of passed files have no content, existence is enough
+  auto linter = LinterIdentity(std::string{cpplint});
+  std::vector<LintBatch> batches;
+  for (const auto &file : files) {
+    if (file.empty()) {
+      continue;
+    }
+    auto key = LintCacheKey(linter, file);
+    if (store && key && store->Restore(key.value(), {})) {
+      logger->debug("cache hit: {}", file);
+      continue;
+    }
+
+    if (batches.empty() || batches.back().Files.size() >= batch_size) {
+      batches.emplace_back();
+    }
+    batches.back().Files.push_back(file);
+    batches.back().Keys.push_back(key.value_or(""));
+  }
+  return batches;
+}
+
+std::unordered_set<std::string> LintFailedFiles(const LintBatch &batch) {
+  std::unordered_set<std::string> res;
+  std::ifstream ifs(batch.LogFile);
+  std::string line;
+  while (std::getline(ifs, line)) {
+    for (const auto &file : batch.Files) {
+      if (utils::StringStartsWith(line, file) && line.size() > file.size() &&
+          line[file.size()] == ':') {
+        res.insert(file);
+      }
+    }
+  }
+  return res;
+}
+
+void StoreLintResults(const LintBatch &batch, int exit_code,
+                      const ContentStore &store) {
+  std::unordered_set<std::string> failed;
+  if (exit_code != 0) {
+    failed = LintFailedFiles(batch);
+    if (failed.empty()) {
+      return;
+    }
+  }
+
+  for (size_t i = 0; i < batch.Files.size(); i++) {
+    if (!batch.Keys[i].empty() && !failed.contains(batch.Files[i])) {
+      store.Store(batch.Keys[i], {});
+    }
+  }
+}
+
+}  // namespace jk::common
@@ -0,0 +1,51 @@
+// Copyright (c) 2020 - present, Hawtian Wang (twistoy.wang@gmail.com)
+//
+
+#pragma once  // NOLINT(build/header_guard)
+
+#include <cstddef>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_set>
+#include <vector>
+
+#include "jk/common/content_store.hh"
+
+namespace jk::common {
+
+//! Files passed to one cpplint process.
+struct LintBatch {
+  std::vector<std::string> Files;
+  //! Cache keys of `Files`, empty if the file can't be read
+  std::vector<std::string> Keys;
+  std::filesystem::path LogFile;
+};
+
+//! Returns the identity of linter `cpplint`: its name, and path, size and
+//! mtime of the program if found, so an upgraded linter lints again.
+std::string LinterIdentity(const std::string &cpplint);
+
+//! Returns the cache key of linting `file` by `linter`, an identity from
+//! `LinterIdentity`. Only contents of the file and of CPPLINT.cfg files
+//! applied to it matter, so touching a file doesn't lint it again.
+std::optional<std::string> LintCacheKey(std::string_view linter,
+                                        const std::string &file);
+
+//! Splits `files` into batches of at most `batch_size` files. Files linted
+//! before are skipped, if `store` is not null.
+std::vector<LintBatch> MakeLintBatches(const std::vector<std::string> &files,
+                                       std::string_view cpplint,
+                                       const ContentStore *store,
+                                       size_t batch_size);
+
+//! Returns files in `batch` which cpplint reported errors of in its log.
+std::unordered_set<std::string> LintFailedFiles(const LintBatch &batch);
+
+//! Records files of `batch` which passed into `store`. Nothing passed for
+//! sure if cpplint failed without reporting any file.
+void StoreLintResults(const LintBatch &batch, int exit_code,
+                      const ContentStore &store);
+
+}  // namespace jk::common
@@ -60,7 +60,7 @@ void AssumeFolder(const fs::path &rp) {
   fs::create_directory(rp);
 }
 
-void FastWriteFile(const fs::path &rp, const std::string &content) {
+bool FastWriteFile(const fs::path &rp, const std::string &content) {
   if (fs::exists(rp)) {
     std::ifstream ifs(rp.string());
     std::string old_content;
@@ -68,11 +68,17 @@ void FastWriteFile(const fs::path &rp, const std::string &content) {
               std::istreambuf_iterator<char>{},
               std::back_inserter(old_content));
     if (old_content == content) {
-      return;
+      return false;
     }
   }
-  std::ofstream ofs;
+
+  AssumeFolder(rp.parent_path());
+  std::ofstream ofs(rp.string());
+  if (!ofs) {
+    JK_THROW(core::JKBuildError("Could not write to {}.", rp.string()));
+  }
   ofs << content;
+  return true;
 }
 
 AbsolutePath AbsolutePath::CurrentWorkingDirectory() {
@@ -82,6 +82,8 @@ uint32_t GetNumberOfFilesInDirectory(const AbsolutePath &path);
 
 void RemoveDirectory(const AbsolutePath &p);
 
-void FastWriteFile(const fs::path &rp, const std::string &content);
+//! Writes `content` into `rp` unless the file has the same content, keeps
+//! its mtime if not changed. Returns true if the file is written.
+bool FastWriteFile(const fs::path &rp, const std::string &content);
 
 }  // namespace jk::common
@@ -0,0 +1,281 @@
+// Copyright (c) 2020 - present, Hawtian Wang (twistoy.wang@gmail.com)
+//
+
+#include "jk/common/process.hh"
+
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <iterator>
+#include <thread>
+
+#include "jk/core/error.h"
+#include "jk/utils/logging.hh"
+#include "jk/utils/str.hh"
+
+namespace jk::common {
+
+static std::vector<char *> make_argv(const std::vector<std::string> &argv) {
+  std::vector<char *> res;
+  res.reserve(argv.size() + 1);
+  for (const auto &arg : argv) {
+    res.push_back(const_cast<char *>(arg.c_str()));
+  }
+  res.push_back(nullptr);
+  return res;
+}
+
+int RunProcess(const std::vector<std::string> &argv,
+               const std::function<void(std::string_view)> &on_output) {
+  if (argv.empty()) {
+    JK_THROW(core::JKBuildError("Can't run an empty command."));
+  }
+
+  int fds[2] = {-1, -1};
+  if (on_output && ::pipe(fds) != 0) {
+    JK_THROW(core::JKBuildError("pipe failed: {}", strerror(errno)));
+  }
+
+  auto c_argv = make_argv(argv);
+
+  pid_t pid = ::fork();
+  if (pid < 0) {
+    JK_THROW(core::JKBuildError("fork failed: {}", strerror(errno)));
+  }
+
+  if (pid == 0) {
+    if (on_output) {
+      ::dup2(fds[1], STDOUT_FILENO);
+      ::close(fds[0]);
+      ::close(fds[1]);
+    }
+    ::execvp(c_argv[0], c_argv.data());
+    ::_exit(127);
+  }
+
+  if (on_output) {
+    ::close(fds[1]);
+
+    char buffer[65536];
+    while (true) {
+      auto n = ::read(fds[0], buffer, sizeof(buffer));
+      if (n < 0 && errno == EINTR) {
+        continue;
+      }
+      if (n <= 0) {
+        break;
+      }
+      on_output({buffer, static_cast<size_t>(n)});
+    }
+    ::close(fds[0]);
+  }
+
+  int status = 0;
+  while (::waitpid(pid, &status, 0) < 0) {
+    if (errno != EINTR) {
+      JK_THROW(core::JKBuildError("waitpid failed: {}", strerror(errno)));
+    }
+  }
+
+  if (WIFSIGNALED(status)) {
+    return 128 + WTERMSIG(status);
+  }
+  return WEXITSTATUS(status);
+}
+
+static int exit_code(int status) {
+  if (WIFSIGNALED(status)) {
+    return 128 + WTERMSIG(status);
+  }
+  return WEXITSTATUS(status);
+}
+
+//! Returns a fd which becomes readable when `pid` exits, or -1 if not
+//! supported by the kernel.
+static int open_pidfd(pid_t pid) {
+#if defined(SYS_pidfd_open)
+  return static_cast<int>(::syscall(SYS_pidfd_open, pid, 0));
+#else
+  (void)pid;
+  return -1;
+#endif
+}
+
+//! Waits `pid` for at most `timeout`, 0 for no limit. Returns false if timed
+//! out, then the process group of `pid` is killed, with everything the child
+//! started.
+static bool wait_child(pid_t pid, std::chrono::milliseconds timeout,
+                       int *status) {
+  using Clock = std::chrono::steady_clock;
+
+  if (timeout.count() > 0) {
+    auto deadline = Clock::now() + timeout;
+    int pidfd     = open_pidfd(pid);
+
+    while (true) {
+      auto left = std::chrono::duration_cast<std::chrono::milliseconds>(
+          deadline - Clock::now());
+      if (left.count() <= 0) {
+        break;
+      }
+
+      if (pidfd >= 0) {
+        pollfd pfd{pidfd, POLLIN, 0};
+        auto rc = ::poll(&pfd, 1, static_cast<int>(left.count()));
+        if (rc < 0 && errno == EINTR) {
+          continue;
+        }
+        if (rc == 0) {
+          continue;
+        }
+      }
+
+      auto r = ::waitpid(pid, status, WNOHANG);
+      if (r == pid) {
+        if (pidfd >= 0) {
+          ::close(pidfd);
+        }
+        return true;
+      }
+      if (r < 0 && errno != EINTR) {
+        JK_THROW(core::JKBuildError("waitpid failed: {}", strerror(errno)));
+      }
+      if (pidfd < 0) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+      }
+    }
+
+    if (pidfd >= 0) {
+      ::close(pidfd);
+    }
+    ::kill(-pid, SIGKILL);
+  }
+
+  while (::waitpid(pid, status, 0) < 0) {
+    if (errno != EINTR) {
+      JK_THROW(core::JKBuildError("waitpid failed: {}", strerror(errno)));
+    }
+  }
+  return timeout.count() == 0;
+}
+
+ProcessResult RunProcess(const std::vector<std::string> &argv,
+                         const ProcessOptions &options) {
+  if (argv.empty()) {
+    JK_THROW(core::JKBuildError("Can't run an empty command."));
+  }
+
+  // prepare everything before fork, only async-signal-safe calls are allowed
+  // in the child
+  auto c_argv = make_argv(argv);
+
+  std::vector<std::string> env_storage;
+  for (char **e = environ; *e != nullptr; ++e) {
+    std::string_view entry{*e};
+    bool overridden = false;
+    for (const auto &[key, value] : options.Env) {
+      if (entry.size() > key.size() && entry.substr(0, key.size()) == key &&
+          entry[key.size()] == '=') {
+        overridden = true;
+        break;
+      }
+    }
+    if (!overridden) {
+      env_storage.emplace_back(entry);
+    }
+  }
+  for (const auto &[key, value] : options.Env) {
+    env_storage.push_back(key + "=" + value);
+  }
+  auto c_envp = make_argv(env_storage);
+
+  int log_fd = -1;
+  if (options.LogFile) {
+    log_fd = ::open(options.LogFile->c_str(),
+                    O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (log_fd < 0) {
+      JK_THROW(core::JKBuildError("open {} failed: {}",
+                                  options.LogFile->string(),
+                                  strerror(errno)));
+    }
+  }
+
+  auto start = std::chrono::steady_clock::now();
+
+  pid_t pid = ::fork();
+  if (pid < 0) {
+    JK_THROW(core::JKBuildError("fork failed: {}", strerror(errno)));
+  }
+
+  // a timed child leads its own process group, so its children can be killed
+  // with it; both sides set it, whichever runs first
+  bool own_group = options.Timeout.count() > 0;
+  if (pid == 0) {
+    if (own_group) {
+      ::setpgid(0, 0);
+    }
+    if (log_fd >= 0) {
+      ::dup2(log_fd, STDOUT_FILENO);
+      ::dup2(log_fd, STDERR_FILENO);
+    }
+    ::execvpe(c_argv[0], c_argv.data(), c_envp.data());
+    ::_exit(127);
+  }
+
+  if (own_group) {
+    ::setpgid(pid, pid);
+  }
+  if (log_fd >= 0) {
+    ::close(log_fd);
+  }
+
+  int status = 0;
+  ProcessResult res;
+  res.TimedOut = !wait_child(pid, options.Timeout, &status);
+  res.ExitCode = exit_code(status);
+  res.Elapsed  = std::chrono::duration_cast<std::chrono::milliseconds>(
+      std::chrono::steady_clock::now() - start);
+  return res;
+}
+
+void ExecProcess(const std::vector<std::string> &argv) {
+  if (argv.empty()) {
+    JK_THROW(core::JKBuildError("Can't run an empty command."));
+  }
+
+  auto c_argv = make_argv(argv);
+  ::execvp(c_argv[0], c_argv.data());
+
+  JK_THROW(
+      core::JKBuildError("exec {} failed: {}", argv[0], strerror(errno)));
+}
+
+std::optional<std::filesystem::path> FindProgram(const std::string &name) {
+  if (name.find('/') != std::string::npos) {
+    return std::filesystem::path{name};
+  }
+
+  auto env_path = getenv("PATH");
+  if (env_path == nullptr) {
+    return {};
+  }
+
+  std::vector<std::string> dirs;
+  utils::SplitString(env_path, std::back_inserter(dirs), ':');
+  for (const auto &dir : dirs) {
+    auto p = std::filesystem::path{dir.empty() ? "." : dir} / name;
+    if (::access(p.c_str(), X_OK) == 0) {
+      return p;
+    }
+  }
+  return {};
+}
+
+}  // namespace jk::common
@@ -0,0 +1,51 @@
+// Copyright (c) 2020 - present, Hawtian Wang (twistoy.wang@gmail.com)
+//
+
+#pragma once  // NOLINT(build/header_guard)
+
+#include <chrono>
+#include <filesystem>
+#include <functional>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace jk::common {
+
+//! Runs `argv` and waits for it to exit. If `on_output` is set, stdout of the
+//! child will be passed to it chunk by chunk, otherwise the child inherits
+//! stdout. Returns the exit code, or 128 + signal number if killed.
+int RunProcess(const std::vector<std::string> &argv,
+               const std::function<void(std::string_view)> &on_output = {});
+
+struct ProcessOptions {
+  //! Extra environment variables of the child
+  std::vector<std::pair<std::string, std::string>> Env;
+  //! If set, stdout and stderr of the child will be written into it
+  std::optional<std::filesystem::path> LogFile;
+  //! Kills the child if it runs longer than it, 0 for no limit. A child with
+  //! a limit runs in its own process group, killed as a whole.
+  std::chrono::milliseconds Timeout{0};
+};
+
+struct ProcessResult {
+  //! Exit code, or 128 + signal number if killed
+  int ExitCode = 0;
+  bool TimedOut = false;
+  std::chrono::milliseconds Elapsed{0};
+};
+
+//! Runs `argv` with `options` and waits for it to exit or time out.
+ProcessResult RunProcess(const std::vector<std::string> &argv,
+                         const ProcessOptions &options);
+
+//! Returns the path of program `name`, looked up in `PATH` if it has no
+//! '/', same as the shell does.
+std::optional<std::filesystem::path> FindProgram(const std::string &name);
+
+//! Replaces current process with `argv`, only returns by throwing.
+[[noreturn]] void ExecProcess(const std::vector<std::string> &argv);
+
+}  // namespace jk::common
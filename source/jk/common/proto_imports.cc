@@ -0,0 +1,227 @@
+// Copyright (c) 2020 - present, Hawtian Wang (twistoy.wang@gmail.com)
+//
+
+#include "jk/common/proto_imports.hh"
+
+#include <algorithm>
+#include <cctype>
+#include <fstream>
+#include <iterator>
+#include <optional>
+#include <set>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include "absl/strings/str_join.h"
+#include "fmt/format.h"
+#include "jk/common/path.hh"
+#include "jk/version.h"
+
+namespace jk::common {
+
+namespace fs = std::filesystem;
+
+namespace {
+
+struct Token {
+  enum class Type { kIdentifier, kString, kSymbol };
+  Type Kind;
+  std::string Value;
+};
+
+class ProtoLexer {
+ public:
+  explicit ProtoLexer(std::string_view content) : content_(content) {
+  }
+
+  std::optional<Token> Next() {
+    skip_spaces_and_comments();
+    if (pos_ >= content_.size()) {
+      return {};
+    }
+
+    char ch = content_[pos_];
+    if (std::isalpha(static_cast<unsigned char>(ch)) || ch == '_') {
+      auto start = pos_;
+      while (pos_ < content_.size() &&
+             (std::isalnum(static_cast<unsigned char>(content_[pos_])) ||
+              content_[pos_] == '_' || content_[pos_] == '.')) {
+        pos_++;
+      }
+      return Token{Token::Type::kIdentifier,
+                   std::string{content_.substr(start, pos_ - start)}};
+    }
+
+    if (ch == '"' || ch == '\'') {
+      return Token{Token::Type::kString, read_string(ch)};
+    }
+
+    pos_++;
+    return Token{Token::Type::kSymbol, std::string(1, ch)};
+  }
+
+ private:
+  void skip_spaces_and_comments() {
+    while (pos_ < content_.size()) {
+      if (std::isspace(static_cast<unsigned char>(content_[pos_]))) {
+        pos_++;
+      } else if (content_.substr(pos_, 2) == "//") {
+        auto end = content_.find('\n', pos_);
+        pos_     = end == std::string_view::npos ? content_.size() : end;
+      } else if (content_.substr(pos_, 2) == "/*") {
+        auto end = content_.find("*/", pos_ + 2);
+        pos_     = end == std::string_view::npos ? content_.size() : end + 2;
+      } else {
+        break;
+      }
+    }
+  }
+
+  std::string read_string(char quote) {
+    std::string res;
+    pos_++;
+    while (pos_ < content_.size() && content_[pos_] != quote &&
+           content_[pos_] != '\n') {
+      if (content_[pos_] == '\\' && pos_ + 1 < content_.size()) {
+        pos_++;
+      }
+      res.push_back(content_[pos_++]);
+    }
+    pos_++;
+    return res;
+  }
+
+  std::string_view content_;
+  std::size_t pos_ = 0;
+};
+
+}  // namespace
+
+std::vector<std::string> ScanProtoImports(std::string_view content) {
+  std::vector<std::string> res;
+  ProtoLexer lexer(content);
+
+  // import [public|weak] "path";
+  std::optional<Token> tok;
+  bool statement_start = true;
+  while ((tok = lexer.Next())) {
+    bool is_import = statement_start &&
+                     tok->Kind == Token::Type::kIdentifier &&
+                     tok->Value == "import";
+    statement_start = tok->Kind == Token::Type::kSymbol &&
+                      (tok->Value == ";" || tok->Value == "{" ||
+                       tok->Value == "}");
+    if (!is_import) {
+      continue;
+    }
+
+    tok = lexer.Next();
+    if (tok && tok->Kind == Token::Type::kIdentifier &&
+        (tok->Value == "public" || tok->Value == "weak")) {
+      tok = lexer.Next();
+    }
+    if (!tok || tok->Kind != Token::Type::kString) {
+      continue;
+    }
+    auto path = std::move(tok->Value);
+
+    tok = lexer.Next();
+    if (tok && tok->Kind == Token::Type::kSymbol && tok->Value == ";") {
+      res.push_back(std::move(path));
+      statement_start = true;
+    }
+  }
+
+  return res;
+}
+
+std::string ProtoImportsFragment(const std::vector<std::string> &imports) {
+  return fmt::format(R"(# Generated by JK, JK Version {}
+# Refreshed when any proto file of the rule changes.
+
+PROTO_IMPORTS := {}
+)",
+                     JK_VERSION, absl::StrJoin(imports, " "));
+}
+
+void WriteProtoImportsFragment(const fs::path &output,
+                               const std::vector<std::string> &imports) {
+  if (!FastWriteFile(output, ProtoImportsFragment(imports))) {
+    fs::last_write_time(output, fs::file_time_type::clock::now());
+  }
+}
+
+auto ProtoImportScanner::direct_imports(const fs::path &root,
+                                        const std::string &proto)
+    -> const std::vector<std::string> & {
+  if (auto it = direct_.find(proto); it != direct_.end()) {
+    return it->second;
+  }
+
+  std::ifstream ifs(proto);
+  std::string content{std::istreambuf_iterator<char>{ifs},
+                      std::istreambuf_iterator<char>{}};
+
+  std::vector<std::string> res;
+  for (const auto &imported : ScanProtoImports(content)) {
+    auto p = root / imported;
+    if (fs::exists(p)) {
+      res.push_back(p.lexically_normal().string());
+    }
+  }
+  return direct_[proto] = std::move(res);
+}
+
+auto ProtoImportScanner::TransitiveImports(const fs::path &root,
+                                           const fs::path &proto)
+    -> std::vector<std::string> {
+  auto key = proto.lexically_normal().string();
+
+  std::lock_guard lk(mutex_);
+  if (auto it = transitive_.find(key); it != transitive_.end()) {
+    return it->second;
+  }
+
+  std::unordered_set<std::string> visited{key};
+  std::vector<std::string> stack{key};
+  std::vector<std::string> res;
+  while (!stack.empty()) {
+    auto current = std::move(stack.back());
+    stack.pop_back();
+
+    if (auto it = transitive_.find(current);
+        it != transitive_.end() && current != key) {
+      // already known, no need to go deeper
+      for (const auto &imported : it->second) {
+        if (visited.insert(imported).second) {
+          res.push_back(imported);
+        }
+      }
+      continue;
+    }
+
+    for (const auto &imported : direct_imports(root, current)) {
+      if (visited.insert(imported).second) {
+        res.push_back(imported);
+        stack.push_back(imported);
+      }
+    }
+  }
+
+  std::sort(res.begin(), res.end());
+  return transitive_[key] = std::move(res);
+}
+
+auto ProtoImportScanner::TransitiveImports(const fs::path &root,
+                                           const std::vector<fs::path> &protos)
+    -> std::vector<std::string> {
+  std::set<std::string> res;
+  for (const auto &proto : protos) {
+    auto imports = TransitiveImports(root, proto);
+    res.insert(imports.begin(), imports.end());
+  }
+  return {res.begin(), res.end()};
+}
+
+}  // namespace jk::common
@@ -0,0 +1,54 @@
+// Copyright (c) 2020 - present, Hawtian Wang (twistoy.wang@gmail.com)
+//
+
+#pragma once  // NOLINT(build/header_guard)
+
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace jk::common {
+
+//! Returns files imported by proto source `content` in order, including
+//! `import public` and `import weak`. Comments are skipped.
+std::vector<std::string> ScanProtoImports(std::string_view content);
+
+//! Returns content of the make fragment which defines `PROTO_IMPORTS` as
+//! `imports`, the imported protos of a proto_library rule.
+std::string ProtoImportsFragment(const std::vector<std::string> &imports);
+
+//! Writes the make fragment of `imports` into `output`. It's touched even if
+//! the content is unchanged, since make compares it with the proto files.
+void WriteProtoImportsFragment(const std::filesystem::path &output,
+                               const std::vector<std::string> &imports);
+
+//! Transitive imports of proto files, memoized. Thread-safe.
+class ProtoImportScanner {
+ public:
+  //! Returns all proto files transitively imported by `proto`, in absolute
+  //! paths and sorted. Imports are resolved from `root`, same as protoc's
+  //! `-I<root>`. Imports not found in `root`, e.g. from protobuf itself, are
+  //! ignored.
+  std::vector<std::string> TransitiveImports(const std::filesystem::path &root,
+                                             const std::filesystem::path &proto);
+
+  //! Returns all proto files transitively imported by any of `protos`, in
+  //! absolute paths, sorted and without duplicates.
+  std::vector<std::string> TransitiveImports(
+      const std::filesystem::path &root,
+      const std::vector<std::filesystem::path> &protos);
+
+ private:
+  //! Returns direct imports of `proto` which exist in `root`.
+  const std::vector<std::string> &direct_imports(
+      const std::filesystem::path &root, const std::string &proto);
+
+  std::mutex mutex_;
+  std::unordered_map<std::string, std::vector<std::string>> direct_;
+  std::unordered_map<std::string, std::vector<std::string>> transitive_;
+};
+
+}  // namespace jk::common
@@ -0,0 +1,86 @@
+// Copyright (c) 2020 - present, Hawtian Wang (twistoy.wang@gmail.com)
+//
+
+#include "jk/common/version_stamp.hh"
+
+#include <string>
+#include <string_view>
+
+#include "absl/strings/ascii.h"
+#include "fmt/format.h"
+#include "jk/common/path.hh"
+#include "jk/common/process.hh"
+#include "jk/version.h"
+
+namespace jk::common {
+
+std::string GitDescribe(const std::filesystem::path &dir) {
+  std::string output;
+  auto code = RunProcess(
+      {"git", "-C", dir.string(), "describe", "--tags", "--always"},
+      [&output](std::string_view chunk) {
+        output.append(chunk);
+      });
+  if (code != 0) {
+    return "";
+  }
+
+  absl::StripAsciiWhitespace(&output);
+  return output;
+}
+
+std::filesystem::path FindGitRepository(const std::filesystem::path &dir) {
+  std::error_code ec;
+  for (auto p = dir; !p.empty(); p = p.parent_path()) {
+    if (std::filesystem::exists(p / ".git", ec)) {
+      return p;
+    }
+    if (p == p.parent_path()) {
+      break;
+    }
+  }
+  return {};
+}
+
+//! Escapes `s` as a c string literal, quoted for the shell, then for make.
+static std::string escape_define(std::string_view s) {
+  std::string literal = "\"";
+  for (auto ch : s) {
+    if (ch == '"' || ch == '\\') {
+      literal.push_back('\\');
+    }
+    literal.push_back(ch);
+  }
+  literal.push_back('"');
+
+  std::string res = "\"";
+  for (auto ch : literal) {
+    if (ch == '"' || ch == '\\' || ch == '`' || ch == '$') {
+      res.push_back('\\');
+    }
+    if (ch == '$') {
+      res.push_back('$');
+    } else if (ch == '#') {
+      res.push_back('\\');
+    }
+    res.push_back(ch);
+  }
+  res.push_back('"');
+  return res;
+}
+
+std::string GitDescFragment(std::string_view git_desc) {
+  return fmt::format(R"(# Generated by JK, JK Version {}
+# Refreshed by `pre` of the root Makefile once per build.
+
+GIT_DESC := -DGIT_DESC={}
+)",
+                     JK_VERSION, escape_define(git_desc));
+}
+
+bool WriteGitDescFragment(const std::filesystem::path &output,
+                          std::string_view git_desc) {
+  return FastWriteFile(output, GitDescFragment(git_desc));
+}
+
+}  // namespace jk::common
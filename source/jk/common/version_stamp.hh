@@ -0,0 +1,30 @@
+// Copyright (c) 2020 - present, Hawtian Wang (twistoy.wang@gmail.com)
+//
+
+#pragma once  // NOLINT(build/header_guard)
+
+#include <filesystem>
+#include <string>
+#include <string_view>
+
+namespace jk::common {
+
+//! Returns output of `git describe --tags --always` in `dir`, empty if it
+//! failed.
+std::string GitDescribe(const std::filesystem::path &dir);
+
+//! Returns the top folder of the git repository `dir` is in, which has a
+//! `.git` folder, or a `.git` file for submodules and worktrees. Returns
+//! empty if `dir` is not in any repository.
+std::filesystem::path FindGitRepository(const std::filesystem::path &dir);
+
+//! Returns content of the make fragment which defines `GIT_DESC` as the
+//! compile flag `-DGIT_DESC="<git_desc>"`.
+std::string GitDescFragment(std::string_view git_desc);
+
+//! Writes the make fragment of `git_desc` into `output`, only if its content
+//! changed. Returns true if the file is written.
+bool WriteGitDescFragment(const std::filesystem::path &output,
+                          std::string_view git_desc);
+
+}  // namespace jk::common
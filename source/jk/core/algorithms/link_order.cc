@@ -0,0 +1,93 @@
+// Copyright (c) 2020 - present, Hawtian Wang (twistoy.wang@gmail.com)
+//
+
+#include "jk/core/algorithms/link_order.hh"
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "jk/core/algorithms/tarjan.hh"
+#include "jk/core/algorithms/topological_sort.hh"
+#include "jk/core/error.h"
+#include "jk/core/models/session.hh"
+#include "jk/utils/bitset.hh"
+#include "jk/utils/logging.hh"
+
+namespace jk::core::algorithms {
+
+void LinkOrderCache::Build(models::Session *session,
+                           const std::vector<StronglyConnectedComponent> &scc) {
+  build_types_ = session->BuildTypes;
+
+  deps_.clear();
+  deps_.reserve(scc.size());
+  for (const auto &s : scc) {
+    deps_.push_back(s.Deps);
+  }
+
+  // dependents are before their dependencies
+  auto sorted = topological_sort(scc);
+  order_.assign(scc.size(), 0);
+  for (auto i = 0u; i < sorted.size(); i++) {
+    order_[sorted[i]] = i;
+  }
+
+  fragments_.clear();
+  fragments_.resize(scc.size() * build_types_.size());
+  for (auto id : sorted) {
+    for (auto i = 0u; i < build_types_.size(); i++) {
+      auto &fragment = fragments_[id * build_types_.size() + i];
+
+      fragment.Arguments.push_back("-Wl,--start-group");
+      for (auto rule : scc[id].Rules) {
+        const auto &files = rule->ExportedFiles(session, build_types_[i]);
+        fragment.Files.insert(fragment.Files.end(), files.begin(),
+                              files.end());
+        fragment.Arguments.insert(fragment.Arguments.end(), files.begin(),
+                                  files.end());
+        fragment.Arguments.insert(fragment.Arguments.end(),
+                                  rule->ExportedLinkFlags.begin(),
+                                  rule->ExportedLinkFlags.end());
+      }
+      fragment.Arguments.push_back("-Wl,--end-group");
+    }
+  }
+}
+
+std::vector<uint32_t> LinkOrderCache::Dependencies(uint32_t id) const {
+  utils::DynamicBitset visited(deps_.size());
+  std::vector<uint32_t> res;
+  std::vector<uint32_t> stack(deps_[id].begin(), deps_[id].end());
+
+  while (!stack.empty()) {
+    auto u = stack.back();
+    stack.pop_back();
+    if (!visited.Set(u)) {
+      continue;
+    }
+    res.push_back(u);
+    for (auto v : deps_[u]) {
+      if (!visited.Test(v)) {
+        stack.push_back(v);
+      }
+    }
+  }
+
+  std::sort(res.begin(), res.end(), [this](uint32_t a, uint32_t b) {
+    return order_[a] < order_[b];
+  });
+  return res;
+}
+
+auto LinkOrderCache::Get(uint32_t id, std::string_view build_type) const
+    -> const Fragment & {
+  auto it = std::find(build_types_.begin(), build_types_.end(), build_type);
+  if (it == build_types_.end()) {
+    JK_THROW(core::JKBuildError("unknown build type {}", build_type));
+  }
+  return fragments_[id * build_types_.size() + (it - build_types_.begin())];
+}
+
+}  // namespace jk::core::algorithms
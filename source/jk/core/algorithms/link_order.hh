@@ -0,0 +1,51 @@
+// Copyright (c) 2020 - present, Hawtian Wang (twistoy.wang@gmail.com)
+//
+
+#pragma once  // NOLINT(build/header_guard)
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace jk::core::models {
+struct Session;
+}  // namespace jk::core::models
+
+namespace jk::core::algorithms {
+
+struct StronglyConnectedComponent;
+
+//! Link lines of cc binaries. What each SCC contributes to a link line is
+//! computed once per build type, and shared by all binaries depending on it.
+class LinkOrderCache {
+ public:
+  struct Fragment {
+    //! Files exported by rules in the SCC, prerequisites of binaries
+    std::vector<std::string> Files;
+    //! Exported files and link flags of rules in the SCC, in a linker group
+    std::vector<std::string> Arguments;
+  };
+
+  //! Computes fragments of all SCCs in all build types of `session`. Must be
+  //! called once all rules are prepared, and before any other methods.
+  void Build(models::Session *session,
+             const std::vector<StronglyConnectedComponent> &scc);
+
+  //! Returns SCCs which SCC `id` depends on directly or indirectly, in link
+  //! order: an SCC is before all SCCs it depends on.
+  std::vector<uint32_t> Dependencies(uint32_t id) const;
+
+  const Fragment &Get(uint32_t id, std::string_view build_type) const;
+
+ private:
+  std::vector<std::string> build_types_;
+  std::vector<std::vector<uint32_t>> deps_;
+  //! Position of each SCC in link order
+  std::vector<uint32_t> order_;
+  //! `fragments_[id * build_types_.size() + i]` is the fragment of SCC `id`
+  //! in the i-th build type
+  std::vector<Fragment> fragments_;
+};
+
+}  // namespace jk::core::algorithms
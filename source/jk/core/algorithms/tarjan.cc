@@ -0,0 +1,80 @@
+// Copyright (c) 2020 - present, Hawtian Wang (twistoy.wang@gmail.com)
+//
+
+#include "jk/core/algorithms/tarjan.hh"
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include "jk/utils/bitset.hh"
+
+namespace jk::core::algorithms {
+
+std::vector<std::vector<uint32_t>> StronglyConnectedComponents(
+    const models::RuleGraph &graph, std::span<const uint32_t> roots) {
+  struct Frame {
+    uint32_t Node;
+    //! Index of the next dependency to visit
+    uint32_t Next;
+  };
+
+  uint32_t dfncnt = 0;
+  std::vector<uint32_t> low(graph.Size(), 0), dfn(graph.Size(), 0);
+  utils::DynamicBitset in_stack(graph.Size());
+  std::vector<uint32_t> stack;
+  std::vector<Frame> frames;
+  std::vector<std::vector<uint32_t>> res;
+
+  auto enter = [&](uint32_t u) {
+    low[u] = dfn[u] = ++dfncnt;
+    stack.push_back(u);
+    in_stack.Set(u);
+    frames.push_back(Frame{.Node = u, .Next = 0});
+  };
+
+  for (auto root : roots) {
+    if (dfn[root] != 0) {
+      continue;
+    }
+
+    enter(root);
+    while (!frames.empty()) {
+      auto u    = frames.back().Node;
+      auto deps = graph.Dependencies(u);
+
+      if (frames.back().Next < deps.size()) {
+        auto v = deps[frames.back().Next++];
+        if (dfn[v] == 0) {
+          enter(v);
+        } else if (in_stack.Test(v)) {
+          low[u] = std::min(low[u], dfn[v]);
+        }
+        continue;
+      }
+
+      // all dependencies visited, return to the caller
+      frames.pop_back();
+      if (!frames.empty()) {
+        auto p = frames.back().Node;
+        low[p] = std::min(low[p], low[u]);
+      }
+
+      if (low[u] == dfn[u]) {
+        std::vector<uint32_t> component;
+        uint32_t v;
+        do {
+          v = stack.back();
+          stack.pop_back();
+          in_stack.Reset(v);
+          component.push_back(v);
+        } while (v != u);
+        res.push_back(std::move(component));
+      }
+    }
+  }
+
+  return res;
+}
+
+}  // namespace jk::core::algorithms
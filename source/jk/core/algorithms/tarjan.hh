@@ -4,7 +4,8 @@
 #pragma once  // NOLINT(build/header_guard)
 
 #include <algorithm>
-#include <stack>
+#include <cstdint>
+#include <span>
 #include <string>
 #include <vector>
 
@@ -12,6 +13,7 @@
 #include "absl/strings/str_join.h"
 #include "jk/core/models/build_rule.hh"
 #include "jk/core/models/build_rule_base.hh"
+#include "jk/core/models/rule_graph.hh"
 #include "jk/core/models/session.hh"
 #include "jk/utils/logging.hh"
 #include "range/v3/range/conversion.hpp"
@@ -26,68 +28,52 @@ struct StronglyConnectedComponent {
   std::vector<uint32_t> Deps;
 };
 
+//! Finds strongly connected components reachable from `roots` with Tarjan's
+//! algorithm. The walk keeps its own stack instead of recursing, so long
+//! dependency chains don't overflow worker threads' stacks.
+//!
+//! A component is found only after all components it depends on, so
+//! dependencies of the i-th component are all before it.
+std::vector<std::vector<uint32_t>> StronglyConnectedComponents(
+    const models::RuleGraph &graph, std::span<const uint32_t> roots);
+
 inline auto Tarjan(models::Session *session, auto rg) {
   static auto logger = utils::Logger("tarjan");
 
-  uint32_t dfncnt = 0;
-  std::stack<models::BuildRule *> stack;
-  std::vector<StronglyConnectedComponent> sccs;
-
-  std::vector<uint32_t> low(models::__CurrentObjectId(), 0),
-      dfn(models::__CurrentObjectId(), 0);
-  std::vector<bool> in_stack(models::__CurrentObjectId(), false);
+  const auto &graph = *session->Graph;
 
-  auto dfs = [&](models::BuildRule *rule, auto &&dfs) -> void {
-    ++dfncnt;
-
-    auto u = rule->Base->ObjectId;
+  std::vector<uint32_t> roots;
+  for (models::BuildRule *x : rg) {
+    roots.push_back(x->Base->ObjectId);
+  }
 
-    low[u] = dfn[u] = dfncnt;
-    stack.push(rule);
-    in_stack[u] = true;
+  auto components = StronglyConnectedComponents(graph, roots);
 
-    for (auto n : rule->Dependencies) {
-      auto v = n->Base->ObjectId;
-      if (dfn[v] == 0) {
-        dfs(n, dfs);
-        low[u] = std::min<uint32_t>(low[u], low[v]);
-      } else if (in_stack[n->Base->ObjectId]) {
-        low[u] = std::min<uint32_t>(low[u], dfn[v]);
-      }
+  std::vector<int32_t> scc_of(graph.Size(), -1);
+  for (auto i = 0u; i < components.size(); i++) {
+    for (auto u : components[i]) {
+      scc_of[u]              = static_cast<int32_t>(i);
+      graph.Rule(u)->_scc_id = static_cast<int32_t>(i);
     }
+  }
 
-    if (low[rule->Base->ObjectId] == dfn[rule->Base->ObjectId]) {
-      auto scc_id = sccs.size();
-      std::vector<models::BuildRule *> current_scc;
-      while (stack.top() != rule) {
-        stack.top()->_scc_id = scc_id;
-        current_scc.push_back(stack.top());
-        in_stack[stack.top()->Base->ObjectId] = false;
-        stack.pop();
-      }
-      assert(stack.top() == rule);
-      stack.top()->_scc_id = scc_id;
-      current_scc.push_back(stack.top());
-      in_stack[stack.top()->Base->ObjectId] = false;
-      stack.pop();
-
-      absl::flat_hash_set<uint32_t> Deps;
-      for (auto r : current_scc) {
-        for (auto d : r->Dependencies) {
-          assert(d->_scc_id >= 0);
-          if (d->_scc_id != scc_id) {
-            Deps.insert(d->_scc_id);
-          }
+  std::vector<StronglyConnectedComponent> sccs;
+  sccs.reserve(components.size());
+  for (auto i = 0u; i < components.size(); i++) {
+    absl::flat_hash_set<uint32_t> Deps;
+    std::vector<models::BuildRule *> rules;
+    for (auto u : components[i]) {
+      rules.push_back(graph.Rule(u));
+      for (auto d : graph.Dependencies(u)) {
+        assert(scc_of[d] >= 0);
+        if (scc_of[d] != static_cast<int32_t>(i)) {
+          Deps.insert(scc_of[d]);
         }
       }
-
-      sccs.push_back(StronglyConnectedComponent{
-          .Rules = std::move(current_scc), .Deps = Deps | ranges::to_vector});
     }
-  };
 
-  for (auto x : rg) {
-    dfs(x, dfs);
+    sccs.push_back(StronglyConnectedComponent{
+        .Rules = std::move(rules), .Deps = Deps | ranges::to_vector});
   }
 
   for (auto i = 0; i < sccs.size(); i++) {
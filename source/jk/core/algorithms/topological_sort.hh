@@ -3,6 +3,8 @@
 
 #pragma once  // NOLINT(build/header_guard)
 
+#include <cstdint>
+#include <queue>
 #include <vector>
 
 #include "jk/core/algorithms/tarjan.hh"
@@ -43,4 +45,44 @@ inline auto topological_sort(
   return sorted;
 }
 
+//! Groups SCCs into wavefront levels. Level 0 are SCCs without dependencies,
+//! SCCs in level `k` only depend on SCCs in levels before `k`. SCCs in the
+//! same level don't depend on each other, they can be handled in parallel
+//! once all levels before are done.
+inline auto TopologicalLevels(
+    const std::vector<StronglyConnectedComponent> &sccs)
+    -> std::vector<std::vector<uint32_t>> {
+  std::vector<uint32_t> pending(sccs.size(), 0);
+  std::vector<std::vector<uint32_t>> dependents(sccs.size());
+  for (auto i = 0u; i < sccs.size(); i++) {
+    pending[i] = sccs[i].Deps.size();
+    for (auto id : sccs[i].Deps) {
+      dependents[id].push_back(i);
+    }
+  }
+
+  std::vector<uint32_t> current;
+  for (auto i = 0u; i < sccs.size(); i++) {
+    if (pending[i] == 0) {
+      current.push_back(i);
+    }
+  }
+
+  std::vector<std::vector<uint32_t>> levels;
+  while (!current.empty()) {
+    std::vector<uint32_t> next;
+    for (auto id : current) {
+      for (auto n : dependents[id]) {
+        if (--pending[n] == 0) {
+          next.push_back(n);
+        }
+      }
+    }
+    levels.push_back(std::move(current));
+    current = std::move(next);
+  }
+
+  return levels;
+}
+
 }  // namespace jk::core::algorithms
@@ -4,6 +4,7 @@
 #include "jk/core/executor/script.hh"
 
 #include <fstream>
+#include <utility>
 #include <vector>
 
 #include "jk/core/models/session.hh"
@@ -68,7 +69,7 @@ auto ScriptInterpreter::Eval(const std::string &str)
     std::terminate();
   }
 
-  return results_;
+  return std::exchange(results_, {});
 }
 
 auto ScriptInterpreter::EvalFile(std::string_view filename)
@@ -3,11 +3,15 @@
 
 #include "jk/core/filesystem/configuration.hh"
 
+#include <algorithm>
+#include <map>
 #include <string>
 #include <string_view>
 #include <type_traits>
 #include <vector>
 
+#include "absl/strings/ascii.h"
+#include "jk/core/error.h"
 #include "jk/core/filesystem/project.hh"
 #include "jk/utils/logging.hh"
 
@@ -127,6 +131,66 @@ static T extract_value(const toml::value &value, const char *name,
   { "-static-libasan", "-Wl,-Bstatic,-lasan", "-Wl,-Bdynamic", "-ldl", }
 // }}}
 
+static BuildTypeConfiguration extract_build_type(
+    const toml::value &value, std::string name,
+    const BuildTypeConfiguration &default_value) {
+  BuildTypeConfiguration res;
+  res.name = std::move(name);
+  res.cflags_extra =
+      extract_value(value, "cflags_extra", default_value.cflags_extra);
+  res.cxxflags_extra =
+      extract_value(value, "cxxflags_extra", default_value.cxxflags_extra);
+  res.ld_flags_before =
+      extract_value(value, "ld_flags_before", default_value.ld_flags_before);
+  res.ld_flags_extra =
+      extract_value(value, "ld_flags_extra", default_value.ld_flags_extra);
+  return res;
+}
+
+//! Build types from table `build_types`, fields not given are taken from
+//! the builtin types, or empty for new types. Names are case-insensitive,
+//! stored in upper case.
+static std::vector<BuildTypeConfiguration> extract_build_types(
+    const toml::value &value,
+    std::vector<BuildTypeConfiguration> builtin_types) {
+  if (!value.is_table() || value.count("build_types") == 0 ||
+      !value.at("build_types").is_table()) {
+    return builtin_types;
+  }
+
+  const auto &table = value.at("build_types").as_table();
+
+  // upper-cased name => table of the build type
+  std::map<std::string, const toml::value *> types;
+  for (const auto &[name, type_value] : table) {
+    auto [it, inserted] =
+        types.emplace(absl::AsciiStrToUpper(name), &type_value);
+    if (!inserted) {
+      JK_THROW(core::JKBuildError(
+          "Build type {} is defined more than once, names are "
+          "case-insensitive",
+          it->first));
+    }
+  }
+
+  std::vector<BuildTypeConfiguration> res;
+  for (const auto &builtin : builtin_types) {
+    if (auto it = types.find(builtin.name); it != types.end()) {
+      res.push_back(extract_build_type(*it->second, builtin.name, builtin));
+      types.erase(it);
+    } else {
+      res.push_back(builtin);
+    }
+  }
+
+  for (const auto &[name, type_value] : types) {
+    res.push_back(
+        extract_build_type(*type_value, name, BuildTypeConfiguration{}));
+  }
+
+  return res;
+}
+
 static std::string CppLintDefaultValue(const JKProject *project) {
   if (project->IsOldStyle()) {
     // old style: use bundled
@@ -155,8 +219,61 @@ Configuration::Configuration(const JKProject *project, const toml::value &value)
       EXTRACT_VALUE(ld_flags, DEFAULT_LDFLAGS),
       EXTRACT_VALUE(release_ld_flags_extra, DEFAULT_RELEASE_LDFLAGS_EXTRA),
       EXTRACT_VALUE(profiling_ld_flags_extra, DEFAULT_PROFILING_LDFLAGS_EXTRA),
-      EXTRACT_VALUE(debug_ld_flags_extra, DEFAULT_DEBUG_LDFLAGS_EXTRA) {
+      EXTRACT_VALUE(debug_ld_flags_extra, DEFAULT_DEBUG_LDFLAGS_EXTRA),
+      EXTRACT_VALUE(archive_mode, "normal"),
+      EXTRACT_VALUE(linker, ""),
+      EXTRACT_VALUE(linker_threads, 0),
+      EXTRACT_VALUE(link_jobs, -1),
+      EXTRACT_VALUE(link_job_memory, 4096),
+      EXTRACT_VALUE(compile_cache, false),
+      EXTRACT_VALUE(compile_cache_dir, ""),
+      EXTRACT_VALUE(compile_cache_max_size, 5120) {
   cxxflags.push_back(fmt::format("-std=c++{}", cxx_standard));
+
+  if (archive_mode != "normal" && archive_mode != "thin" &&
+      archive_mode != "incremental") {
+    JK_THROW(core::JKBuildError(
+        "Unknown archive_mode: {}, expect normal, thin or incremental",
+        archive_mode));
+  }
+
+  if (!linker.empty() && linker != "bfd" && linker != "gold" &&
+      linker != "lld" && linker != "mold") {
+    JK_THROW(core::JKBuildError(
+        "Unknown linker: {}, expect bfd, gold, lld or mold", linker));
+  }
+
+  if (linker_threads > 0 && (linker.empty() || linker == "bfd")) {
+    JK_THROW(core::JKBuildError(
+        "linker_threads needs linker gold, lld or mold, bfd is single "
+        "threaded"));
+  }
+
+  if (compile_cache_max_size <= 0) {
+    JK_THROW(core::JKBuildError(
+        "compile_cache_max_size must be positive, got {}",
+        compile_cache_max_size));
+  }
+
+  build_types = extract_build_types(
+      value, {
+                 {"DEBUG", debug_cflags_extra, debug_cxxflags_extra,
+                  DEFAULT_DEBUG_LDFLAGS_BEFORE, debug_ld_flags_extra},
+                 {"RELEASE", release_cflags_extra, release_cxxflags_extra,
+                  {}, release_ld_flags_extra},
+                 {"PROFILING", profiling_cflags_extra, profiling_cxxflags_extra,
+                  {}, profiling_ld_flags_extra},
+             });
+}
+
+auto Configuration::BuildType(std::string_view name) const
+    -> const BuildTypeConfiguration & {
+  for (const auto &tp : build_types) {
+    if (tp.name == name) {
+      return tp;
+    }
+  }
+  JK_THROW(core::JKBuildError("Unknown build type: {}", name));
 }
 
 }  // namespace jk::core::filesystem
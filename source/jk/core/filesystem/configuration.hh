@@ -3,7 +3,9 @@
 
 #pragma once  // NOLINT(build/header_guard)
 
+#include <cstdint>
 #include <string>
+#include <string_view>
 #include <vector>
 
 #include "toml.hpp"
@@ -12,10 +14,23 @@ namespace jk::core::filesystem {
 
 struct JKProject;
 
+//! Flags of one build type, like 'DEBUG'.
+struct BuildTypeConfiguration {
+  std::string name;
+
+  std::vector<std::string> cflags_extra;
+  std::vector<std::string> cxxflags_extra;
+  std::vector<std::string> ld_flags_before;
+  std::vector<std::string> ld_flags_extra;
+};
+
 class Configuration {
  public:
   Configuration(const JKProject *project, const toml::value &value);
 
+  //! Returns the configuration of build type `name`, throws if not defined.
+  const BuildTypeConfiguration &BuildType(std::string_view name) const;
+
   std::string cpplint_path;
   std::string cxx_standard;
 
@@ -36,6 +51,35 @@ class Configuration {
   std::vector<std::string> release_ld_flags_extra;
   std::vector<std::string> profiling_ld_flags_extra;
   std::vector<std::string> debug_ld_flags_extra;
+
+  //! DEBUG, RELEASE and PROFILING come first, then others defined in table
+  //! `build_types` in name order.
+  std::vector<BuildTypeConfiguration> build_types;
+
+  //! How static libraries are archived:
+  //!   normal: recreate the archive with all objects
+  //!   thin: recreate a GNU thin archive, which only references objects
+  //!   incremental: only replace changed objects in the existing archive
+  std::string archive_mode;
+
+  //! Linker passed to `-fuse-ld`: bfd, gold, lld or mold. Empty to use the
+  //! compiler's default.
+  std::string linker;
+  //! Threads used by the linker, 0 to use the linker's default. Only gold,
+  //! lld and mold support it.
+  int64_t linker_threads;
+  //! Max concurrent link steps, 0 to decide by physical memory at build time,
+  //! negative (default) for no limit
+  int64_t link_jobs;
+  //! Memory reserved for each link step when `link_jobs` is 0, in MiB
+  int64_t link_job_memory;
+
+  //! Wrap compile commands with `jk cache_exec`
+  bool compile_cache;
+  //! Default is '.compile_cache' in build root
+  std::string compile_cache_dir;
+  //! In MiB
+  int64_t compile_cache_max_size;
 };
 
 }  // namespace jk::core::filesystem
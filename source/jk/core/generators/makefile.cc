@@ -6,6 +6,7 @@
 #include <vector>
 
 #include "absl/strings/ascii.h"
+#include "fmt/format.h"
 #include "jk/core/interfaces/writer.hh"
 #include "jk/version.h"
 #include "range/v3/range/conversion.hpp"
@@ -98,11 +99,54 @@ Makefile &Makefile::Include(std::string_view filename, std::string_view comment,
                             bool fatal) {
   print_comment(comment);
   if (fatal) {
-    print_line("include ", filename);
+    print_line("include ", shorten(filename));
   } else {
-    print_line("-include ", filename);
+    print_line("-include ", shorten(filename));
   }
   return *this;
 }
 
+Makefile &Makefile::PrefixVariable(std::string_view name,
+                                   std::string_view prefix) {
+  Env(name, prefix);
+  prefixes_.emplace_back(prefix,
+                         fmt::format("$({})", absl::AsciiStrToUpper(name)));
+  return *this;
+}
+
+std::string Makefile::define_list(std::string_view name,
+                                  const std::vector<std::string> &values,
+                                  std::string_view comment) {
+  auto key = absl::AsciiStrToUpper(name);
+
+  std::string line = key + " =";
+  for (const auto &value : values) {
+    line += " \\\n\t";
+    line += value;
+  }
+
+  print_comment(comment);
+  print_line(line);
+  print_line();
+  return fmt::format("$({})", key);
+}
+
+std::string Makefile::shorten(std::string_view str) const {
+  std::string res{str};
+  for (const auto &[prefix, ref] : prefixes_) {
+    size_t pos = 0;
+    while ((pos = res.find(prefix, pos)) != std::string::npos) {
+      auto end = pos + prefix.size();
+      // only whole path components, '/a/b' is not a prefix of '/a/bc'
+      if (end == res.size() || res[end] == '/' || res[end] == ' ') {
+        res.replace(pos, prefix.size(), ref);
+        pos += ref.size();
+      } else {
+        pos = end;
+      }
+    }
+  }
+  return res;
+}
+
 }  // namespace jk::core::generators
@@ -10,9 +10,11 @@
 #include <utility>
 #include <vector>
 
+#include "fmt/format.h"
 #include "jk/common/path.hh"
 #include "jk/core/builder/custom_command.hh"
 #include "jk/core/interfaces/writer.hh"
+#include "jk/utils/assert.hh"
 #include "range/v3/range/concepts.hpp"
 #include "range/v3/range/primitives.hpp"
 #include "range/v3/range/traits.hpp"
@@ -30,6 +32,23 @@ struct Makefile {
   Makefile &Env(std::string_view key, std::string_view value,
                 std::string_view comment = "");
 
+  //! Defines `name` as `prefix`. Paths starting with `prefix` in targets,
+  //! prerequisites, includes and recipes emitted after will be written as
+  //! `$(name)/...`.
+  Makefile &PrefixVariable(std::string_view name, std::string_view prefix);
+
+  //! Defines `name` as a list, one item per line. Returns the reference of
+  //! the variable, which could be used as a prerequisite or an argument.
+  template<ranges::range R>
+  std::string ListVariable(std::string_view name, R &&items,
+                           std::string_view comment = "") {
+    std::vector<std::string> values;
+    for (auto &&item : items) {
+      values.push_back(shorten(item));
+    }
+    return define_list(name, values, comment);
+  }
+
   template<ranges::range R, ranges::range U>
     requires std::convertible_to<ranges::range_value_t<U>,
                                  builder::CustomCommandLine>
@@ -37,16 +56,61 @@ struct Makefile {
                    U &&cmds = ranges::views::empty<builder::CustomCommandLine>,
                    std::string_view comment = "", bool phony = false) {
     print_comment(comment);
-    for (auto&& dep : deps) {
-      print_line(name, ": ", dep);
+
+    auto target = shorten(name);
+    print_rule(target + ':', std::forward<R>(deps), std::forward<U>(cmds));
+    if (phony) {
+      print_line(".PHONY: ", target);
     }
-    print_line(name, ":");
-    for (const auto &stmt : cmds) {
-      print_line("\t", stmt.Stringify());
+    print_line();
+    return *this;
+  }
+
+  //! Defines a grouped target: one run of `cmds` updates all of `names`, and
+  //! it runs again if any of them is missing or outdated. Grouped targets
+  //! need GNU make 4.3, older make runs `cmds` to update file `stamp`
+  //! instead, which all of `names` depend on. `names` must not be empty.
+  template<ranges::range N, ranges::range R, ranges::range U>
+    requires std::convertible_to<ranges::range_value_t<U>,
+                                 builder::CustomCommandLine>
+  Makefile &GroupedTarget(N &&names, R &&deps, U &&cmds,
+                          std::string_view stamp,
+                          std::string_view comment = "") {
+    print_comment(comment);
+
+    std::string targets;
+    for (auto &&name : names) {
+      if (!targets.empty()) {
+        targets += ' ';
+      }
+      targets += shorten(name);
     }
-    if (phony) {
-      print_line(".PHONY: ", name);
+    utils::assertion::boolean.expect(!targets.empty(),
+                                     "Grouped target without targets.");
+    std::vector<std::string> prerequisites;
+    for (auto &&dep : deps) {
+      prerequisites.push_back(shorten(dep));
+    }
+    std::vector<builder::CustomCommandLine> recipe;
+    for (auto &&cmd : cmds) {
+      recipe.push_back(cmd);
     }
+
+    print_line("ifneq ($(filter grouped-target,$(.FEATURES)),)");
+    print_rule(targets + " &:", prerequisites, recipe);
+    print_line("else");
+    // a missing output forces the stamp, same as the grouped target
+    auto stamp_target = shorten(stamp);
+    auto force        = stamp_target + ".force";
+    prerequisites.push_back(fmt::format(
+        "$(if $(filter-out $(wildcard {0}),{0}),{1})", targets, force));
+    recipe.push_back(builder::CustomCommandLine::Make(
+        {"@touch", std::string{stamp}}));
+    print_rule(stamp_target + ':', prerequisites, recipe);
+    print_line(force, ":");
+    print_line(".PHONY: ", force);
+    print_line(targets, ": ", stamp_target, " ;");
+    print_line("endif");
     print_line();
     return *this;
   }
@@ -61,6 +125,42 @@ struct Makefile {
   }
 
  private:
+  static constexpr size_t kMaxLineWidth = 80;
+
+  //! Prints `line`, the targets part of a rule, followed by prerequisites,
+  //! then the recipe.
+  template<ranges::range R, ranges::range U>
+  void print_rule(std::string line, R &&deps, U &&cmds) {
+    // wrap prerequisites, instead of one line per prerequisite
+    size_t width = line.size();
+    bool first   = true;
+    for (auto &&dep : deps) {
+      auto d = shorten(dep);
+      if (!first && width + d.size() + 1 > kMaxLineWidth) {
+        line += " \\\n\t";
+        width = 8;
+      } else {
+        line += ' ';
+        width += 1;
+      }
+      line += d;
+      width += d.size();
+      first = false;
+    }
+    print_line(line);
+
+    for (const auto &stmt : cmds) {
+      print_line("\t", shorten(stmt.Stringify()));
+    }
+  }
+
+  //! Replaces prefixes defined by `PrefixVariable` in `str`.
+  std::string shorten(std::string_view str) const;
+
+  std::string define_list(std::string_view name,
+                          const std::vector<std::string> &values,
+                          std::string_view comment);
+
   void print_range(auto rg) {
     for (const auto &p : rg) {
       print(p, " ");
@@ -119,6 +219,8 @@ struct Makefile {
  private:
   common::AbsolutePath path_;
   std::vector<std::unique_ptr<interfaces::Writer>> writers_;
+  //! pairs of (prefix, variable reference)
+  std::vector<std::pair<std::string, std::string>> prefixes_;
 };
 
 }  // namespace jk::core::generators
@@ -23,9 +23,15 @@ bool BuildRule::Prepared() const {
   return prepared_;
 }
 
+auto BuildRule::Extract(core::models::Session *session) -> std::future<void> {
+  return session->Executor->Push([this]() {
+    ExtractFieldFromArguments(Base->_kwargs);
+    Base->_kwargs.Release();
+  });
+}
+
 auto BuildRule::Prepare(core::models::Session *session) -> std::future<void> {
   return session->Executor->Push([this, session]() {
-    ExtractFieldFromArguments(Base->_kwargs);
     DoPrepare(session);
     prepared_ = true;
   });
@@ -45,6 +51,11 @@ const std::vector<std::string> &BuildRule::ExportedFiles(
 }
 
 auto BuildRule::ExtractFieldFromArguments(const utils::Kwargs &kwargs) -> void {
+  auto includes = kwargs.ListOptional("includes");
+  ExportedIncludes.assign(includes.begin(), includes.end());
+
+  auto defines = kwargs.ListOptional("defines");
+  ExportedDefines.assign(defines.begin(), defines.end());
 }
 
 BuildRule::~BuildRule() {
@@ -33,6 +33,11 @@ class BuildRule {
   //! Basic fields parsed from kwargs
   std::unique_ptr<BuildRuleBase> Base;
 
+  //! Extract fields from rule-function's arguments, then release them. All
+  //! rules should be extracted before any of them is prepared, preparing
+  //! reads fields of dependencies.
+  std::future<void> Extract(core::models::Session *session);
+
   std::future<void> Prepare(core::models::Session *session);
 
   //! Check if the build-rule is prepared.
@@ -46,6 +51,12 @@ class BuildRule {
 
   std::vector<std::string> InherentFlags;
 
+  //! Include paths and defines exported to cc rules depend on this one
+  // [[arg: `includes`]]
+  std::vector<std::string> ExportedIncludes;
+  // [[arg: `defines`]]
+  std::vector<std::string> ExportedDefines;
+
   //! Returns the absolute paths of what will this build-rule generated without
   //! build_type specifyed
   std::vector<std::string> Artifacts;
@@ -29,9 +29,8 @@ BuildRuleBase::BuildRuleBase(std::string type_name, RuleType type,
 
   Version = _kwargs.StringOptional("version", "DEFAULT");
 
-  Dependencies = [this] {
-    return _kwargs.ListOptional("deps", {{}});
-  }();
+  auto deps = _kwargs.ListOptional("deps");
+  Dependencies.assign(deps.begin(), deps.end());
 
   FullQualifiedName = fmt::format("{}/{}@{}", PackageName, Name, Version);
 
@@ -75,6 +75,7 @@ struct BuildRuleBase {
   //! '@@'.
   std::string FullQuotedQualifiedNameWithoutVersion;
 
+  //! Arguments of the rule-function, released once fields are extracted
   utils::Kwargs _kwargs;
 };
 
@@ -0,0 +1,167 @@
+// Copyright (c) 2020 - present, Hawtian Wang (twistoy.wang@gmail.com)
+//
+
+#include "jk/core/models/rule_graph.hh"
+
+#include <algorithm>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "jk/core/models/build_rule.hh"
+#include "jk/utils/bitset.hh"
+
+namespace jk::core::models {
+
+RuleGraph::RuleGraph(const std::vector<BuildRule *> &rules) {
+  rules_.resize(__CurrentObjectId(), nullptr);
+
+  std::vector<std::pair<uint32_t, uint32_t>> edges;
+  for (auto rule : rules) {
+    rules_[rule->Base->ObjectId] = rule;
+    for (auto dep : rule->Dependencies) {
+      edges.emplace_back(rule->Base->ObjectId, dep->Base->ObjectId);
+    }
+  }
+
+  offsets_.resize(rules_.size() + 1, 0);
+  build(edges);
+}
+
+RuleGraph::RuleGraph(uint32_t size,
+                     const std::vector<std::pair<uint32_t, uint32_t>> &edges) {
+  offsets_.resize(size + 1, 0);
+  build(edges);
+}
+
+void RuleGraph::build(
+    const std::vector<std::pair<uint32_t, uint32_t>> &edges) {
+  reverse_offsets_.resize(offsets_.size(), 0);
+
+  // counting sort by node, keeps the order of edges of the same node
+  for (auto [from, to] : edges) {
+    offsets_[from + 1]++;
+    reverse_offsets_[to + 1]++;
+  }
+  for (size_t i = 1; i < offsets_.size(); i++) {
+    offsets_[i] += offsets_[i - 1];
+    reverse_offsets_[i] += reverse_offsets_[i - 1];
+  }
+
+  edges_.resize(edges.size());
+  reverse_edges_.resize(edges.size());
+  std::vector<uint32_t> next(offsets_.begin(), offsets_.end() - 1);
+  std::vector<uint32_t> reverse_next(reverse_offsets_.begin(),
+                                     reverse_offsets_.end() - 1);
+  for (auto [from, to] : edges) {
+    edges_[next[from]++]               = to;
+    reverse_edges_[reverse_next[to]++] = from;
+  }
+}
+
+std::vector<uint32_t> RuleGraph::Closure(
+    std::span<const uint32_t> roots) const {
+  utils::DynamicBitset visited(Size());
+  std::vector<uint32_t> res;
+  std::vector<uint32_t> stack(roots.rbegin(), roots.rend());
+
+  while (!stack.empty()) {
+    auto u = stack.back();
+    stack.pop_back();
+    if (!visited.Set(u)) {
+      continue;
+    }
+    res.push_back(u);
+
+    // pushed in reverse, so dependencies are visited in their order
+    auto deps = Dependencies(u);
+    for (auto it = deps.rbegin(); it != deps.rend(); ++it) {
+      if (!visited.Test(*it)) {
+        stack.push_back(*it);
+      }
+    }
+  }
+
+  return res;
+}
+
+std::vector<uint32_t> RuleGraph::ReverseClosure(
+    std::span<const uint32_t> roots) const {
+  utils::DynamicBitset visited(Size());
+  std::vector<uint32_t> res;
+  for (auto u : roots) {
+    if (visited.Set(u)) {
+      res.push_back(u);
+    }
+  }
+
+  for (size_t i = 0; i < res.size(); i++) {
+    for (auto v : Dependents(res[i])) {
+      if (visited.Set(v)) {
+        res.push_back(v);
+      }
+    }
+  }
+
+  return res;
+}
+
+std::vector<uint32_t> RuleGraph::SomePath(std::span<const uint32_t> from,
+                                          std::span<const uint32_t> to) const {
+  utils::DynamicBitset target(Size());
+  for (auto u : to) {
+    target.Set(u);
+  }
+
+  // bfs, `parent[u]` is the node `u` reached from, `u` itself for roots
+  std::vector<uint32_t> parent(Size(), 0);
+  utils::DynamicBitset visited(Size());
+  std::vector<uint32_t> queue;
+  for (auto u : from) {
+    if (visited.Set(u)) {
+      parent[u] = u;
+      queue.push_back(u);
+    }
+  }
+
+  for (size_t i = 0; i < queue.size(); i++) {
+    auto u = queue[i];
+    if (!target.Test(u)) {
+      for (auto v : Dependencies(u)) {
+        if (visited.Set(v)) {
+          parent[v] = u;
+          queue.push_back(v);
+        }
+      }
+      continue;
+    }
+
+    std::vector<uint32_t> res{u};
+    while (parent[u] != u) {
+      u = parent[u];
+      res.push_back(u);
+    }
+    std::reverse(res.begin(), res.end());
+    return res;
+  }
+
+  return {};
+}
+
+std::vector<uint32_t> RuleGraph::AllPaths(std::span<const uint32_t> from,
+                                          std::span<const uint32_t> to) const {
+  utils::DynamicBitset reachable(Size());
+  for (auto u : ReverseClosure(to)) {
+    reachable.Set(u);
+  }
+
+  auto res = Closure(from);
+  res.erase(std::remove_if(res.begin(), res.end(),
+                           [&reachable](uint32_t u) {
+                             return !reachable.Test(u);
+                           }),
+            res.end());
+  return res;
+}
+
+}  // namespace jk::core::models
@@ -0,0 +1,82 @@
+// Copyright (c) 2020 - present, Hawtian Wang (twistoy.wang@gmail.com)
+//
+
+#pragma once  // NOLINT(build/header_guard)
+
+#include <cstdint>
+#include <span>
+#include <utility>
+#include <vector>
+
+namespace jk::core::models {
+
+class BuildRule;
+
+//! Dependency graph of all loaded rules, nodes are rules' `ObjectId`.
+//!
+//! Edges are stored in compressed sparse rows: dependencies of node `u` are
+//! `edges_[offsets_[u], offsets_[u + 1])`, in the same order as
+//! `BuildRule::Dependencies`. Reverse edges (dependents) are stored the same
+//! way. The graph is built once after dependencies resolved, and is
+//! read-only after that.
+class RuleGraph {
+ public:
+  //! Builds the graph from all rules, whose `Dependencies` are resolved.
+  explicit RuleGraph(const std::vector<BuildRule *> &rules);
+
+  //! Builds a graph of `size` nodes without rules, from (from, to) edges.
+  RuleGraph(uint32_t size,
+            const std::vector<std::pair<uint32_t, uint32_t>> &edges);
+
+  //! Number of nodes, ids are in [0, Size())
+  uint32_t Size() const {
+    return static_cast<uint32_t>(offsets_.size() - 1);
+  }
+
+  //! Returns the rule of node `id`, nullptr if no rule has this id
+  BuildRule *Rule(uint32_t id) const {
+    return rules_.empty() ? nullptr : rules_[id];
+  }
+
+  std::span<const uint32_t> Dependencies(uint32_t id) const {
+    return {edges_.data() + offsets_[id], edges_.data() + offsets_[id + 1]};
+  }
+
+  std::span<const uint32_t> Dependents(uint32_t id) const {
+    return {reverse_edges_.data() + reverse_offsets_[id],
+            reverse_edges_.data() + reverse_offsets_[id + 1]};
+  }
+
+  //! Returns `roots` and all nodes they depend on, in DFS pre-order.
+  std::vector<uint32_t> Closure(std::span<const uint32_t> roots) const;
+
+  std::vector<uint32_t> Closure(uint32_t root) const {
+    return Closure(std::span{&root, 1});
+  }
+
+  //! Returns `roots` and all nodes depend on them, in BFS order.
+  std::vector<uint32_t> ReverseClosure(std::span<const uint32_t> roots) const;
+
+  //! Returns a shortest path from one of `from` to one of `to`, following
+  //! dependencies. Empty if no such path.
+  std::vector<uint32_t> SomePath(std::span<const uint32_t> from,
+                                 std::span<const uint32_t> to) const;
+
+  //! Returns all nodes on any path from one of `from` to one of `to`, which
+  //! are nodes both in `Closure(from)` and `ReverseClosure(to)`, in the order
+  //! of `Closure(from)`.
+  std::vector<uint32_t> AllPaths(std::span<const uint32_t> from,
+                                 std::span<const uint32_t> to) const;
+
+ private:
+  void build(const std::vector<std::pair<uint32_t, uint32_t>> &edges);
+
+  std::vector<BuildRule *> rules_;
+
+  std::vector<uint32_t> offsets_;
+  std::vector<uint32_t> edges_;
+  std::vector<uint32_t> reverse_offsets_;
+  std::vector<uint32_t> reverse_edges_;
+};
+
+}  // namespace jk::core::models
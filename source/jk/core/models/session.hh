@@ -8,12 +8,15 @@
 #include <vector>
 
 #include "absl/container/flat_hash_map.h"
+#include "jk/common/proto_imports.hh"
+#include "jk/core/algorithms/link_order.hh"
 #include "jk/core/executor/worker_pool.hh"
 #include "jk/core/filesystem/configuration.hh"
 #include "jk/core/filesystem/project.hh"
 #include "jk/core/generators/compiledb.hh"
 #include "jk/core/interfaces/expander.hh"
 #include "jk/core/interfaces/writer.hh"
+#include "jk/core/models/rule_graph.hh"
 
 namespace jk::core::models {
 
@@ -22,6 +25,7 @@ struct Session {
 
   uint32_t TerminalColumns = 0;
 
+  //! Build types to generate, defaults to all types in configuration.
   std::vector<std::string> BuildTypes = {"DEBUG", "RELEASE", "PROFILING"};
 
   std::string JKPath = std::filesystem::read_symlink("/proc/self/exe");
@@ -40,7 +44,23 @@ struct Session {
 
   std::vector<std::string> ExtraFlags;
 
+  //! Merge sources of all cc rules into unity sources, rules without
+  //! `unity_batch` will use `DefaultUnityBatch`.
+  bool UnityBuild = false;
+
+  uint32_t DefaultUnityBatch = 8;
+
   std::unique_ptr<generators::Compiledb> CompilationDatabase;
+
+  //! Shared by all proto rules, so each proto file is scanned only once.
+  common::ProtoImportScanner ProtoImports;
+
+  //! Dependency graph of all loaded rules, built once dependencies of all
+  //! rules are resolved.
+  std::unique_ptr<RuleGraph> Graph;
+
+  //! Link lines of binaries, built once SCCs of rules to generate are found.
+  algorithms::LinkOrderCache LinkOrder;
 };
 
 }  // namespace jk::core::models
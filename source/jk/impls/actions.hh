@@ -9,6 +9,7 @@
 #include <concepts>
 #include <future>
 #include <list>
+#include <memory>
 #include <mutex>
 #include <optional>
 #include <string>
@@ -27,38 +28,63 @@
 #include "jk/impls/compilers/compiler_factory.hh"
 #include "jk/impls/rules/cc_binary.hh"
 #include "jk/utils/assert.hh"
+#include "jk/utils/bitset.hh"
 #include "jk/utils/logging.hh"
 #include "range/v3/algorithm/transform.hpp"
 #include "range/v3/range/concepts.hpp"
+#include "range/v3/range/conversion.hpp"
 #include "range/v3/range/traits.hpp"
 #include "range/v3/view/for_each.hpp"
 #include "range/v3/view/transform.hpp"
 
 namespace jk::impls {
 
-auto CompileRules(
+//! Compiles rules in `rg` level by level, `levels` are from
+//! `TopologicalLevels(scc)`. Rules in one level are compiled in parallel, and
+//! a level starts after all levels before it finished, so a rule is always
+//! emitted after its dependencies.
+void CompileRules(
     core::models::Session *session, std::string_view generator_name,
     const std::vector<core::algorithms::StronglyConnectedComponent> &scc,
+    const std::vector<std::vector<uint32_t>> &levels,
     impls::compilers::CompilerFactory *factory, auto &&rg)
   requires ranges::range<decltype(rg)> &&
            std::same_as<ranges::range_value_t<decltype(rg)>,
                         core::models::BuildRule *>
 {
   static auto logger = utils::Logger("generate_all");
-  std::vector<std::future<void>> futures;
+
+  utils::DynamicBitset selected(session->Graph->Size());
   for (auto rule : rg) {
-    futures.push_back(session->Executor->Push(
-        [&scc, generator_name, factory, rule, session]() {
-          core::interfaces::Compiler *c =
-              factory->Find(generator_name, rule->Base->TypeName);
-          if (c != nullptr) {
-            logger->debug("Compile {} use {}.{}", rule->Base->StringifyValue,
-                          generator_name, rule->Base->TypeName);
-            c->Compile(session, scc, rule);
-          }
-        }));
+    selected.Set(rule->Base->ObjectId);
+  }
+
+  std::vector<std::future<void>> futures;
+  for (const auto &level : levels) {
+    for (auto id : level) {
+      for (auto rule : scc[id].Rules) {
+        if (!selected.Test(rule->Base->ObjectId)) {
+          continue;
+        }
+        futures.push_back(session->Executor->Push(
+            [&scc, generator_name, factory, rule, session]() {
+              core::interfaces::Compiler *c =
+                  factory->Find(generator_name, rule->Base->TypeName);
+              if (c != nullptr) {
+                logger->debug("Compile {} use {}.{}",
+                              rule->Base->StringifyValue, generator_name,
+                              rule->Base->TypeName);
+                c->Compile(session, scc, rule);
+              }
+            }));
+      }
+    }
+
+    for (auto &f : futures) {
+      f.wait();
+    }
+    futures.clear();
   }
-  return futures;
 }
 
 void PrepareRules(core::models::Session *session, auto rg)
@@ -66,8 +92,21 @@ void PrepareRules(core::models::Session *session, auto rg)
            std::same_as<ranges::range_value_t<decltype(rg)>,
                         core::models::BuildRule *>
 {
-  std::vector<std::future<void>> futures;
+  std::vector<core::models::BuildRule *> rules;
   for (core::models::BuildRule *rule : rg) {
+    rules.push_back(rule);
+  }
+
+  std::vector<std::future<void>> futures;
+  for (auto rule : rules) {
+    futures.push_back(rule->Extract(session));
+  }
+  for (auto &f : futures) {
+    f.wait();
+  }
+
+  futures.clear();
+  for (auto rule : rules) {
     futures.push_back(rule->Prepare(session));
   }
   for (auto &f : futures) {
@@ -144,8 +183,10 @@ void PrepareDependencies(core::models::Session *session,
     }
   };
 
+  auto all_rules = rules | ranges::to_vector;
+
   auto futures =
-      rules |
+      all_rules |
       ranges::views::transform([session, &make_dep_str_to_rule](auto r) {
         return session->Executor->Push([&make_dep_str_to_rule, r]() {
           make_dep_str_to_rule(r);
@@ -155,6 +196,8 @@ void PrepareDependencies(core::models::Session *session,
   for (auto &f : futures) {
     f.wait();
   }
+
+  session->Graph = std::make_unique<core::models::RuleGraph>(all_rules);
 }
 
 inline auto LoadBuildFile(core::models::Session *session,
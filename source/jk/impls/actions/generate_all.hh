@@ -9,6 +9,7 @@
 
 #include "absl/strings/str_join.h"
 #include "jk/core/algorithms/tarjan.hh"
+#include "jk/core/algorithms/topological_sort.hh"
 #include "jk/core/models/build_package_factory.hh"
 #include "jk/core/models/build_rule_base.hh"
 #include "jk/core/models/build_rule_factory.hh"
@@ -90,30 +91,22 @@ auto generate_all(core::models::Session *session,
 
   auto scc = core::algorithms::Tarjan(session, ranges::views::all(arg_rules));
 
-  std::vector<bool> visited(core::models::__CurrentObjectId(), false);
-  std::vector<core::models::BuildRule *> all_rules;
-  auto dfs = [&visited, &all_rules](core::models::BuildRule *r, auto &&dfs) {
-    if (visited[r->Base->ObjectId]) {
-      return;
-    }
-    visited[r->Base->ObjectId] = true;
-    all_rules.push_back(r);
-
-    for (auto n : r->Dependencies) {
-      dfs(n, dfs);
-    }
-  };
+  auto arg_ids   = arg_rules | ranges::views::transform([](auto r) {
+                   return r->Base->ObjectId;
+                 }) |
+                 ranges::to_vector;
+  auto closure   = session->Graph->Closure(arg_ids);
+  auto all_rules = closure | ranges::views::transform([session](uint32_t id) {
+                     return session->Graph->Rule(id);
+                   }) |
+                   ranges::to_vector;
 
-  for (auto r : arg_rules) {
-    dfs(r, dfs);
-  }
+  session->LinkOrder.Build(session, scc);
 
+  auto levels = core::algorithms::TopologicalLevels(scc);
   for (auto generator_name : generator_names) {
-    auto res =
-        CompileRules(session, generator_name, scc, compiler_factory, all_rules);
-    for (auto &&f : res) {
-      f.wait();
-    }
+    CompileRules(session, generator_name, scc, levels, compiler_factory,
+                 all_rules);
   }
 
   // generate progress.mark
@@ -130,14 +123,11 @@ auto generate_all(core::models::Session *session,
   }
 
   // generate 'release/git_version.h'
-  {
-    auto folder =
-        session->Project->ProjectRoot.Sub(".build", "include", "release");
-    common::AssumeFolder(folder.Path);
-    std::ofstream ofs(folder.Sub("git_version.h").Stringify());
-    ofs << release_git_version_file_content;
-    ofs.flush();
-  }
+  common::FastWriteFile(session->Project->ProjectRoot
+                            .Sub(".build", "include", "release",
+                                 "git_version.h")
+                            .Path,
+                        release_git_version_file_content);
 
   return scc;
 }
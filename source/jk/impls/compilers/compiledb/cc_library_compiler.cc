@@ -69,6 +69,8 @@ auto CCLibraryCompiler::Compile(
       compile_flags, session->Project->Config().cflags,
       session->Project->Config().release_cflags_extra, cppincludes);
 
+  // one entry per source, also for members of unity batches, only make
+  // targets are batched
   std::vector<nlohmann::json> values;
   for (const auto &s : rule->ExpandedSourceFiles) {
     auto source_file = models::cc::SourceFile(s, rule);
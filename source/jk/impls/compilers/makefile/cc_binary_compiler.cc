@@ -3,12 +3,15 @@
 
 #include "jk/impls/compilers/makefile/cc_binary_compiler.hh"
 
+#include <algorithm>
+#include <iterator>
 #include <string_view>
+#include <vector>
 
 #include "absl/container/flat_hash_set.h"
 #include "absl/strings/str_join.h"
-#include "jk/core/algorithms/topological_sort.hh"
 #include "jk/impls/compilers/makefile/common.hh"
+#include "range/v3/algorithm/copy.hpp"
 #include "range/v3/numeric/iota.hpp"
 #include "range/v3/range/conversion.hpp"
 #include "range/v3/range/primitives.hpp"
@@ -32,48 +35,17 @@ auto CCBinaryCompiler::Name() const -> std::string_view {
   return "makefile.cc_binary";
 }
 
-static std::vector<std::string> DEBUG_LDFLAGS_BEFORE = {
-    "-ftest-coverage",
-    "-fprofile-arcs",
-};
-
 void CCBinaryCompiler::generate_build_file(
     core::models::Session *session, const common::AbsolutePath &working_folder,
     const std::vector<core::algorithms::StronglyConnectedComponent> &scc,
     rules::CCLibrary *rule) const {
+  // `{build_type}_LDFLAGS` are in the shared flags file
   auto makefile = new_makefile_with_common_commands(session, working_folder);
 
-  makefile.Env(
-      "DEBUG_LDFLAGS",
-      absl::StrJoin(ranges::views::concat(
-                        ranges::views::all(DEBUG_LDFLAGS_BEFORE),
-                        ranges::views::all(session->Project->Config().ld_flags),
-                        ranges::views::all(
-                            session->Project->Config().debug_ld_flags_extra)),
-                    " "));
-
-  makefile.Env(
-      "RELEASE_LDFLAGS",
-      absl::StrJoin(ranges::views::concat(
-                        ranges::views::all(session->Project->Config().ld_flags),
-                        ranges::views::all(
-                            session->Project->Config().release_ld_flags_extra)),
-                    " "));
-
-  makefile.Env(
-      "PROFILING_LDFLAGS",
-      absl::StrJoin(
-          ranges::views::concat(
-              ranges::views::all(session->Project->Config().ld_flags),
-              ranges::views::all(
-                  session->Project->Config().profiling_ld_flags_extra)),
-          " "));
-
-  core::builder::CustomCommandLines clean_statements;
-
-  // lint headers
-  std::vector<std::string> lint_header_targets =
-      lint_headers(session, working_folder, rule, &makefile);
+  std::vector<std::string> clean_files;
+
+  std::vector<std::string> lint_targets =
+      lint_files(session, working_folder, rule, &makefile);
 
   auto binary_progress_num = rule->Steps.Step(".binary");
 
@@ -84,69 +56,41 @@ void CCBinaryCompiler::generate_build_file(
       }) |
       ranges::to_vector;
 
+  auto unity_batches =
+      make_unity_batches(session, working_folder, rule, &source_files);
+
+  assert(scc[rule->_scc_id].Rules.size() == 1);
+  auto link_dependencies = session->LinkOrder.Dependencies(rule->_scc_id);
+  logger->debug("link dependencies of {}: [{}]", rule->Base->StringifyValue,
+                absl::StrJoin(link_dependencies, ", "));
+
   for (const auto &build_type : session->BuildTypes) {
     auto all_objects = add_source_files_commands(
-        session, working_folder, rule, &makefile, &lint_header_targets,
-        source_files, build_type, false);
+        session, working_folder, rule, &makefile, source_files, build_type);
+    ranges::copy(add_unity_batches_commands(session, working_folder, rule,
+                                            &makefile, unity_batches,
+                                            build_type),
+                 std::back_inserter(all_objects));
+    auto objects = makefile.ListVariable(fmt::format("{}_OBJECTS", build_type),
+                                         all_objects);
     auto binary_file = working_folder.Sub(build_type, rule->Base->Name);
     // deps:
     //   all_objects
-    //   lint_header_targets
-    assert(scc[rule->_scc_id].Rules.size() == 1);
-
-    auto visit_scc = [&](uint32_t id) {
-      return scc[id].Rules |
-             ranges::views::transform([&](core::models::BuildRule *r) {
-               return r->ExportedFiles(session, build_type);
-             }) |
-             ranges::views::join;
-    };
-    auto visit_scc_group = [&](uint32_t id) {
-      return ranges::views::concat(
-          ranges::views::single("-Wl,--start-group"),
-          scc[id].Rules |
-              ranges::views::transform([&](core::models::BuildRule *r) {
-                return ranges::views::concat(
-                    r->ExportedFiles(session, build_type),
-                    r->ExportedLinkFlags);
-              }) |
-              ranges::views::join,
-          ranges::views::single("-Wl,--end-group"));
-    };
-
-    absl::flat_hash_set<uint32_t> visited;
-    auto dfs = [&](uint32_t id, auto &&dfs) -> void {
-      for (uint32_t n : scc[id].Deps) {
-        visited.insert(n);
-        dfs(n, dfs);
-      }
-    };
-    dfs(rule->_scc_id, dfs);
-
-    logger->debug("visited {}: [{}]", rule->Base->StringifyValue,
-                  absl::StrJoin(visited, ", "));
-
-    auto sorted = core::algorithms::topological_sort(scc);
-
-    auto dependencies_artifact = sorted | ranges::views::filter([&](auto id) {
-                                   return visited.contains(id);
-                                 }) |
-                                 ranges::views::transform([&](auto id) {
-                                   return visit_scc(id);
-                                 });
-
-    auto deps_and_flags = sorted | ranges::views::filter([&](auto id) {
-                            return visited.contains(id);
-                          }) |
-                          ranges::views::transform([&](auto id) {
-                            return visit_scc_group(id);
-                          }) |
-                          ranges::views::join;
+    //   lint_targets
+    //   files exported by dependencies
+    //   shared flags file, which has ldflags
+    std::vector<std::string> dependency_files;
+    std::vector<std::string> link_arguments;
+    for (auto id : link_dependencies) {
+      const auto &fragment = session->LinkOrder.Get(id, build_type);
+      ranges::copy(fragment.Files, std::back_inserter(dependency_files));
+      ranges::copy(fragment.Arguments, std::back_inserter(link_arguments));
+    }
 
     auto deps = ranges::views::concat(
-        all_objects, lint_header_targets,
-        dependencies_artifact | ranges::views::join,
-        ranges::views::single(working_folder.Sub("build.make").Stringify()));
+        ranges::views::single(objects), lint_targets, dependency_files,
+        ranges::views::single(working_folder.Sub("build.make").Stringify()),
+        ranges::views::single(SharedFlagsFile(session).Stringify()));
 
     auto mkdir_stmt = core::builder::CustomCommandLine::Make(
         {"@$(MKDIR)", binary_file.Path.parent_path().string()});
@@ -159,8 +103,11 @@ void CCBinaryCompiler::generate_build_file(
          fmt::format("Linking binary {}", binary_file.Stringify())});
 
     auto link_stmt = core::builder::CustomCommandLine::FromVec(
-        ranges::views::concat(ranges::views::single("@$(LINKER)"), all_objects,
-                              deps_and_flags) |
+        ranges::views::concat(
+            ranges::views::single(std::string{"@$(LINK_POOL)"}),
+            ranges::views::single(std::string{"$(LINKER)"}),
+            ranges::views::single(std::string{"$(LINKER_FLAGS)"}),
+            ranges::views::single(objects), link_arguments) |
         ranges::to_vector);
     link_stmt.push_back("-g");
     link_stmt.push_back(fmt::format("${{{}_LDFLAGS}}", build_type));
@@ -172,16 +119,8 @@ void CCBinaryCompiler::generate_build_file(
                                           ranges::views::single(mkdir_stmt),
                                           ranges::views::single(link_stmt)));
 
-    clean_statements.push_back(core::builder::CustomCommandLine::Make(
-        {"@$(RM)", binary_file.Stringify()}));
-    for (const auto &obj : all_objects) {
-      clean_statements.push_back(
-          core::builder::CustomCommandLine::Make({"@$(RM)", obj}));
-    }
-    for (const auto &obj : lint_header_targets) {
-      clean_statements.push_back(
-          core::builder::CustomCommandLine::Make({"@$(RM)", obj}));
-    }
+    clean_files.push_back(binary_file.Stringify());
+    ranges::copy(all_objects, std::back_inserter(clean_files));
 
     auto build_target = working_folder.Sub(build_type, "build").Stringify();
     makefile.Target(build_target,
@@ -194,8 +133,12 @@ void CCBinaryCompiler::generate_build_file(
                     "Rule to build all files generated by this target.", true);
   }
 
+  ranges::copy(lint_targets, std::back_inserter(clean_files));
+
   makefile.Target("clean", ranges::views::empty<std::string>,
-                  ranges::views::all(clean_statements), "", true);
+                  ranges::views::single(
+                      CleanStatement(session, working_folder, clean_files)),
+                  "", true);
 
   end_of_generate_build_file(&makefile, session, working_folder, rule);
 }
@@ -4,6 +4,7 @@
 #include "jk/impls/compilers/makefile/cc_library_compiler.hh"
 
 #include <algorithm>
+#include <filesystem>
 #include <iterator>
 #include <string>
 #include <string_view>
@@ -11,6 +12,7 @@
 #include "absl/container/flat_hash_map.h"
 #include "absl/container/flat_hash_set.h"
 #include "absl/strings/str_join.h"
+#include "jk/common/depfile.hh"
 #include "jk/common/path.hh"
 #include "jk/core/builder/custom_command.hh"
 #include "jk/core/filesystem/project.hh"
@@ -35,6 +37,8 @@ namespace jk::impls::compilers::makefile {
 
 static auto logger = utils::Logger("compiler.makefile.cc_library");
 
+namespace fs = std::filesystem;
+
 static std::string FixCpp20Gcc2ClangFlags(const std::string &flag) {
   if (flag == "-fcoroutines") {
     return "-fcoroutines-ts";
@@ -70,36 +74,32 @@ auto CCLibraryCompiler::DoCompile(
 
   generate_flag_file(session, working_folder, rule);
 
-  generate_toolchain_file(session, working_folder, rule);
-
   generate_build_file(session, working_folder, scc, rule);
 }
 
-#define WORKING_FOLDER  "WORKING_FOLDER"
-#define CFLAGS          "CFLAGS"
-#define CPPFLAGS        "CPPFLAGS"
-#define CXXFLAGS        "CXXFLAGS"
-#define CFLAGS_SUFFIX   "_CFLAGS"
-#define CXXFLAGS_SUFFIX "_CXXFLAGS"
-#define CPP_INCLUDES    "CPP_INCLUDES"
-#define CPP_DEFINES     "CPP_DEFINES"
+#define WORKING_FOLDER "WORKING_FOLDER"
+#define CFLAGS         "CFLAGS"
+#define CPPFLAGS       "CPPFLAGS"
+#define CXXFLAGS       "CXXFLAGS"
+#define CPP_INCLUDES   "CPP_INCLUDES"
+#define CPP_DEFINES    "CPP_DEFINES"
 
 void CCLibraryCompiler::generate_flag_file(
     core::models::Session *session, const common::AbsolutePath &working_folder,
     rules::CCLibrary *rule) const {
-  static constexpr auto git_desc =
-      R"(-DGIT_DESC="\"`cd {} && git describe --tags --always`\"")";
-
   core::generators::Makefile makefile(working_folder.Sub("flags.make"),
                                       {session->WriterFactory.get()});
 
-  auto compile_flags = session->Project->Config().compile_flags;
-  compile_flags.push_back(
-      fmt::format(git_desc, rule->Package->Path.Stringify()));
-
   // environments
   makefile.Env(WORKING_FOLDER, working_folder.Stringify());
 
+  makefile.Include(
+      GitDescFile(session,
+                  GitRepository(session,
+                                session->Project->Resolve(rule->Package->Path)))
+          .Stringify(),
+      "Used by flags of build types in the shared flags file.");
+
   makefile.Env(CFLAGS, absl::StrJoin(rule->ExpandedCFileFlags | ranges::copy |
                                          ranges::actions::sort,
                                      " "));
@@ -117,63 +117,6 @@ void CCLibraryCompiler::generate_flag_file(
                                  ranges::actions::sort,
                              " "));
 
-  auto cppincludes = ranges::views::concat(
-      ranges::views::single("-isystem"),
-      ranges::views::single(fmt::format(
-          ".build/.lib/m{}/include",
-          session->Project->Platform == core::filesystem::TargetPlatform::k64
-              ? "64"
-              : "32")),
-      ranges::views::single("-I.build/include"));
-
-  static auto cxxincludes = ranges::views::single("-I.build/pb/c++");
-
-  makefile.Env(
-      "DEBUG" CFLAGS_SUFFIX,
-      absl::StrJoin(
-          ranges::views::concat(
-              compile_flags, session->Project->Config().cflags,
-              session->Project->Config().debug_cflags_extra, cppincludes),
-          " "));
-  makefile.Env(
-      "DEBUG" CXXFLAGS_SUFFIX,
-      absl::StrJoin(ranges::views::concat(
-                        compile_flags, session->Project->Config().cxxflags,
-                        session->Project->Config().debug_cxxflags_extra,
-                        cppincludes, cxxincludes),
-                    " "));
-
-  makefile.Env(
-      "RELEASE" CFLAGS_SUFFIX,
-      absl::StrJoin(
-          ranges::views::concat(
-              compile_flags, session->Project->Config().cflags,
-              session->Project->Config().release_cflags_extra, cppincludes),
-
-          " "));
-  makefile.Env(
-      "RELEASE" CXXFLAGS_SUFFIX,
-      absl::StrJoin(ranges::views::concat(
-                        compile_flags, session->Project->Config().cxxflags,
-                        session->Project->Config().release_cxxflags_extra,
-                        cppincludes, cxxincludes),
-                    " "));
-
-  makefile.Env(
-      "PROFILING" CFLAGS_SUFFIX,
-      absl::StrJoin(
-          ranges::views::concat(
-              compile_flags, session->Project->Config().cflags,
-              session->Project->Config().profiling_cflags_extra, cppincludes),
-          " "));
-  makefile.Env(
-      "PROFILING" CXXFLAGS_SUFFIX,
-      absl::StrJoin(ranges::views::concat(
-                        compile_flags, session->Project->Config().cxxflags,
-                        session->Project->Config().profiling_cxxflags_extra,
-                        cppincludes, cxxincludes),
-                    " "));
-
   makefile.Env(CPP_DEFINES,
                absl::StrJoin(rule->ResolvedDefines | ranges::to_vector |
                                  ranges::actions::sort,
@@ -204,107 +147,33 @@ void CCLibraryCompiler::generate_flag_file(
   dfs(rule, dfs);
 }
 
-void CCLibraryCompiler::generate_toolchain_file(
-    core::models::Session *session, const common::AbsolutePath &working_folder,
-    rules::CCLibrary *rule) const {
-  core::generators::Makefile makefile(working_folder.Sub("toolchain.make"),
-                                      {session->WriterFactory.get()});
-
-  makefile.Env(
-      "CXX",
-      fmt::format(
-          "{} {}", absl::StrJoin(session->Project->Config().cxx, " "),
-          session->Project->Platform == core::filesystem::TargetPlatform::k64
-              ? "-m64"
-              : "-m32"));
-
-  makefile.Env(
-      "CC",
-      fmt::format(
-          "{} {}", absl::StrJoin(session->Project->Config().cc, " "),
-          session->Project->Platform == core::filesystem::TargetPlatform::k64
-              ? "-m64"
-              : "-m32"));
-
-  makefile.Env("LINKER", "g++");
-
-  makefile.Env("AR", "ar rcs");
-
-  makefile.Env("RM", "$(JK_COMMAND) delete_file",
-               "The command to remove a file.");
-
-  makefile.Env("CPPLINT", session->Project->Config().cpplint_path);
-
-  makefile.Env("MKDIR", "mkdir -p");
+//! Dependency file of all objects of `build_type`, depfiles of objects are
+//! appended to its journal once compiled, and merged into it when make
+//! starts, so make reads one file instead of one per object.
+static common::AbsolutePath deps_log_file(
+    const common::AbsolutePath &working_folder, std::string_view build_type) {
+  return working_folder.Sub(build_type, "deps.make");
 }
 
-uint32_t add_source_files_lint_commands(
-    core::models::Session *session, const common::AbsolutePath &working_folder,
-    rules::CCLibrary *rule, core::generators::Makefile *makefile,
-    models::cc::SourceFile *source_file) {
-  auto file_type = source_file->IsHeaderFile ? "Header" : "CXX";
-  auto full_qualified_path =
-      session->Project->Resolve(source_file->FullQualifiedPath).Stringify();
-
-  auto progress_num = rule->Steps.Step(full_qualified_path);
-
-  auto source_file_path = source_file->ResolveFullQualifiedPath(working_folder);
-  auto lint_file_path =
-      source_file->ResolveFullQualifiedLintPath(working_folder);
-
-  auto print_stmt = core::builder::CustomCommandLine::Make(
-      {"@$(PRINT)", "--switch=$(COLOR)", "--green",
-       fmt::format("--progress-num={}", progress_num),
-       fmt::format("--progress-dir={}",
-                   session->Project->BuildRoot.Stringify()),
-       fmt::format("Linting {} file {}", file_type, full_qualified_path)});
-
-  using core::builder::operator""_c_raw;
-  auto lint_stmt = core::builder::CustomCommandLine::Make(
-      {"@$(CPPLINT)", full_qualified_path, ">/dev/null"_c_raw});
-  auto mkdir_stmt = core::builder::CustomCommandLine::Make(
-      {"@$(MKDIR)", source_file_path.Path.parent_path().string()});
-  auto touch_stmt = core::builder::CustomCommandLine::Make(
-      {"@touch", lint_file_path.Stringify()});
-
-  auto toolchain_file = working_folder.Sub("toolchain.make").Stringify();
-  makefile->Target(
-      lint_file_path.Stringify(),
-      ranges::views::concat(ranges::views::single(full_qualified_path),
-                            ranges::views::single(toolchain_file)),
-      ranges::views::concat(ranges::views::single(print_stmt),
-                            ranges::views::single(lint_stmt),
-                            ranges::views::single(mkdir_stmt),
-                            ranges::views::single(touch_stmt)));
-  return progress_num;
-}
-
-template<ranges::range R>
+template<ranges::range E>
 void add_source_file_commands(core::models::Session *session,
                               const common::AbsolutePath &working_folder,
                               rules::CCLibrary *rule,
                               core::generators::Makefile *makefile,
                               std::string_view build_type,
-                              models::cc::SourceFile *source_file, R headers,
-                              bool never_lint) {
+                              models::cc::SourceFile *source_file,
+                              E extra_deps) {
   std::list<std::string> deps{working_folder.Sub("flags.make").Stringify(),
-                              working_folder.Sub("toolchain.make").Stringify()};
+                              SharedFlagsFile(session).Stringify(),
+                              SharedToolchainFile(session).Stringify()};
 
   auto full_qualified_path = source_file->FullQualifiedPath.Stringify();
   auto source_filename =
       session->Project->Resolve(full_qualified_path).Stringify();
 
-  // if not in nolint.txt, lint file
-  if (!rule->InNolint(source_filename) && !never_lint) {
-    deps.push_back(
-        source_file->ResolveFullQualifiedLintPath(working_folder).Stringify());
-  }
-
   auto object_file =
       source_file->ResolveFullQualifiedObjectPath(working_folder, build_type);
 
-  makefile->Include(
-      source_file->ResolveFullQualifiedDotDPath(working_folder).Stringify());
   makefile->Target(object_file.Stringify(), deps,
                    ranges::views::empty<core::builder::CustomCommandLine>);
 
@@ -316,79 +185,129 @@ void add_source_file_commands(core::models::Session *session,
        fmt::format("Building CXX object {}", object_file.Stringify())});
 
   auto dep =
-      ranges::views::concat(headers, ranges::views::single(source_filename));
+      ranges::views::concat(extra_deps, ranges::views::single(source_filename));
 
   auto mkdir_stmt = core::builder::CustomCommandLine::Make(
       {"@$(MKDIR)", object_file.Path.parent_path().string()});
 
+  // appended by the shell instead of one more process per object, an
+  // O_APPEND write doesn't interleave with other compiles
+  core::builder::CustomArgument append_depfile(fmt::format(
+      "@if [ -f {0} ]; then cat {0} >> {1} && rm -f {0}; fi",
+      source_file->ResolveFullQualifiedDotDPath(working_folder, build_type)
+          .Stringify(),
+      common::DepsJournalFile(deps_log_file(working_folder, build_type).Path)
+          .string()));
+  append_depfile.Raw = true;
+  auto deps_log_stmt = core::builder::CustomCommandLine::Make({append_depfile});
+
   if (source_file->IsCppSourceFile) {
     auto build_stmt = core::builder::CustomCommandLine::Make(
-        {"@$(CXX)", "$(CPP_DEFINES)", "$(CPP_INCLUDES)", "$(CPPFLAGS)",
-         "$(CXXFLAGS)", fmt::format("$({}_CXXFLAGS)", build_type),
+        {"@$(CACHE_EXEC)", "$(CXX)", "$(CPP_DEFINES)", "$(CPP_INCLUDES)",
+         "$(CPPFLAGS)", "$(CXXFLAGS)", fmt::format("$({}_CXXFLAGS)", build_type),
          "$(INHERENT_FLAGS)", "-o", object_file.Stringify(), "-c",
          source_filename});
 
     makefile->Target(object_file.Stringify(), dep,
                      core::builder::CustomCommandLines::Multiple(
-                         print_stmt, mkdir_stmt, build_stmt));
+                         print_stmt, mkdir_stmt, build_stmt, deps_log_stmt));
   } else if (source_file->IsCSourceFile) {
     auto build_stmt = core::builder::CustomCommandLine::Make(
-        {"@$(CC)", "$(CPP_DEFINES)", "$(CPP_INCLUDES)", "$(CPPFLAGS)",
-         "$(CFLAGS)", fmt::format("$({}_CFLAGS)", build_type),
+        {"@$(CACHE_EXEC)", "$(CC)", "$(CPP_DEFINES)", "$(CPP_INCLUDES)",
+         "$(CPPFLAGS)", "$(CFLAGS)", fmt::format("$({}_CFLAGS)", build_type),
          "$(INHERENT_FLAGS)", "-o", object_file.Stringify(), "-c",
          source_filename});
 
     makefile->Target(object_file.Stringify(), dep,
                      core::builder::CustomCommandLines::Multiple(
-                         print_stmt, mkdir_stmt, build_stmt));
+                         print_stmt, mkdir_stmt, build_stmt, deps_log_stmt));
   } else {
     logger->info("unknown file extension: {}", full_qualified_path);
   }
 }
 
-std::vector<std::string> CCLibraryCompiler::lint_headers(
-    core::models::Session *session, const common::AbsolutePath &working_folder,
-    rules::CCLibrary *rule, core::generators::Makefile *makefile) const {
-  std::vector<std::string> lint_header_targets;
-  for (const auto &filename : rule->ExpandedHeaderFiles) {
+std::vector<std::string> CCLibraryCompiler::lint_source_files(
+    core::models::Session *session, rules::CCLibrary *rule) const {
+  std::vector<std::string> res;
+  for (const auto &filename : ranges::views::concat(
+           rule->ExpandedHeaderFiles, rule->ExpandedSourceFiles)) {
     auto source_file = models::cc::SourceFile(filename, rule);
+    auto full_qualified_path =
+        session->Project->Resolve(source_file.FullQualifiedPath).Stringify();
 
-    if (rule->InNolint(session->Project->Resolve(source_file.FullQualifiedPath)
-                           .Stringify())) {
+    if (rule->InNolint(full_qualified_path)) {
       continue;
     }
+    res.push_back(std::move(full_qualified_path));
+  }
+  return res;
+}
 
-    add_source_files_lint_commands(session, working_folder, rule, makefile,
-                                   &source_file);
-    lint_header_targets.push_back(
-        source_file.ResolveFullQualifiedLintPath(working_folder).Stringify());
+std::vector<std::string> CCLibraryCompiler::lint_files(
+    core::models::Session *session, const common::AbsolutePath &working_folder,
+    rules::CCLibrary *rule, core::generators::Makefile *makefile) const {
+  auto files = lint_source_files(session, rule);
+  if (files.empty()) {
+    return {};
   }
-  return lint_header_targets;
+
+  auto files_var = makefile->ListVariable("LINT_FILES", files);
+
+  // All files are linted in a few cpplint processes by `jk lint_files`. Only
+  // files newer than the stamp are passed, and unchanged contents are skipped
+  // by its cache. Everything is passed if toolchain or nolint.txt changed.
+  // Only the library or binary depends on the stamp, objects don't, so
+  // editing one file never rebuilds other objects of the rule.
+  auto stamp = working_folder.Sub("lint.stamp").Stringify();
+  auto nolint_txt =
+      session->Project->Resolve(rule->Package->Path.Path, "nolint.txt")
+          .Stringify();
+  core::builder::CustomArgument changed_files(fmt::format(
+      "$(if $(filter %.make {0},$?),{1},$(filter-out %.make {0},$?))",
+      nolint_txt, files_var));
+  changed_files.Raw = true;
+
+  makefile->Target(
+      stamp,
+      ranges::views::concat(
+          ranges::views::single(files_var),
+          ranges::views::single(SharedToolchainFile(session).Stringify()),
+          ranges::views::single(fmt::format("$(wildcard {})", nolint_txt))),
+      core::builder::CustomCommandLines::Multiple(
+          PrintStatement(session->Project.get(), "green", false,
+                         rule->Steps.Step(stamp), "Linting files of {}",
+                         rule->Base->FullQualifiedName),
+          core::builder::CustomCommandLine::Make({"@$(LINT)", changed_files}),
+          core::builder::CustomCommandLine::Make({"@touch", stamp})),
+      "Stamp of all linted files of this target.");
+  return {stamp};
 }
 
 std::vector<std::string> CCLibraryCompiler::add_source_files_commands(
     core::models::Session *session, const common::AbsolutePath &working_folder,
     rules::CCLibrary *rule, core::generators::Makefile *makefile,
-    std::vector<std::string> *lint_header_targets,
     std::vector<std::unique_ptr<models::cc::SourceFile>> &source_files,
-    std::string_view build_type, bool never_lint) const {
+    std::string_view build_type) const {
   std::vector<std::string> all_objects;
   all_objects.reserve(rule->ExpandedSourceFiles.size());
 
-  for (auto &source_file : source_files) {
-    if (!source_file->lint && !never_lint) {
-      source_file->lint = true;
-      if (!rule->InNolint(
-              session->Project->Resolve(source_file->FullQualifiedPath)
-                  .Stringify())) {
-        add_source_files_lint_commands(session, working_folder, rule, makefile,
-                                       source_file.get());
-      }
-    }
+  // also has dependencies of unity sources
+  auto deps_log = deps_log_file(working_folder, build_type);
+  makefile->Include(deps_log.Stringify(), "Header dependencies of objects.");
+  // make remakes an included file and restarts before building anything, so
+  // depfiles appended last build are merged once, not once per object
+  makefile->Target(
+      deps_log.Stringify(),
+      ranges::views::single(fmt::format(
+          "$(wildcard {})", common::DepsJournalFile(deps_log.Path).string())),
+      core::builder::CustomCommandLines::Single(
+          {"@$(JK_COMMAND)", "deps_log", "--compact",
+           fmt::format("--log={}", deps_log.Stringify())}));
 
-    add_source_file_commands(
-        session, working_folder, rule, makefile, build_type, source_file.get(),
-        ranges::views::all(*lint_header_targets), never_lint);
+  for (auto &source_file : source_files) {
+    add_source_file_commands(session, working_folder, rule, makefile,
+                             build_type, source_file.get(),
+                             ranges::views::empty<std::string>);
 
     if (rule->ExpandedAlwaysCompileFiles.contains(
             session->Project->Resolve(source_file->FullQualifiedPath)
@@ -409,6 +328,108 @@ std::vector<std::string> CCLibraryCompiler::add_source_files_commands(
   return all_objects;
 }
 
+auto CCLibraryCompiler::make_unity_batches(
+    core::models::Session *session, const common::AbsolutePath &working_folder,
+    rules::CCLibrary *rule,
+    std::vector<std::unique_ptr<models::cc::SourceFile>> *source_files) const
+    -> std::vector<UnityBatch> {
+  uint32_t batch_size = rule->UnityBatch;
+  if (batch_size == 0 && session->UnityBuild) {
+    batch_size = session->DefaultUnityBatch;
+  }
+  if (batch_size <= 1) {
+    return {};
+  }
+
+  std::vector<UnityBatch> batches;
+  std::vector<std::unique_ptr<models::cc::SourceFile>> rest;
+  std::vector<std::unique_ptr<models::cc::SourceFile>> pending;
+
+  auto flush = [&]() {
+    // a batch with only one source gains nothing, compile it as usual
+    if (pending.size() <= 1) {
+      std::move(std::begin(pending), std::end(pending),
+                std::back_inserter(rest));
+      pending.clear();
+      return;
+    }
+
+    auto unity_file = working_folder.Sub(
+        "unity", fmt::format("unity_{}.cc", batches.size()));
+    {
+      auto w = session->WriterFactory->Create();
+      w->open(unity_file);
+      w->write_line("// Generated by jk, DO NOT EDIT!");
+      for (const auto &sf : pending) {
+        w->write_line(fmt::format(
+            "#include \"{}\"",
+            session->Project->Resolve(sf->FullQualifiedPath).Stringify()));
+      }
+    }
+
+    UnityBatch batch;
+    batch.Source = std::make_unique<models::cc::SourceFile>(
+        common::ProjectRelativePath(fs::relative(
+            unity_file.Path, session->Project->ProjectRoot.Path)),
+        rule);
+    // the unity source is already in the working folder, its object is not
+    // nested under the source path like objects of other sources
+    batch.Source->FullQualifiedObjectPath = common::ProjectRelativePath(
+        fs::path("unity") / fmt::format("unity_{}.cc.o", batches.size()));
+    batch.Members = std::move(pending);
+    pending.clear();
+    batches.push_back(std::move(batch));
+  };
+
+  // ExpandedSourceFiles is sorted, so batches are stable between generations
+  for (auto &sf : *source_files) {
+    auto filename =
+        session->Project->Resolve(sf->FullQualifiedPath).Stringify();
+    if (!sf->IsCppSourceFile ||
+        rule->ExpandedAlwaysCompileFiles.contains(filename) ||
+        rule->ExpandedUnityExcludeFiles.contains(filename)) {
+      rest.push_back(std::move(sf));
+      continue;
+    }
+
+    pending.push_back(std::move(sf));
+    if (pending.size() == batch_size) {
+      flush();
+    }
+  }
+  flush();
+
+  *source_files = std::move(rest);
+  return batches;
+}
+
+std::vector<std::string> CCLibraryCompiler::add_unity_batches_commands(
+    core::models::Session *session, const common::AbsolutePath &working_folder,
+    rules::CCLibrary *rule, core::generators::Makefile *makefile,
+    std::vector<UnityBatch> &batches, std::string_view build_type) const {
+  std::vector<std::string> all_objects;
+  all_objects.reserve(batches.size());
+
+  for (auto &batch : batches) {
+    // members are linted as sources of the rule, the unity source is not
+    std::vector<std::string> member_deps;
+    for (auto &member : batch.Members) {
+      member_deps.push_back(
+          session->Project->Resolve(member->FullQualifiedPath).Stringify());
+    }
+
+    add_source_file_commands(session, working_folder, rule, makefile,
+                             build_type, batch.Source.get(),
+                             ranges::views::all(member_deps));
+
+    all_objects.push_back(
+        batch.Source->ResolveFullQualifiedObjectPath(working_folder, build_type)
+            .Stringify());
+  }
+
+  return all_objects;
+}
+
 void CCLibraryCompiler::generate_build_file(
     core::models::Session *session, const common::AbsolutePath &working_folder,
     const std::vector<core::algorithms::StronglyConnectedComponent> &scc,
@@ -421,12 +442,11 @@ void CCLibraryCompiler::generate_build_file(
   makefile.Comment("ACF: ",
                    absl::StrJoin(rule->ExpandedAlwaysCompileFiles, ", "));
 
-  // lint headers
-  std::vector<std::string> lint_header_targets =
-      lint_headers(session, working_folder, rule, &makefile);
+  std::vector<std::string> lint_targets =
+      lint_files(session, working_folder, rule, &makefile);
 
   generate_build_file_impl(session, working_folder, rule, &makefile,
-                           &lint_header_targets, rule->ExpandedSourceFiles);
+                           &lint_targets, rule->ExpandedSourceFiles);
 
   end_of_generate_build_file(&makefile, session, working_folder, rule);
 }
@@ -434,10 +454,10 @@ void CCLibraryCompiler::generate_build_file(
 void CCLibraryCompiler::generate_build_file_impl(
     core::models::Session *session, const common::AbsolutePath &working_folder,
     rules::CCLibrary *rule, core::generators::Makefile *makefile,
-    std::vector<std::string> *lint_header_targets,
-    const std::vector<std::string> &source_files_raw, bool never_lint) const {
+    std::vector<std::string> *lint_targets,
+    const std::vector<std::string> &source_files_raw) const {
   auto library_progress_num = rule->Steps.Step(".library");
-  core::builder::CustomCommandLines clean_statements;
+  std::vector<std::string> clean_files;
 
   auto source_files =
       source_files_raw | ranges::views::transform([rule](const auto &filename) {
@@ -445,16 +465,18 @@ void CCLibraryCompiler::generate_build_file_impl(
       }) |
       ranges::to_vector;
 
-  if (never_lint) {
-    for (auto &sf : source_files) {
-      sf->lint = true;
-    }
-  }
+  auto unity_batches =
+      make_unity_batches(session, working_folder, rule, &source_files);
 
   for (const auto &build_type : session->BuildTypes) {
     auto all_objects = add_source_files_commands(
-        session, working_folder, rule, makefile, lint_header_targets,
-        source_files, build_type, never_lint);
+        session, working_folder, rule, makefile, source_files, build_type);
+    ranges::copy(add_unity_batches_commands(session, working_folder, rule,
+                                            makefile, unity_batches,
+                                            build_type),
+                 std::back_inserter(all_objects));
+    auto objects = makefile->ListVariable(fmt::format("{}_OBJECTS", build_type),
+                                          all_objects);
 
     auto library_file_file =
         working_folder.Sub(build_type, rule->LibraryFileName);
@@ -462,13 +484,7 @@ void CCLibraryCompiler::generate_build_file_impl(
     makefile->Target(library_file, ranges::views::empty<std::string>,
                      ranges::views::empty<core::builder::CustomCommandLine>);
 
-    auto clean_old_library = core::builder::CustomCommandLine::Make(
-        {"-@$(RM)", "--silent", library_file});
-
-    auto ar_stmt =
-        core::builder::CustomCommandLine::Make({"@$(AR)", library_file});
-    std::copy(std::begin(all_objects), std::end(all_objects),
-              std::back_inserter(ar_stmt));
+    auto archive_stmts = ArchiveStatements(session, library_file, objects);
 
     auto print_stmt = core::builder::CustomCommandLine::Make(
         {"@$(PRINT)", "--switch=$(COLOR)", "--green", "--bold",
@@ -481,31 +497,21 @@ void CCLibraryCompiler::generate_build_file_impl(
     makefile->Target(
         library_file,
         ranges::views::concat(
-            ranges::views::all(all_objects),
-            ranges::views::all(*lint_header_targets),
+            ranges::views::single(objects),
+            ranges::views::all(*lint_targets),
             ranges::views::single(working_folder.Sub("build.make").Stringify()),
-            ranges::views::single(
-                working_folder.Sub("toolchain.make").Stringify()),
+            ranges::views::single(SharedToolchainFile(session).Stringify()),
+            ranges::views::single(SharedFlagsFile(session).Stringify()),
             ranges::views::single(
                 working_folder.Sub("flags.make").Stringify())),
         ranges::views::concat(
             ranges::views::single(print_stmt),
             ranges::views::single(core::builder::CustomCommandLine::Make(
                 {"@$(MKDIR)", library_file_file.Path.parent_path().string()})),
-            ranges::views::single(clean_old_library),
-            ranges::views::single(ar_stmt)));
+            ranges::views::all(archive_stmts)));
 
-    auto gen_rm = [](const auto &str) {
-      return core::builder::CustomCommandLine::Make({"@$(RM)", str});
-    };
-
-    clean_statements.push_back(
-        core::builder::CustomCommandLine::Make({"@$(RM)", library_file}));
-    std::transform(std::begin(all_objects), std::end(all_objects),
-                   std::back_inserter(clean_statements), gen_rm);
-    std::transform(std::begin(*lint_header_targets),
-                   std::end(*lint_header_targets),
-                   std::back_inserter(clean_statements), gen_rm);
+    clean_files.push_back(library_file);
+    ranges::copy(all_objects, std::back_inserter(clean_files));
 
     auto build_target = working_folder.Sub(build_type, "build").Stringify();
     makefile->Target(build_target, ranges::views::single(library_file),
@@ -517,8 +523,12 @@ void CCLibraryCompiler::generate_build_file_impl(
                      "Rule to build all files generated by this target.", true);
   }
 
+  ranges::copy(*lint_targets, std::back_inserter(clean_files));
+
   makefile->Target("clean", ranges::views::empty<std::string>,
-                   ranges::views::all(clean_statements), "", true);
+                   ranges::views::single(
+                       CleanStatement(session, working_folder, clean_files)),
+                   "", true);
 }
 
 }  // namespace jk::impls::compilers::makefile
@@ -3,7 +3,9 @@
 
 #pragma once  // NOLINT(build/header_guard)
 
+#include <memory>
 #include <string_view>
+#include <vector>
 
 #include "jk/core/generators/makefile.hh"
 #include "jk/core/interfaces/compiler.hh"
@@ -27,10 +29,6 @@ struct CCLibraryCompiler : public core::interfaces::Compiler {
                                   const common::AbsolutePath &working_folder,
                                   rules::CCLibrary *rule) const;
 
-  virtual void generate_toolchain_file(
-      core::models::Session *session,
-      const common::AbsolutePath &working_folder, rules::CCLibrary *rule) const;
-
   virtual void generate_build_file(
       core::models::Session *session,
       const common::AbsolutePath &working_folder,
@@ -47,26 +45,51 @@ struct CCLibraryCompiler : public core::interfaces::Compiler {
     (void)rule;
   }
 
-  std::vector<std::string> lint_headers(
+  //! Returns headers and sources to lint, which are not in nolint.txt.
+  std::vector<std::string> lint_source_files(core::models::Session *session,
+                                             rules::CCLibrary *rule) const;
+
+  //! Adds one batched lint command of all headers and sources. Returns the
+  //! stamp target of it, or empty if no file needs lint.
+  std::vector<std::string> lint_files(
       core::models::Session *session,
       const common::AbsolutePath &working_folder, rules::CCLibrary *rule,
       core::generators::Makefile *makefile) const;
 
+  //! Sources merged into one generated unity source.
+  struct UnityBatch {
+    std::unique_ptr<models::cc::SourceFile> Source;
+    std::vector<std::unique_ptr<models::cc::SourceFile>> Members;
+  };
+
+  //! Moves c++ sources which could be merged out of `source_files`, and
+  //! writes the unity sources of them. Objects of unity sources are
+  //! `unity/unity_<n>.cc.o` in the folder of each build type. Returns empty if
+  //! unity build is not enabled for this rule.
+  std::vector<UnityBatch> make_unity_batches(
+      core::models::Session *session,
+      const common::AbsolutePath &working_folder, rules::CCLibrary *rule,
+      std::vector<std::unique_ptr<models::cc::SourceFile>> *source_files) const;
+
+  std::vector<std::string> add_unity_batches_commands(
+      core::models::Session *session,
+      const common::AbsolutePath &working_folder, rules::CCLibrary *rule,
+      core::generators::Makefile *makefile,
+      std::vector<UnityBatch> &batches, std::string_view build_type) const;
+
   std::vector<std::string> add_source_files_commands(
       core::models::Session *session,
       const common::AbsolutePath &working_folder, rules::CCLibrary *rule,
       core::generators::Makefile *makefile,
-      std::vector<std::string> *lint_header_targets,
       std::vector<std::unique_ptr<models::cc::SourceFile>> &source_files,
-      std::string_view build_type, bool never_lint) const;
+      std::string_view build_type) const;
 
   void generate_build_file_impl(
       core::models::Session *session,
       const common::AbsolutePath &working_folder, rules::CCLibrary *rule,
       core::generators::Makefile *makefile,
-      std::vector<std::string> *lint_header_targets,
-      const std::vector<std::string> &source_files_raw,
-      bool never_lint = false) const;
+      std::vector<std::string> *lint_targets,
+      const std::vector<std::string> &source_files_raw) const;
 
   void DoCompile(
       core::models::Session *session,
@@ -3,8 +3,17 @@
 
 #include "jk/impls/compilers/makefile/common.hh"
 
+#include <string>
+#include <vector>
+
+#include "absl/strings/str_join.h"
+#include "fmt/format.h"
+#include "jk/common/version_stamp.hh"
+#include "jk/core/filesystem/project.hh"
 #include "jk/core/generators/makefile.hh"
 #include "jk/core/models/session.hh"
+#include "range/v3/view/all.hpp"
+#include "range/v3/view/concat.hpp"
 #include "range/v3/view/single.hpp"
 
 namespace jk::impls::compilers::makefile {
@@ -47,14 +56,18 @@ core::generators::Makefile new_makefile_with_common_commands(
                   ranges::views::empty<core::builder::CustomCommandLine>);
 
   if (!no_include) {
+    makefile.Include(SharedToolchainFile(session).Path.string(),
+                     "Include toolchains shared by all rules.", true);
+    makefile.Include(SharedFlagsFile(session).Path.string(),
+                     "Include compile flags shared by all rules.", true);
     makefile.Include(working_folder.Sub("flags.make").Path.string(),
                      "Include the compile flags for this rule's objectes.",
                      true);
-    makefile.Include(working_folder.Sub("toolchain.make").Path.string(),
-                     "Include used toolchains for this rule's objects.", true);
+
+    makefile.PrefixVariable("WORKING_FOLDER", working_folder.Stringify());
   }
 
-  makefile.Target("all", ranges::views::single("DEBUG"),
+  makefile.Target("all", ranges::views::single(session->BuildTypes.front()),
                   ranges::views::empty<core::builder::CustomCommandLine>, "",
                   true);
   makefile.Target(core::generators::Makefile::DEFAULT_TARGET,
@@ -68,4 +81,233 @@ core::generators::Makefile new_makefile_with_common_commands(
   return makefile;
 }
 
+std::string ArchiveCommand(core::models::Session *session) {
+  const auto &mode = session->Project->Config().archive_mode;
+  if (mode == "thin") {
+    return "ar rcsT";
+  }
+  if (mode == "incremental") {
+    // members are matched by basename without 'P', objects with same name
+    // in different folders would replace each other
+    return "ar rcsP";
+  }
+  return "ar rcs";
+}
+
+core::builder::CustomCommandLines ArchiveStatements(
+    core::models::Session *session, const std::string &library_file,
+    const std::string &objects) {
+  if (session->Project->Config().archive_mode != "incremental") {
+    // thin archives are cheap to recreate, and recreating drops members of
+    // removed objects
+    return core::builder::CustomCommandLines::Multiple(
+        core::builder::CustomCommandLine::Make(
+            {"-@$(RM)", "--silent", library_file}),
+        core::builder::CustomCommandLine::Make(
+            {"@$(AR)", library_file, objects}));
+  }
+
+  // Only changed objects are replaced. If any makefile changed, objects of
+  // this library may have been removed, so it's recreated. `$?` contains
+  // all prerequisites if the library doesn't exist.
+  static constexpr std::string_view makefile_changed = "$(filter %.make,$?)";
+  core::builder::CustomArgument remove_file(
+      fmt::format("$(if {},{})", makefile_changed, library_file));
+  remove_file.Raw = true;
+  core::builder::CustomArgument members(fmt::format(
+      "$(if {},{},$(filter %.o,$?))", makefile_changed, objects));
+  members.Raw = true;
+
+  return core::builder::CustomCommandLines::Multiple(
+      core::builder::CustomCommandLine::Make(
+          {"-@$(RM)", "--silent", remove_file}),
+      core::builder::CustomCommandLine::Make(
+          {"@$(AR)", library_file, members}));
+}
+
+core::builder::CustomCommandLine CleanStatement(
+    core::models::Session *session, const common::AbsolutePath &working_folder,
+    const std::vector<std::string> &files) {
+  auto manifest = working_folder.Sub("clean.manifest");
+  {
+    auto w = session->WriterFactory->Create();
+    w->open(manifest);
+    for (const auto &file : files) {
+      w->write_line(file);
+    }
+  }
+
+  return core::builder::CustomCommandLine::Make(
+      {"@$(RM)", fmt::format("--manifest={}", manifest.Stringify())});
+}
+
+static std::string linker_flags(
+    const core::filesystem::Configuration &config) {
+  std::vector<std::string> res;
+  if (!config.linker.empty()) {
+    res.push_back(fmt::format("-fuse-ld={}", config.linker));
+  }
+  if (config.linker_threads > 0) {
+    if (config.linker == "lld") {
+      res.push_back(fmt::format("-Wl,--threads={}", config.linker_threads));
+    } else if (config.linker == "mold") {
+      res.push_back(
+          fmt::format("-Wl,--thread-count={}", config.linker_threads));
+    } else if (config.linker == "gold") {
+      res.push_back("-Wl,--threads");
+      res.push_back(
+          fmt::format("-Wl,--thread-count={}", config.linker_threads));
+    }
+  }
+  return absl::StrJoin(res, " ");
+}
+
+static void generate_shared_toolchain_file(core::models::Session *session) {
+  core::generators::Makefile makefile(SharedToolchainFile(session),
+                                      {session->WriterFactory.get()});
+
+  makefile.Env(
+      "CXX",
+      fmt::format(
+          "{} {}", absl::StrJoin(session->Project->Config().cxx, " "),
+          session->Project->Platform == core::filesystem::TargetPlatform::k64
+              ? "-m64"
+              : "-m32"));
+
+  makefile.Env(
+      "CC",
+      fmt::format(
+          "{} {}", absl::StrJoin(session->Project->Config().cc, " "),
+          session->Project->Platform == core::filesystem::TargetPlatform::k64
+              ? "-m64"
+              : "-m32"));
+
+  makefile.Env("LINKER", "g++");
+
+  makefile.Env("LINKER_FLAGS", linker_flags(session->Project->Config()),
+               "Selects the linker and its threads.");
+
+  if (const auto &config = session->Project->Config(); config.link_jobs >= 0) {
+    auto pool_dir = session->Project->BuildRoot.Sub(".pool", "link");
+    makefile.Env("LINK_POOL",
+                 fmt::format("$(JK_COMMAND) pool_exec --pool-dir={} "
+                             "--slots={} --memory-per-slot={} --",
+                             pool_dir.Stringify(), config.link_jobs,
+                             config.link_job_memory),
+                 "Limits concurrent link steps.");
+  } else {
+    makefile.Env("LINK_POOL", "");
+  }
+
+  makefile.Env("AR", ArchiveCommand(session));
+
+  makefile.Env("RM", "$(JK_COMMAND) delete_file",
+               "The command to remove a file.");
+
+  makefile.Env("CPPLINT", session->Project->Config().cpplint_path);
+  makefile.Env(
+      "LINT",
+      fmt::format("$(JK_COMMAND) lint_files --cpplint=$(CPPLINT) "
+                  "--cache-dir={} --log-dir={} --",
+                  session->Project->BuildRoot.Sub(".lint_cache").Stringify(),
+                  session->Project->BuildRoot.Sub(".lint_logs").Stringify()),
+      "Lints files in batches, skips files linted before.");
+
+  if (const auto &config = session->Project->Config(); config.compile_cache) {
+    auto cache_dir = config.compile_cache_dir.empty()
+                         ? session->Project->BuildRoot.Sub(".compile_cache")
+                               .Stringify()
+                         : config.compile_cache_dir;
+    makefile.Env("CACHE_EXEC",
+                 fmt::format("$(JK_COMMAND) cache_exec --cache-dir={} "
+                             "--max-size={} --",
+                             cache_dir, config.compile_cache_max_size),
+                 "The wrapper of compile commands.");
+  } else {
+    makefile.Env("CACHE_EXEC", "");
+  }
+
+  makefile.Env("MKDIR", "mkdir -p");
+}
+
+static void generate_shared_flags_file(core::models::Session *session) {
+  core::generators::Makefile makefile(SharedFlagsFile(session),
+                                      {session->WriterFactory.get()});
+
+  const auto &config = session->Project->Config();
+
+  auto cppincludes = ranges::views::concat(
+      ranges::views::single("-isystem"),
+      ranges::views::single(fmt::format(
+          ".build/.lib/m{}/include",
+          session->Project->Platform == core::filesystem::TargetPlatform::k64
+              ? "64"
+              : "32")),
+      ranges::views::single("-I.build/include"));
+
+  static auto cxxincludes = ranges::views::single("-I.build/pb/c++");
+
+  // `GIT_DESC` is defined in the git desc fragment of each repository,
+  // included by flags file of each rule, expanded when used
+  static auto git_desc = ranges::views::single("$(GIT_DESC)");
+
+  // all configured build types, not only generated ones, or generating
+  // another type changes this file, which rebuilds objects of all types
+  for (const auto &type_config : config.build_types) {
+    const auto &build_type = type_config.name;
+
+    makefile.Env(build_type + "_CFLAGS",
+                 absl::StrJoin(ranges::views::concat(
+                                   config.compile_flags, git_desc,
+                                   config.cflags, type_config.cflags_extra,
+                                   cppincludes),
+                               " "));
+    makefile.Env(build_type + "_CXXFLAGS",
+                 absl::StrJoin(ranges::views::concat(
+                                   config.compile_flags, git_desc,
+                                   config.cxxflags, type_config.cxxflags_extra,
+                                   cppincludes, cxxincludes),
+                               " "));
+    makefile.Env(build_type + "_LDFLAGS",
+                 absl::StrJoin(ranges::views::concat(
+                                   type_config.ld_flags_before,
+                                   config.ld_flags, type_config.ld_flags_extra),
+                               " "));
+  }
+}
+
+common::AbsolutePath GitRepository(core::models::Session *session,
+                                   const common::AbsolutePath &dir) {
+  auto repository = common::FindGitRepository(dir.Path);
+  if (repository.empty()) {
+    return session->Project->ProjectRoot;
+  }
+  return common::AbsolutePath{repository};
+}
+
+common::AbsolutePath GitDescFile(core::models::Session *session,
+                                 const common::AbsolutePath &repository) {
+  auto relative = repository.Path.lexically_normal().lexically_relative(
+      session->Project->ProjectRoot.Path.lexically_normal());
+  // repositories outside of the project share the fragment of the root
+  if (relative.empty() || relative == "." || *relative.begin() == "..") {
+    return session->Project->BuildRoot.Sub("git_desc.make");
+  }
+  return session->Project->BuildRoot.Sub("git_desc", relative.string(),
+                                         "git_desc.make");
+}
+
+common::AbsolutePath SharedFlagsFile(core::models::Session *session) {
+  return session->Project->BuildRoot.Sub("flags.make");
+}
+
+common::AbsolutePath SharedToolchainFile(core::models::Session *session) {
+  return session->Project->BuildRoot.Sub("toolchain.make");
+}
+
+void GenerateSharedFiles(core::models::Session *session) {
+  generate_shared_flags_file(session);
+  generate_shared_toolchain_file(session);
+}
+
 }  // namespace jk::impls::compilers::makefile
@@ -3,7 +3,9 @@
 
 #pragma once  // NOLINT(build/header_guard)
 
+#include <string>
 #include <string_view>
+#include <vector>
 
 #include "absl/strings/str_join.h"
 #include "jk/core/generators/makefile.hh"
@@ -20,6 +22,42 @@ core::generators::Makefile new_makefile_with_common_commands(
     std::string_view filename = "build.make",
     bool no_include = false);
 
+//! Commands to archive `objects` into static library `library_file`, depends
+//! on `archive_mode` in configuration. The toolchain's `AR` must match it.
+core::builder::CustomCommandLines ArchiveStatements(
+    core::models::Session *session, const std::string &library_file,
+    const std::string &objects);
+
+//! `AR` of toolchain for `archive_mode` in configuration.
+std::string ArchiveCommand(core::models::Session *session);
+
+//! Top folder of the git repository `dir` is in, or the project root if it's
+//! not in any repository.
+common::AbsolutePath GitRepository(core::models::Session *session,
+                                   const common::AbsolutePath &dir);
+
+//! Make fragment defining `GIT_DESC` of `repository`. It's written by `pre`
+//! of the root Makefile once per build, and included by flags files of rules
+//! in the repository. Nested repositories and submodules have their own.
+common::AbsolutePath GitDescFile(core::models::Session *session,
+                                 const common::AbsolutePath &repository);
+
+//! Project-wide flags of build types, shared by all rules.
+common::AbsolutePath SharedFlagsFile(core::models::Session *session);
+
+//! Toolchain shared by all rules.
+common::AbsolutePath SharedToolchainFile(core::models::Session *session);
+
+//! Writes shared flags and toolchain files in build root. Makefiles of rules
+//! include them, and only keep their own flags.
+void GenerateSharedFiles(core::models::Session *session);
+
+//! Writes `files` into `clean.manifest` of `working_folder`. Returns the
+//! command removing all of them in one process.
+core::builder::CustomCommandLine CleanStatement(
+    core::models::Session *session, const common::AbsolutePath &working_folder,
+    const std::vector<std::string> &files);
+
 inline auto PrintStatement(core::filesystem::JKProject *project,
                            std::string_view color, bool bold, auto &&numbers,
                            auto &&fmt_str, auto &&...args) {
@@ -3,15 +3,20 @@
 
 #include "jk/impls/compilers/makefile/proto_library_compiler.hh"
 
+#include <iterator>
 #include <string>
 #include <string_view>
+#include <vector>
 
 #include "absl/strings/str_replace.h"
+#include "jk/common/proto_imports.hh"
 #include "jk/core/generators/makefile.hh"
 #include "jk/core/models/build_package.hh"
 #include "jk/core/models/session.hh"
 #include "jk/impls/compilers/makefile/common.hh"
 #include "jk/impls/rules/proto_library.hh"
+#include "range/v3/algorithm/copy.hpp"
+#include "range/v3/view/all.hpp"
 #include "range/v3/view/concat.hpp"
 #include "range/v3/view/single.hpp"
 
@@ -26,41 +31,93 @@ struct GeneratedPair {
   common::AbsolutePath Source;
 };
 
-GeneratedPair add_proto_file_commands(
+//! Generated files of proto file `filename`.
+static GeneratedPair generated_files(const common::AbsolutePath &working_folder,
+                                     std::string_view filename) {
+  fs::path p = filename;
+  p          = p.replace_extension("pb");
+
+  return {working_folder.Sub(fmt::format("{}.h", p.string())),
+          working_folder.Sub(fmt::format("{}.cc", p.string()))};
+}
+
+//! Adds one protoc invocation for all proto files of the rule, as a grouped
+//! target of all generated files. Make runs protoc once for the rule, and
+//! again if any generated file is missing. Make before 4.3 uses a stamp.
+static void add_proto_files_commands(
     core::models::Session *session, const common::AbsolutePath &working_folder,
     core::generators::Makefile *makefile, rules::ProtoLibrary *rule,
-    std::string_view filename) {
-  auto num = rule->Steps.Step(std::string{filename});
+    const std::vector<std::string> &filenames,
+    const std::vector<GeneratedPair> &generated) {
+  // srcs may expand to nothing
+  if (filenames.empty()) {
+    return;
+  }
 
-  auto print_stmt =
-      PrintStatement(session->Project.get(), "green", false, num,
-                     "Compiling proto file {} into .cc/.h", filename);
+  auto num = rule->Steps.Step(".protoc");
+
+  auto print_stmt = PrintStatement(
+      session->Project.get(), "green", false, num,
+      "Compiling {} proto files of {} into .cc/.h", filenames.size(),
+      rule->Base->FullQualifiedName);
   auto mkdir = core::builder::CustomCommandLine::Make(
       {"@$(MKDIR)", working_folder.Stringify()});
   auto protoc = core::builder::CustomCommandLine::Make(
       {"${THIRD_PARTY_PROTOBUF_PROTOC}",
        fmt::format("--python_out={}", working_folder.Stringify()),
        fmt::format("--cpp_out={}", working_folder.Stringify()),
-       fmt::format("-I{}", session->Project->ProjectRoot.Stringify()),
-       std::string(filename)});
-
-  std::map<const absl::string_view, const absl::string_view> replacements{
-      {"proto", "pb"}};
-
-  fs::path p = filename;
-  p          = p.replace_extension("pb");
-
-  auto gen_cc_file = working_folder.Sub(fmt::format("{}.cc", p.string()));
-  auto gen_h_file  = working_folder.Sub(fmt::format("{}.h", p.string()));
+       fmt::format("-I{}", session->Project->ProjectRoot.Stringify())});
+  for (const auto &filename : filenames) {
+    protoc.push_back(filename);
+  }
 
+  // imported protos from anywhere in the project, protoc reads them too;
+  // the fragment is refreshed when any proto file of the rule changes, so a
+  // new import only reaches this rule
+  auto imports_file = working_folder.Sub("imports.make");
+  {
+    std::vector<fs::path> protos;
+    for (const auto &filename : filenames) {
+      protos.push_back(session->Project->ProjectRoot.Sub(filename).Path);
+    }
+    auto w = session->WriterFactory->Create();
+    w->open(imports_file);
+    w->write(common::ProtoImportsFragment(
+        session->ProtoImports.TransitiveImports(
+            session->Project->ProjectRoot.Path, protos)));
+  }
+  auto scan = core::builder::CustomCommandLine::Make(
+      {"@$(JK_COMMAND)", "proto_imports",
+       fmt::format("--root={}", session->Project->ProjectRoot.Stringify()),
+       fmt::format("--output={}", imports_file.Stringify())});
+  for (const auto &filename : filenames) {
+    scan.push_back(filename);
+  }
+  makefile->Include(imports_file.Stringify(),
+                    "Imported protos of the proto files.");
   makefile->Target(
-      fmt::format("{} {}", gen_cc_file.Stringify(), gen_h_file.Stringify()),
-      ranges::views::single(filename),
+      imports_file.Stringify(),
+      ranges::views::concat(
+          ranges::views::all(filenames),
+          ranges::views::single(std::string{"$(wildcard $(PROTO_IMPORTS))"})),
+      ranges::views::single(scan));
+
+  std::vector<std::string> outputs;
+  for (const auto &[header, source] : generated) {
+    outputs.push_back(source.Stringify());
+    outputs.push_back(header.Stringify());
+  }
+
+  makefile->GroupedTarget(
+      outputs,
+      ranges::views::concat(
+          ranges::views::all(filenames),
+          ranges::views::single(std::string{"$(PROTO_IMPORTS)"}),
+          ranges::views::single(working_folder.Sub("build.make").Stringify())),
       ranges::views::concat(ranges::views::single(print_stmt),
                             ranges::views::single(mkdir),
-                            ranges::views::single(protoc)));
-
-  return {gen_h_file, gen_cc_file};
+                            ranges::views::single(protoc)),
+      working_folder.Sub("protoc.stamp").Stringify());
 }
 
 void ProtoLibraryCompiler::generate_build_file(
@@ -74,15 +131,20 @@ void ProtoLibraryCompiler::generate_build_file(
 
   makefile.Comment("Sources: ", absl::StrJoin(rule->ExpandedSourceFiles, ", "));
 
+  std::vector<std::string> proto_files;
+  std::vector<GeneratedPair> generated;
   std::vector<common::AbsolutePath> generated_sources, generated_headers;
   for (auto &filename : rule->ExpandedSourceFiles) {
-    auto [header, source] =
-        add_proto_file_commands(session, working_folder, &makefile, rule,
-                                rule->Package->Path.Sub(filename).Stringify());
+    auto proto_file = rule->Package->Path.Sub(filename).Stringify();
+    auto files      = generated_files(working_folder, proto_file);
 
-    generated_sources.push_back(std::move(source));
-    generated_headers.push_back(std::move(header));
+    generated_sources.push_back(files.Source);
+    generated_headers.push_back(files.Header);
+    generated.push_back(std::move(files));
+    proto_files.push_back(std::move(proto_file));
   }
+  add_proto_files_commands(session, working_folder, &makefile, rule,
+                           proto_files, generated);
   makefile.Comment("Gen-Headers: ",
                    absl::StrJoin(generated_headers, ", ",
                                  [](std::string *output, const auto &x) {
@@ -94,11 +156,9 @@ void ProtoLibraryCompiler::generate_build_file(
                                    output->append(x.Stringify());
                                  }));
 
-  std::vector<std::string> lint_header_targets;
-
   {
     auto library_progress_num = rule->Steps.Step(".library");
-    core::builder::CustomCommandLines clean_statements;
+    std::vector<std::string> clean_files;
 
     auto source_files =
         generated_sources |
@@ -112,8 +172,9 @@ void ProtoLibraryCompiler::generate_build_file(
 
     for (const auto &build_type : session->BuildTypes) {
       auto all_objects = add_source_files_commands(
-          session, working_folder, rule, &makefile, &lint_header_targets,
-          source_files, build_type, true);
+          session, working_folder, rule, &makefile, source_files, build_type);
+      auto objects = makefile.ListVariable(
+          fmt::format("{}_OBJECTS", build_type), all_objects);
 
       auto library_file_file =
           working_folder.Sub(build_type, rule->LibraryFileName);
@@ -121,13 +182,7 @@ void ProtoLibraryCompiler::generate_build_file(
       makefile.Target(library_file, ranges::views::empty<std::string>,
                       ranges::views::empty<core::builder::CustomCommandLine>);
 
-      auto clean_old_library = core::builder::CustomCommandLine::Make(
-          {"-@$(RM)", "--silent", library_file});
-
-      auto ar_stmt =
-          core::builder::CustomCommandLine::Make({"@$(AR)", library_file});
-      std::copy(std::begin(all_objects), std::end(all_objects),
-                std::back_inserter(ar_stmt));
+      auto archive_stmts = ArchiveStatements(session, library_file, objects);
 
       auto print_stmt = core::builder::CustomCommandLine::Make(
           {"@$(PRINT)", "--switch=$(COLOR)", "--green", "--bold",
@@ -140,11 +195,11 @@ void ProtoLibraryCompiler::generate_build_file(
       makefile.Target(
           library_file,
           ranges::views::concat(
-              ranges::views::all(all_objects),
+              ranges::views::single(objects),
               ranges::views::single(
                   working_folder.Sub("build.make").Stringify()),
-              ranges::views::single(
-                  working_folder.Sub("toolchain.make").Stringify()),
+              ranges::views::single(SharedToolchainFile(session).Stringify()),
+              ranges::views::single(SharedFlagsFile(session).Stringify()),
               ranges::views::single(
                   working_folder.Sub("flags.make").Stringify())),
           ranges::views::concat(
@@ -152,17 +207,10 @@ void ProtoLibraryCompiler::generate_build_file(
               ranges::views::single(core::builder::CustomCommandLine::Make(
                   {"@$(MKDIR)",
                    library_file_file.Path.parent_path().string()})),
-              ranges::views::single(clean_old_library),
-              ranges::views::single(ar_stmt)));
-
-      auto gen_rm = [](const auto &str) {
-        return core::builder::CustomCommandLine::Make({"@$(RM)", str});
-      };
+              ranges::views::all(archive_stmts)));
 
-      clean_statements.push_back(
-          core::builder::CustomCommandLine::Make({"@$(RM)", library_file}));
-      std::transform(std::begin(all_objects), std::end(all_objects),
-                     std::back_inserter(clean_statements), gen_rm);
+      clean_files.push_back(library_file);
+      ranges::copy(all_objects, std::back_inserter(clean_files));
 
       auto build_target = working_folder.Sub(build_type, "build").Stringify();
       makefile.Target(build_target, ranges::views::single(library_file),
@@ -177,7 +225,9 @@ void ProtoLibraryCompiler::generate_build_file(
     }
 
     makefile.Target("clean", ranges::views::empty<std::string>,
-                    ranges::views::all(clean_statements), "", true);
+                    ranges::views::single(CleanStatement(
+                        session, working_folder, clean_files)),
+                    "", true);
   }
 
   end_of_generate_build_file(&makefile, session, working_folder, rule);
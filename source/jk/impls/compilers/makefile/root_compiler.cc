@@ -3,6 +3,9 @@
 
 #include "jk/impls/compilers/makefile/root_compiler.hh"
 
+#include <map>
+#include <string>
+
 #include "absl/container/flat_hash_set.h"
 #include "absl/strings/ascii.h"
 #include "jk/cli/cli.hh"
@@ -11,6 +14,7 @@
 #include "jk/core/models/build_package.hh"
 #include "jk/core/models/session.hh"
 #include "jk/impls/compilers/makefile/common.hh"
+#include "range/v3/algorithm/contains.hpp"
 #include "range/v3/range/conversion.hpp"
 #include "range/v3/view/all.hpp"
 #include "range/v3/view/any_view.hpp"
@@ -32,19 +36,15 @@ auto RootCompiler::Name() const -> std::string_view {
   return "makefile.root";
 }
 
-auto merge_numbers(core::models::BuildRule *rule,
-                   absl::flat_hash_set<uint32_t> *visited)
-    -> ranges::any_view<uint32_t> {
-  if (visited->contains(rule->Base->ObjectId)) {
-    return ranges::views::empty<uint32_t>;
+auto merge_numbers(core::models::Session *session,
+                   core::models::BuildRule *rule) -> std::vector<uint32_t> {
+  std::vector<uint32_t> res;
+  for (auto id : session->Graph->Closure(rule->Base->ObjectId)) {
+    for (auto n : session->Graph->Rule(id)->Steps.Steps()) {
+      res.push_back(n);
+    }
   }
-  visited->insert(rule->Base->ObjectId);
-
-  return ranges::views::concat(
-      rule->Steps.Steps(),
-      rule->Dependencies | ranges::views::transform([visited](auto r) {
-        return merge_numbers(r, visited);
-      }) | ranges::views::join);
+  return res;
 }
 
 auto generate_targets(core::models::Session *session,
@@ -52,8 +52,7 @@ auto generate_targets(core::models::Session *session,
                       std::vector<std::string> *clean_targets,
                       std::vector<std::string> *test_targets,
                       core::models::BuildRule *rule) {
-  absl::flat_hash_set<uint32_t> visited;
-  auto numbers = merge_numbers(rule, &visited) | ranges::to_vector;
+  auto numbers = merge_numbers(session, rule);
 
   // add clean target
   if (rule->Base->Type.IsExternal()) {
@@ -150,10 +149,14 @@ auto RootCompiler::Compile(
     core::models::Session *session,
     const std::vector<core::algorithms::StronglyConnectedComponent> &scc,
     std::vector<core::models::BuildRule *> rules) const -> void {
+  GenerateSharedFiles(session);
+
   auto makefile = new_makefile_with_common_commands(
       session, session->Project->ProjectRoot, "Makefile", true);
 
-  makefile.Target("all", ranges::views::single("debug"),
+  makefile.Target("all",
+                  ranges::views::single(
+                      absl::AsciiStrToLower(session->BuildTypes.front())),
                   ranges::views::empty<core::builder::CustomCommandLine>);
 
   makefile.Target(core::generators::Makefile::DEFAULT_TARGET,
@@ -163,28 +166,6 @@ auto RootCompiler::Compile(
   auto regen_target =
       session->Project->BuildRoot.Sub("build_files.mark").Stringify();
 
-  makefile.Target(
-      "pre", ranges::views::single(regen_target),
-      core::builder::CustomCommandLines::Multiple(
-          core::builder::CustomCommandLine::Make(
-              {"@$(JK_COMMAND)", "start_progress",
-               fmt::format("--progress-mark={}",
-                           session->Project->BuildRoot.Sub("progress.mark")
-                               .Stringify()),
-               fmt::format("--progress-dir={}",
-                           session->Project->BuildRoot.Stringify())}),
-          // backward compatibility
-          core::builder::CustomCommandLine::Make(
-              {"mkdir", "-p",
-               session->Project->ProjectRoot.Sub(".build", "pb", "c++")
-                   .Stringify()}),
-          core::builder::CustomCommandLine::Make(
-              {"mkdir", "-p",
-               session->Project->ProjectRoot
-                   .Sub(".build", ".lib", "m64", "include")
-                   .Stringify()})),
-      "", true);
-
   makefile.Target("external", ranges::views::empty<std::string>,
                   ranges::views::empty<core::builder::CustomCommandLine>, "",
                   true);
@@ -192,9 +173,10 @@ auto RootCompiler::Compile(
   auto sorted = core::algorithms::topological_sort(scc);
   absl::flat_hash_set<uint32_t> visited;
   auto dfs = [&](uint32_t id, auto &&dfs) -> void {
-    visited.insert(id);
+    if (!visited.insert(id).second) {
+      return;
+    }
     for (uint32_t n : scc[id].Deps) {
-      visited.insert(n);
       dfs(n, dfs);
     }
   };
@@ -221,6 +203,43 @@ auto RootCompiler::Compile(
                   }) |
                   ranges::to<absl::flat_hash_set<std::string>>;
 
+  auto pre_stmts = core::builder::CustomCommandLines::Multiple(
+      core::builder::CustomCommandLine::Make(
+          {"@$(JK_COMMAND)", "start_progress",
+           fmt::format(
+               "--progress-mark={}",
+               session->Project->BuildRoot.Sub("progress.mark").Stringify()),
+           fmt::format("--progress-dir={}",
+                       session->Project->BuildRoot.Stringify())}),
+      // backward compatibility
+      core::builder::CustomCommandLine::Make(
+          {"mkdir", "-p",
+           session->Project->ProjectRoot.Sub(".build", "pb", "c++")
+               .Stringify()}),
+      core::builder::CustomCommandLine::Make(
+          {"mkdir", "-p",
+           session->Project->ProjectRoot
+               .Sub(".build", ".lib", "m64", "include")
+               .Stringify()}));
+
+  // `GIT_DESC` of each repository, once per build instead of running git in
+  // each compile command
+  std::map<std::string, std::string> git_desc_files;
+  for (const auto &package : packages) {
+    auto repository =
+        GitRepository(session, session->Project->ProjectRoot.Sub(package));
+    git_desc_files.emplace(GitDescFile(session, repository).Stringify(),
+                           repository.Stringify());
+  }
+  for (const auto &[output, repository] : git_desc_files) {
+    pre_stmts.push_back(core::builder::CustomCommandLine::Make(
+        {"@$(JK_COMMAND)", "git_desc", fmt::format("--dir={}", repository),
+         fmt::format("--output={}", output)}));
+  }
+
+  makefile.Target("pre", ranges::views::single(regen_target), pre_stmts, "",
+                  true);
+
   auto regen_stmt = core::builder::CustomCommandLine::FromVec(
       ranges::views::concat(
           ranges::views::single("-@$(JK_COMMAND)"),
@@ -235,6 +254,13 @@ auto RootCompiler::Compile(
           packages | ranges::views::transform([&](const auto &s) {
             return session->Project->ProjectRoot.Sub(s, "BUILD").Stringify();
           }),
+          // files to lint are listed when generating
+          packages | ranges::views::transform([&](const auto &s) {
+            return fmt::format(
+                "$(wildcard {})",
+                session->Project->ProjectRoot.Sub(s, "nolint.txt")
+                    .Stringify());
+          }),
           ranges::views::single(
               session->Project->ProjectRoot.Sub(session->ProjectMarker)
                   .Stringify())),
@@ -267,6 +293,36 @@ auto RootCompiler::Compile(
         absl::AsciiStrToLower(build_type), ranges::views::single(build_type),
         ranges::views::empty<core::builder::CustomCommandLine>, "simple usage");
   }
+  // Build types not generated this time, generate them on first use.
+  for (const auto &type_config : session->Project->Config().build_types) {
+    const auto &build_type = type_config.name;
+    if (ranges::contains(session->BuildTypes, build_type)) {
+      continue;
+    }
+
+    // don't ignore errors here, or it will come back to this target again
+    auto regen_with_type = core::builder::CustomCommandLine::FromVec(
+        ranges::views::concat(
+            ranges::views::single(std::string{"@$(JK_COMMAND)"}),
+            cli::CommandLineArguments | ranges::views::drop(1),
+            ranges::views::single(
+                fmt::format("--build-type={}", build_type))) |
+        ranges::to_vector);
+
+    makefile.Target(
+        build_type, ranges::views::empty<std::string>,
+        core::builder::CustomCommandLines::Multiple(
+            std::move(regen_with_type),
+            core::builder::CustomCommandLine::Make(
+                {"@$(MAKE)", "-f",
+                 session->Project->ProjectRoot.Sub("Makefile").Stringify(),
+                 build_type})),
+        fmt::format("Build type {} is not generated yet.", build_type), true);
+    makefile.Target(
+        absl::AsciiStrToLower(build_type), ranges::views::single(build_type),
+        ranges::views::empty<core::builder::CustomCommandLine>, "simple usage");
+  }
+
   makefile.Target("clean", clean_targets,
                   ranges::views::empty<core::builder::CustomCommandLine>, "",
                   true);
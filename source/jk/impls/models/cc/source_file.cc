@@ -98,17 +98,11 @@ common::AbsolutePath SourceFile::ResolveFullQualifiedObjectPath(
 }
 
 auto SourceFile::ResolveFullQualifiedDotDPath(
-    const common::AbsolutePath &new_root) const -> common::AbsolutePath {
-  auto p = FullQualifiedPath;
-  p.Path = p.Path.parent_path() / (p.Path.filename().string() + ".d");
-  return new_root.Sub(p.Path);
-}
-
-auto SourceFile::ResolveFullQualifiedLintPath(
-    const common::AbsolutePath &new_root) const -> common::AbsolutePath {
-  auto p = FullQualifiedPath;
-  p.Path = p.Path.parent_path() / (p.Path.filename().string() + ".lint");
-  return new_root.Sub(p.Path);
+    const common::AbsolutePath &new_root, std::string_view build_type) const
+    -> common::AbsolutePath {
+  auto p = FullQualifiedObjectPath;
+  p.Path.replace_extension(".d");
+  return new_root.Sub(build_type, p.Path);
 }
 
 auto SourceFile::ResolveFullQualifiedPbPath(
@@ -24,14 +24,14 @@ struct SourceFile {
 
   core::models::BuildRule *Rule;
 
-  bool lint{false};
-
   bool IsCSourceFile;
   bool IsCppSourceFile;
   bool IsSourceFile;
   bool IsHeaderFile;
 
   common::ProjectRelativePath FullQualifiedPath;
+  //! Object relative to the working folder of a build type, the source path
+  //! with `.o` appended unless set explicitly
   common::ProjectRelativePath FullQualifiedObjectPath;
 
   common::AbsolutePath ResolveFullQualifiedPath(
@@ -40,11 +40,9 @@ struct SourceFile {
   common::AbsolutePath ResolveFullQualifiedObjectPath(
       const common::AbsolutePath &new_root, std::string_view build_type) const;
 
+  //! Depfile written by `-MD`/`-MMD` next to the object of `build_type`
   common::AbsolutePath ResolveFullQualifiedDotDPath(
-      const common::AbsolutePath &new_root) const;
-
-  common::AbsolutePath ResolveFullQualifiedLintPath(
-      const common::AbsolutePath &new_root) const;
+      const common::AbsolutePath &new_root, std::string_view build_type) const;
 
   common::AbsolutePath ResolveFullQualifiedPbPath(
       const common::AbsolutePath &new_root) const;
@@ -3,7 +3,7 @@
 
 #include "jk/impls/rules/cc_binary.hh"
 
-#include <variant>
+#include <string>
 
 #include "jk/core/error.h"
 #include "jk/utils/logging.hh"
@@ -32,25 +32,24 @@ auto CCBinary::ExtractFieldFromArguments(const utils::Kwargs &kwargs) -> void {
   //   "r0": ["r1", "r2"]
   // }
   // TODO(hawtian): update field name
-  auto it = kwargs.Find(ADD_DEPS_FIELD);
-  if (it != kwargs.End()) {
-    const auto &add_deps = it->second;
-    if (add_deps.value.index() != 2) {
+  if (auto add_deps = kwargs.Find(ADD_DEPS_FIELD); add_deps) {
+    if (add_deps->Kind() != utils::Kwargs::ValueKind::kDict) {
       JK_THROW(
           core::JKBuildError("field '{}' expect type dict", ADD_DEPS_FIELD));
     }
 
-    for (const auto &[r, deps] : std::get<2>(add_deps.value)) {
-      if (deps->value.index() == 0) {
-        RawAddtionalDependencies[r].push_back(std::get<0>(deps->value));
-      } else if (deps->value.index() == 1) {
-        for (const auto &dep : std::get<1>(deps->value)) {
-          if (dep->value.index() != 0) {
-            JK_THROW(core::JKBuildError("field '{}' value expect str",
-                                        ADD_DEPS_FIELD));
-          }
-          RawAddtionalDependencies[r].push_back(std::get<0>(dep->value));
+    for (uint32_t i = 0; i < add_deps->Size(); i++) {
+      auto [r, deps] = add_deps->Item(i);
+      auto &res      = RawAddtionalDependencies[std::string(r)];
+      if (deps.Kind() == utils::Kwargs::ValueKind::kString) {
+        res.emplace_back(deps.String());
+      } else if (deps.Kind() == utils::Kwargs::ValueKind::kList) {
+        auto strings = deps.Strings();
+        if (!strings) {
+          JK_THROW(core::JKBuildError("field '{}' value expect str",
+                                      ADD_DEPS_FIELD));
         }
+        res.insert(res.end(), strings->begin(), strings->end());
       } else {
         JK_THROW(core::JKBuildError("field '{}' value expect str or list",
                                     ADD_DEPS_FIELD));
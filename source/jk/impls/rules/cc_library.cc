@@ -12,9 +12,11 @@
 #include "absl/strings/match.h"
 #include "absl/strings/str_join.h"
 #include "absl/strings/strip.h"
+#include "jk/core/error.h"
 #include "jk/core/models/build_package.hh"
 #include "jk/core/models/build_rule.hh"
 #include "jk/core/models/rule_type.hh"
+#include "jk/utils/logging.hh"
 #include "range/v3/range/conversion.hpp"
 #include "range/v3/view/concat.hpp"
 #include "range/v3/view/filter.hpp"
@@ -29,11 +31,13 @@ CCLibrary::CCLibrary(core::models::BuildPackage *package, utils::Kwargs kwargs,
                 std::move(kwargs)) {
 }
 
-#define FILL_LIST_FIELD(field, key) field = kwargs.ListOptional(key, empty_list)
+#define FILL_LIST_FIELD(field, key)    \
+  do {                                 \
+    auto v = kwargs.ListOptional(key); \
+    field.assign(v.begin(), v.end());  \
+  } while (0)
 
 auto CCLibrary::ExtractFieldFromArguments(const utils::Kwargs &kwargs) -> void {
-  static auto empty_list = std::make_optional<std::vector<std::string>>({});
-
   BuildRule::ExtractFieldFromArguments(kwargs);
 
   logger->debug("Extract fields, {}", Base->FullQualifiedName);
@@ -48,6 +52,14 @@ auto CCLibrary::ExtractFieldFromArguments(const utils::Kwargs &kwargs) -> void {
   FILL_LIST_FIELD(Defines, "defines");
   FILL_LIST_FIELD(Headers, "headers");
   FILL_LIST_FIELD(AlwaysCompile, "always_compile");
+  FILL_LIST_FIELD(UnityExcludes, "unity_excludes");
+
+  auto unity_batch = kwargs.IntegerOptional("unity_batch", 0);
+  if (unity_batch < 0) {
+    JK_THROW(core::JKBuildError("unity_batch of {} must not be negative",
+                                Base->FullQualifiedName));
+  }
+  UnityBatch = static_cast<uint32_t>(unity_batch);
 
   if (Headers.empty()) {
     // NOTE(hawtian): for backward-compatibility Some files in library can't not
@@ -80,6 +92,7 @@ auto CCLibrary::DoPrepare(core::models::Session *session) -> void {
 
   // step 5. source files
   prepare_always_compile_files(session);
+  prepare_unity_exclude_files(session);
 
   // step 6. link flags
   ExportedLinkFlags = LdFlags;
@@ -106,9 +119,10 @@ auto CCLibrary::DoPrepare(core::models::Session *session) -> void {
                          ranges::to<decltype(ExpandedCFileFlags)>();
 
   // step 8. construct include and define flags
-  prepare_include_flags(session);
-  prepare_define_flags(session);
-  prepare_inherent_flags(session);
+  auto closure = session->Graph->Closure(Base->ObjectId);
+  prepare_include_flags(session, closure);
+  prepare_define_flags(session, closure);
+  prepare_inherent_flags(session, closure);
 }
 
 auto CCLibrary::prepare_nolint_files(core::models::Session *session) -> void {
@@ -201,14 +215,29 @@ auto CCLibrary::prepare_always_compile_files(core::models::Session *session)
                 absl::StrJoin(ExpandedAlwaysCompileFiles, ", "));
 }
 
-auto CCLibrary::prepare_include_flags(core::models::Session *session) -> void {
-  absl::flat_hash_set<uint32_t> visisted;
-  auto dfs = [this, &visisted, session](core::models::BuildRule *rule,
-                                        auto &&dfs) {
-    if (visisted.contains(rule->Base->ObjectId)) {
-      return;
+auto CCLibrary::prepare_unity_exclude_files(core::models::Session *session)
+    -> void {
+  ExpandedUnityExcludeFiles.clear();
+
+  for (const auto &source : UnityExcludes) {
+    auto expanded = session->PatternExpander->Expand(source, *package_root_);
+
+    for (const auto &f : expanded) {
+      ExpandedUnityExcludeFiles.insert(f);
     }
-    visisted.insert(rule->Base->ObjectId);
+  }
+
+  logger->debug("UnityExcludes in {}: [{}]", Base->StringifyValue,
+                absl::StrJoin(ExpandedUnityExcludeFiles, ", "));
+}
+
+auto CCLibrary::prepare_include_flags(core::models::Session *session,
+                                      std::span<const uint32_t> closure)
+    -> void {
+  ResolvedIncludes.insert("-I.");
+
+  for (auto id : closure) {
+    auto rule = session->Graph->Rule(id);
     if (auto cc_rule = dynamic_cast<CCLibrary *>(rule); cc_rule != nullptr) {
       for (const auto &s : ranges::views::concat(
                cc_rule->CppFlags, cc_rule->CFlags, cc_rule->CxxFlags)) {
@@ -231,31 +260,18 @@ auto CCLibrary::prepare_include_flags(core::models::Session *session) -> void {
                                     .Stringify()));
       }
     } else {
-      static std::vector<std::string> empty;
-
-      for (const auto &s :
-           rule->Base->_kwargs.ListOptional("includes", empty)) {
+      for (const auto &s : rule->ExportedIncludes) {
         ResolvedIncludes.insert(fmt::format("-I{}", s));
       }
     }
-
-    for (auto dep : rule->Dependencies) {
-      dfs(dep, dfs);
-    }
-  };
-
-  ResolvedIncludes.insert("-I.");
-
-  dfs(this, dfs);
+  }
 }
 
-auto CCLibrary::prepare_define_flags(core::models::Session *) -> void {
-  absl::flat_hash_set<uint32_t> visisted;
-  auto dfs = [this, &visisted](core::models::BuildRule *rule, auto &&dfs) {
-    if (visisted.contains(rule->Base->ObjectId)) {
-      return;
-    }
-    visisted.insert(rule->Base->ObjectId);
+auto CCLibrary::prepare_define_flags(core::models::Session *session,
+                                     std::span<const uint32_t> closure)
+    -> void {
+  for (auto id : closure) {
+    auto rule    = session->Graph->Rule(id);
     auto cc_rule = dynamic_cast<CCLibrary *>(rule);
     if (cc_rule) {
       // fast-path for cc_library
@@ -263,34 +279,21 @@ auto CCLibrary::prepare_define_flags(core::models::Session *) -> void {
         ResolvedDefines.insert(fmt::format("-D{}", s));
       }
     } else {
-      static std::vector<std::string> empty;
-      for (const auto &s : rule->Base->_kwargs.ListOptional("defines", empty)) {
+      for (const auto &s : rule->ExportedDefines) {
         ResolvedDefines.insert(fmt::format("-D{}", s));
       }
     }
-    for (auto dep : rule->Dependencies) {
-      dfs(dep, dfs);
-    }
-  };
-
-  dfs(this, dfs);
+  }
 }
 
-auto CCLibrary::prepare_inherent_flags(core::models::Session *) -> void {
-  absl::flat_hash_set<uint32_t> visisted;
-  auto dfs = [this, &visisted](core::models::BuildRule *rule, auto &&dfs) {
-    if (visisted.contains(rule->Base->ObjectId)) {
-      return;
-    }
-    visisted.insert(rule->Base->ObjectId);
+auto CCLibrary::prepare_inherent_flags(core::models::Session *session,
+                                       std::span<const uint32_t> closure)
+    -> void {
+  for (auto id : closure) {
+    auto rule = session->Graph->Rule(id);
     ResolvedInherentFlags.insert(std::begin(rule->InherentFlags),
                                  std::end(rule->InherentFlags));
-    for (auto dep : rule->Dependencies) {
-      dfs(dep, dfs);
-    }
-  };
-
-  dfs(this, dfs);
+  }
 }
 
 const std::vector<std::string> &CCLibrary::ExportedFiles(
@@ -3,7 +3,9 @@
 
 #pragma once  // NOLINT(build/header_guard)
 
+#include <cstdint>
 #include <optional>
+#include <span>
 #include <string>
 #include <vector>
 
@@ -37,6 +39,11 @@ class CCLibrary : public core::models::BuildRule {
   std::vector<std::string> Defines;
   std::vector<std::string> Headers;
   std::vector<std::string> AlwaysCompile;
+  std::vector<std::string> UnityExcludes;
+
+  //! How many sources will be merged into one unity source. 0 means unity
+  //! build is disabled for this rule, unless `--unity` is given.
+  uint32_t UnityBatch{0};
 
   const std::vector<std::string> &ExportedFiles(
       core::models::Session *session, std::string_view build_type) override;
@@ -50,9 +57,14 @@ class CCLibrary : public core::models::BuildRule {
   void prepare_source_files(core::models::Session *session);
   void prepare_header_files(core::models::Session *session);
   void prepare_always_compile_files(core::models::Session *session);
-  void prepare_include_flags(core::models::Session *session);
-  void prepare_define_flags(core::models::Session *session);
-  void prepare_inherent_flags(core::models::Session *session);
+  void prepare_unity_exclude_files(core::models::Session *session);
+  //! `closure` is this rule and all rules it depends on
+  void prepare_include_flags(core::models::Session *session,
+                             std::span<const uint32_t> closure);
+  void prepare_define_flags(core::models::Session *session,
+                            std::span<const uint32_t> closure);
+  void prepare_inherent_flags(core::models::Session *session,
+                              std::span<const uint32_t> closure);
 
   std::optional<common::AbsolutePath> package_root_;
   absl::flat_hash_set<std::string> excludes_;
@@ -63,6 +75,7 @@ class CCLibrary : public core::models::BuildRule {
   std::vector<std::string> ExpandedHeaderFiles;
   std::vector<std::string> ExpandedSourceFiles;
   absl::flat_hash_set<std::string> ExpandedAlwaysCompileFiles;
+  absl::flat_hash_set<std::string> ExpandedUnityExcludeFiles;
   std::string LibraryFileName;
   std::vector<std::string> ExpandedCFileFlags;
   std::vector<std::string> ExpandedCppFileFlags;
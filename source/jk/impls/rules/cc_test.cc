@@ -3,6 +3,11 @@
 
 #include "jk/impls/rules/cc_test.hh"
 
+#include <algorithm>
+#include <string>
+
+#include "jk/core/error.h"
+
 namespace jk::impls::rules {
 
 CCTest::CCTest(core::models::BuildPackage *package, utils::Kwargs kwargs,
@@ -10,4 +15,45 @@ CCTest::CCTest(core::models::BuildPackage *package, utils::Kwargs kwargs,
     : CCBinary(package, std::move(kwargs), std::move(type_name), type) {
 }
 
+auto CCTest::ExtractFieldFromArguments(const utils::Kwargs &kwargs) -> void {
+  CCBinary::ExtractFieldFromArguments(kwargs);
+
+  auto shard_count = kwargs.IntegerOptional("shard_count", 1);
+  if (shard_count < 1) {
+    JK_THROW(core::JKBuildError("shard_count of {} must be positive",
+                                Base->FullQualifiedName));
+  }
+  ShardCount = static_cast<uint32_t>(shard_count);
+
+  auto timeout = kwargs.IntegerOptional("timeout", 0);
+  if (timeout < 0) {
+    JK_THROW(core::JKBuildError("timeout of {} must not be negative",
+                                Base->FullQualifiedName));
+  }
+  Timeout = static_cast<uint32_t>(timeout);
+
+  auto data = kwargs.ListOptional("data");
+  Data.assign(data.begin(), data.end());
+
+  // env = {
+  //   "KEY": "VALUE"
+  // }
+  Env.clear();
+  if (auto env = kwargs.Find("env"); env) {
+    if (env->Kind() != utils::Kwargs::ValueKind::kDict) {
+      JK_THROW(core::JKBuildError("field 'env' expect type dict"));
+    }
+
+    for (uint32_t i = 0; i < env->Size(); i++) {
+      auto [key, value] = env->Item(i);
+      if (value.Kind() != utils::Kwargs::ValueKind::kString) {
+        JK_THROW(core::JKBuildError("field 'env' value expect str"));
+      }
+      Env.emplace_back(key, value.String());
+    }
+    // dict is unordered, keep the order stable for cache keys
+    std::sort(Env.begin(), Env.end());
+  }
+}
+
 }  // namespace jk::impls::rules
@@ -3,6 +3,11 @@
 
 #pragma once  // NOLINT(build/header_guard)
 
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
 #include "jk/impls/rules/cc_binary.hh"
 
 namespace jk::impls::rules {
@@ -16,6 +21,26 @@ class CCTest : public CCBinary {
              core::models::RuleTypeEnum::kCC,
              core::models::RuleTypeEnum::kTest,
          });
+
+  //! Runs the test in this many gtest shards by `jk test`
+  // [[arg: `shard_count`]]
+  uint32_t ShardCount;
+
+  //! Timeout of each shard in seconds, 0 to use the default of `jk test`
+  // [[arg: `timeout`]]
+  uint32_t Timeout;
+
+  //! Files read by the test at runtime, relative to the package. They are
+  //! part of the key of cached test results.
+  // [[arg: `data`]]
+  std::vector<std::string> Data;
+
+  //! Extra environment variables of the test
+  // [[arg: `env`]]
+  std::vector<std::pair<std::string, std::string>> Env;
+
+ protected:
+  void ExtractFieldFromArguments(const utils::Kwargs &kwargs) override;
 };
 
-}  // namespace jk::impls::cc
+}  // namespace jk::impls::rules
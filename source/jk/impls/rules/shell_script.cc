@@ -27,46 +27,42 @@ auto ShellScript::ExtractFieldFromArguments(const utils::Kwargs &kwargs)
     -> void {
   BuildRule::ExtractFieldFromArguments(kwargs);
 
-  auto empty_list = std::make_optional<std::vector<std::string>>({});
-
   Script = kwargs.StringRequired("script");
   do {
-    auto it = kwargs.Find("export");
-    if (it == kwargs.End()) {
+    auto exports = kwargs.Find("export");
+    if (!exports) {
       JK_THROW(core::JKBuildError("expect field '{}' but not found", "export"));
     }
-    if (it->second.value.index() == 0) {
-      Exports = std::vector<std::string>{std::get<0>(it->second.value)};
+    if (exports->Kind() == utils::Kwargs::ValueKind::kString) {
+      Exports = std::vector<std::string>{std::string(exports->String())};
       break;
     }
-    if (it->second.value.index() == 1) {
-      Exports.clear();
-
-      for (const auto &x : std::get<1>(it->second.value)) {
-        Exports.push_back(std::get<0>(x->value));
-      }
+    if (auto strings = exports->Strings(); strings) {
+      Exports.assign(strings->begin(), strings->end());
       break;
     }
 
     JK_THROW(core::JKBuildError("field '{}' expect type list or str, but {}",
-                                "export", it->second.value.index()));
+                                "export", exports->ToString()));
   } while (0);
   do {
-    auto it = kwargs.Find("export_bin");
-    if (it == kwargs.End()) {
+    auto export_bin = kwargs.Find("export_bin");
+    if (!export_bin) {
       break;
     }
-    if (it->second.value.index() != 2) {
+    if (export_bin->Kind() != utils::Kwargs::ValueKind::kDict) {
       JK_THROW(core::JKBuildError("field '{}' expect type dict", "export_bin"));
     }
 
     ExportBin.clear();
-    for (auto [k, v] : std::get<2>(it->second.value)) {
-      ExportBin[k] = std::get<0>(v->value);
+    for (uint32_t i = 0; i < export_bin->Size(); i++) {
+      auto [k, v] = export_bin->Item(i);
+      ExportBin.emplace(k, v.String());
     }
   } while (0);
 
-  LdFlags = kwargs.ListOptional("ldflags", empty_list);
+  auto ldflags = kwargs.ListOptional("ldflags");
+  LdFlags.assign(ldflags.begin(), ldflags.end());
 }
 
 auto ShellScript::DoPrepare(core::models::Session *session) -> void {
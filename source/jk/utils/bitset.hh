@@ -0,0 +1,41 @@
+// Copyright (c) 2020 Hawtian Wang
+//
+
+#pragma once  // NOLINT(build/header_guard)
+
+#include <cstdint>
+#include <vector>
+
+namespace jk::utils {
+
+//! A fixed-size bitset with the size given at runtime, used as visited set of
+//! graph walks over dense ids.
+class DynamicBitset {
+ public:
+  explicit DynamicBitset(uint32_t size) : words_((size + 63) / 64, 0) {
+  }
+
+  bool Test(uint32_t i) const {
+    return (words_[i / 64] >> (i % 64)) & 1;
+  }
+
+  //! Sets bit `i`, returns false if it was already set
+  bool Set(uint32_t i) {
+    auto mask  = uint64_t{1} << (i % 64);
+    auto &word = words_[i / 64];
+    if (word & mask) {
+      return false;
+    }
+    word |= mask;
+    return true;
+  }
+
+  void Reset(uint32_t i) {
+    words_[i / 64] &= ~(uint64_t{1} << (i % 64));
+  }
+
+ private:
+  std::vector<uint64_t> words_;
+};
+
+}  // namespace jk::utils
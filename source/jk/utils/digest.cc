@@ -0,0 +1,66 @@
+// Copyright (c) 2020 - present, Hawtian Wang (twistoy.wang@gmail.com)
+//
+
+#include "jk/utils/digest.hh"
+
+#include <openssl/evp.h>
+
+#include <cstdio>
+#include <memory>
+#include <string>
+
+#include "fmt/format.h"
+#include "jk/core/error.h"
+#include "jk/utils/logging.hh"
+
+namespace jk::utils {
+
+Digest::Digest(std::string_view method) : ctx_(EVP_MD_CTX_new()) {
+  auto md = EVP_get_digestbyname(std::string(method).c_str());
+  if (md == nullptr) {
+    EVP_MD_CTX_free(ctx_);
+    JK_THROW(core::JKBuildError("Digest method {} is not supported.", method));
+  }
+  EVP_DigestInit_ex(ctx_, md, nullptr);
+}
+
+Digest::~Digest() {
+  EVP_MD_CTX_free(ctx_);
+}
+
+auto Digest::Update(std::string_view data) -> Digest & {
+  EVP_DigestUpdate(ctx_, data.data(), data.size());
+  return *this;
+}
+
+auto Digest::HexDigest() -> std::string {
+  unsigned char hash[EVP_MAX_MD_SIZE];
+  unsigned int len = 0;
+  EVP_DigestFinal_ex(ctx_, hash, &len);
+
+  std::string res;
+  res.reserve(len * 2);
+  for (unsigned int i = 0; i < len; i++) {
+    res += fmt::format("{:02x}", hash[i]);
+  }
+  return res;
+}
+
+std::string HashFile(const std::filesystem::path &file,
+                     std::string_view method) {
+  std::unique_ptr<FILE, decltype(&fclose)> fp(fopen(file.c_str(), "rb"),
+                                              &fclose);
+  if (!fp) {
+    JK_THROW(core::JKBuildError("Open file {} error.", file.string()));
+  }
+
+  Digest digest(method);
+  char buffer[32768];
+  size_t bytes_read = 0;
+  while ((bytes_read = fread(buffer, 1, sizeof(buffer), fp.get())) > 0) {
+    digest.Update({buffer, bytes_read});
+  }
+  return digest.HexDigest();
+}
+
+}  // namespace jk::utils
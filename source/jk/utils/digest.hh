@@ -0,0 +1,37 @@
+// Copyright (c) 2020 - present, Hawtian Wang (twistoy.wang@gmail.com)
+//
+
+#pragma once  // NOLINT(build/header_guard)
+
+#include <filesystem>
+#include <string>
+#include <string_view>
+
+struct evp_md_ctx_st;
+
+namespace jk::utils {
+
+//! Incremental message digest, backed by openssl EVP. `method` is the name of
+//! the digest, like "sha256".
+class Digest {
+ public:
+  explicit Digest(std::string_view method = "sha256");
+  ~Digest();
+
+  Digest(const Digest &)            = delete;
+  Digest &operator=(const Digest &) = delete;
+
+  Digest &Update(std::string_view data);
+
+  //! Returns the lower-case hex digest, the digest can't be updated after.
+  std::string HexDigest();
+
+ private:
+  evp_md_ctx_st *ctx_;
+};
+
+//! Returns the hex digest of file's content.
+std::string HashFile(const std::filesystem::path &file,
+                     std::string_view method = "sha256");
+
+}  // namespace jk::utils
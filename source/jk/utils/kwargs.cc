@@ -3,210 +3,335 @@
 
 #include "jk/utils/kwargs.hh"
 
-#include <concepts>
-#include <iostream>
-#include <sstream>
+#include <algorithm>
+#include <cstring>
 #include <string>
-#include <type_traits>
 #include <vector>
 
-#include "absl/container/flat_hash_set.h"
-#include "absl/strings/str_join.h"
+#include "fmt/format.h"
 #include "jk/core/error.h"
 #include "jk/utils/logging.hh"
-#include "jk/utils/str.hh"
-#include "pybind11/cast.h"
 #include "pybind11/pytypes.h"
-#include "pybind11/stl.h"
-#include "range/v3/numeric/iota.hpp"
-#include "range/v3/range/conversion.hpp"
-#include "range/v3/range/primitives.hpp"
-#include "range/v3/view/all.hpp"
-#include "range/v3/view/any_view.hpp"
-#include "range/v3/view/concat.hpp"
-#include "range/v3/view/empty.hpp"
-#include "range/v3/view/filter.hpp"
-#include "range/v3/view/for_each.hpp"
-#include "range/v3/view/iota.hpp"
-#include "range/v3/view/join.hpp"
-#include "range/v3/view/single.hpp"
-#include "range/v3/view/take.hpp"
-#include "range/v3/view/transform.hpp"
 
 namespace jk::utils {
 
-KwargsValue::KwargsValue(const pybind11::handle &_object) {
-  auto object = pybind11::reinterpret_borrow<pybind11::object>(_object);
+static bool is_string(const pybind11::handle &object) {
+  return pybind11::isinstance<pybind11::str>(object) ||
+         pybind11::isinstance<pybind11::bytes>(object);
+}
+
+Kwargs::Kwargs() = default;
+
+Kwargs::Kwargs(const pybind11::kwargs &args) {
+  values_.resize(1);
+  fill(0, args);
+}
+
+std::string_view Kwargs::intern(std::string_view s) {
+  if (arena_.empty() || arena_used_ + s.size() > arena_capacity_) {
+    arena_capacity_ = std::max(kChunkSize, s.size());
+    arena_used_     = 0;
+    arena_.push_back(std::make_unique<char[]>(arena_capacity_));
+  }
+
+  auto *p = arena_.back().get() + arena_used_;
+  std::memcpy(p, s.data(), s.size());
+  arena_used_ += s.size();
+  return {p, s.size()};
+}
+
+bool Kwargs::fill_string(uint32_t index, const pybind11::handle &object) {
+  Py_ssize_t size = 0;
+  const char *buf = nullptr;
+
+  if (PyUnicode_Check(object.ptr())) {
+    buf = PyUnicode_AsUTF8AndSize(object.ptr(), &size);
+    if (buf == nullptr) {
+      throw pybind11::error_already_set();
+    }
+  } else if (PyBytes_Check(object.ptr())) {
+    char *bytes = nullptr;
+    PyBytes_AsStringAndSize(object.ptr(), &bytes, &size);
+    buf = bytes;
+  } else {
+    return false;
+  }
+
+  values_[index] = Node{.Kind = ValueKind::kString,
+                        .Data = static_cast<int64_t>(views_.size())};
+  views_.push_back(intern({buf, static_cast<size_t>(size)}));
+  return true;
+}
+
+void Kwargs::fill(uint32_t index, const pybind11::handle &object) {
+  if (fill_string(index, object)) {
+    return;
+  }
 
   if (pybind11::isinstance<pybind11::list>(object)) {
-    std::vector<Ptr> res;
-    for (const auto &v : pybind11::reinterpret_borrow<pybind11::list>(object)) {
-      res.emplace_back(std::make_shared<KwargsValue>(v));
+    auto list  = pybind11::reinterpret_borrow<pybind11::list>(object);
+    auto first = static_cast<uint32_t>(values_.size());
+    auto size  = static_cast<uint32_t>(list.size());
+    values_.resize(first + size);
+    values_[index] =
+        Node{.Kind = ValueKind::kList, .Size = size, .Data = first};
+
+    // strings first, keeps views of a list of strings contiguous
+    uint32_t i = 0;
+    for (const auto &item : list) {
+      fill_string(first + i, item);
+      i++;
+    }
+    i = 0;
+    for (const auto &item : list) {
+      if (!is_string(item)) {
+        fill(first + i, item);
+      }
+      i++;
     }
-    value = std::move(res);
-  } else if (pybind11::isinstance<pybind11::str>(object) ||
-             pybind11::isinstance<pybind11::bytes>(object)) {
-    value = object.cast<std::string>();
+  } else if (pybind11::isinstance<pybind11::bool_>(object)) {
+    // NOTE: `bool` is a subclass of `int` in python, check it first
+    values_[index] =
+        Node{.Kind = ValueKind::kBoolean, .Data = object.cast<bool>()};
+  } else if (pybind11::isinstance<pybind11::int_>(object)) {
+    values_[index] =
+        Node{.Kind = ValueKind::kInteger, .Data = object.cast<int64_t>()};
   } else if (pybind11::isinstance<pybind11::dict>(object)) {
-    for (const auto &it :
-         pybind11::reinterpret_borrow<pybind11::dict>(object)) {
-      auto key = it.first.cast<std::string>();
-      MapType res;
-      res.emplace(key, std::make_shared<KwargsValue>(it.second));
-      value = std::move(res);
+    auto dict  = pybind11::reinterpret_borrow<pybind11::dict>(object);
+    auto first = static_cast<uint32_t>(values_.size());
+    auto size  = static_cast<uint32_t>(dict.size());
+    values_.resize(first + 2 * size);
+    values_[index] =
+        Node{.Kind = ValueKind::kDict, .Size = size, .Data = first};
+
+    uint32_t i = 0;
+    for (const auto &it : dict) {
+      if (!fill_string(first + 2 * i, it.first)) {
+        JK_THROW(core::JKBuildError("dict key expect type str"));
+      }
+      i++;
+    }
+    i = 0;
+    for (const auto &it : dict) {
+      fill(first + 2 * i + 1, it.second);
+      i++;
     }
   } else {
     JK_THROW(core::JKBuildError("unknown type"));
   }
 }
 
-auto KwargsValue::to_string() const -> std::string {
-  return std::visit(
-      [](const auto &v) -> std::string {
-        using T = std::remove_cvref_t<decltype(v)>;
-
-        if constexpr (std::is_same_v<T, std::string>) {
-          return fmt::format("\"{}\"", v);
-        } else if constexpr (std::is_same_v<T, ListType>) {
-          return "[" +
-                 absl::StrJoin(v | ranges::views::transform([](auto &x) {
-                                 return x->to_string();
-                               }),
-                               ", ") +
-                 "]";
-        } else if constexpr (std::is_same_v<T, MapType>) {
-          return "{" +
-                 absl::StrJoin(v | ranges::views::transform([](auto &x) {
-                                 return x.first + ": " + x.second->to_string();
-                               }),
-                               ", ") +
-                 "}";
-        } else if constexpr (std::is_same_v<T, bool>) {
-          if (v) {
-            return "true";
-          } else {
-            return "false";
-          }
-        }
-      },
-      value);
+auto Kwargs::Value::Kind() const -> ValueKind {
+  return owner_->node(index_).Kind;
 }
 
-Kwargs::Kwargs(const pybind11::kwargs &args) {
-  for (auto &it : args) {
-    auto key = it.first.cast<std::string>();
-    value_.emplace(key, KwargsValue(it.second));
+std::string_view Kwargs::Value::String() const {
+  const auto &n = owner_->node(index_);
+  if (n.Kind != ValueKind::kString) {
+    JK_THROW(core::JKBuildError("expect type str"));
   }
+  return owner_->views_[n.Data];
 }
 
-std::string Kwargs::gen_stringify_cache() const {
-  std::ostringstream oss;
-  oss << "Kwargs {";
-  oss << JoinString(
-      ", ", value_.begin(), value_.end(), [](const auto &pr) -> std::string {
-        return fmt::format("{}: {}", pr.first, pr.second.to_string());
-      });
-  oss << "}";
-  return oss.str();
-}
-
-Kwargs::StringType Kwargs::StringRequired(const std::string &name) const {
-  auto it = value_.find(name);
-  if (it == value_.end()) {
-    JK_THROW(core::JKBuildError("expect field '{}' but not found", name));
+bool Kwargs::Value::Boolean() const {
+  const auto &n = owner_->node(index_);
+  if (n.Kind != ValueKind::kBoolean) {
+    JK_THROW(core::JKBuildError("expect type boolean"));
   }
+  return n.Data != 0;
+}
 
-  if (it->second.value.index() != 0) {
-    JK_THROW(core::JKBuildError("field '{}' expect type str", name));
+int64_t Kwargs::Value::Integer() const {
+  const auto &n = owner_->node(index_);
+  if (n.Kind != ValueKind::kInteger) {
+    JK_THROW(core::JKBuildError("expect type int"));
   }
+  return n.Data;
+}
 
-  return std::get<0>(it->second.value);
+uint32_t Kwargs::Value::Size() const {
+  return owner_->node(index_).Size;
 }
 
-std::vector<std::string> Kwargs::ListRequired(const std::string &name) const {
-  auto it = value_.find(name);
-  if (it == value_.end()) {
-    JK_THROW(core::JKBuildError("expect field '{}' but not found", name));
+auto Kwargs::Value::At(uint32_t i) const -> Value {
+  const auto &n = owner_->node(index_);
+  if (n.Kind != ValueKind::kList) {
+    JK_THROW(core::JKBuildError("expect type list"));
   }
+  return {owner_, static_cast<uint32_t>(n.Data) + i};
+}
+
+auto Kwargs::Value::Item(uint32_t i) const
+    -> std::pair<std::string_view, Value> {
+  const auto &n = owner_->node(index_);
+  if (n.Kind != ValueKind::kDict) {
+    JK_THROW(core::JKBuildError("expect type dict"));
+  }
+  auto key = static_cast<uint32_t>(n.Data) + 2 * i;
+  return {Value{owner_, key}.String(), Value{owner_, key + 1}};
+}
 
-  if (it->second.value.index() != 1) {
-    JK_THROW(core::JKBuildError("field '{}' expect type list", name));
+auto Kwargs::Value::Strings() const
+    -> std::optional<std::span<const std::string_view>> {
+  const auto &n = owner_->node(index_);
+  if (n.Kind != ValueKind::kList) {
+    return {};
   }
-  std::vector<std::string> res;
-  for (const auto &x : std::get<1>(it->second.value)) {
-    res.push_back(std::get<0>(x->value));
+  if (n.Size == 0) {
+    return std::span<const std::string_view>{};
   }
 
-  return res;
+  for (uint32_t i = 0; i < n.Size; i++) {
+    if (owner_->node(n.Data + i).Kind != ValueKind::kString) {
+      return {};
+    }
+  }
+  return std::span{owner_->views_}.subspan(owner_->node(n.Data).Data, n.Size);
 }
 
-std::vector<std::string> Kwargs::ListOptional(
-    const std::string &name,
-    std::optional<std::vector<std::string> > default_value) const {
-  auto it = value_.find(name);
-  if (it == value_.end()) {
-    if (default_value) {
-      return default_value.value();
+std::string Kwargs::Value::ToString() const {
+  const auto &n = owner_->node(index_);
+  switch (n.Kind) {
+    case ValueKind::kString:
+      return fmt::format("\"{}\"", String());
+    case ValueKind::kList: {
+      std::string res = "[";
+      for (uint32_t i = 0; i < n.Size; i++) {
+        if (i > 0) {
+          res += ", ";
+        }
+        res += At(i).ToString();
+      }
+      return res + "]";
     }
-    JK_THROW(core::JKBuildError("expect field '{}' but not found", name));
+    case ValueKind::kDict: {
+      std::string res = "{";
+      for (uint32_t i = 0; i < n.Size; i++) {
+        if (i > 0) {
+          res += ", ";
+        }
+        auto [key, value] = Item(i);
+        res += fmt::format("{}: {}", key, value.ToString());
+      }
+      return res + "}";
+    }
+    case ValueKind::kBoolean:
+      return n.Data ? "true" : "false";
+    case ValueKind::kInteger:
+      return std::to_string(n.Data);
   }
+  return {};
+}
 
-  if (it->second.value.index() != 1) {
-    JK_THROW(core::JKBuildError("field '{}' expect type list", name));
+std::string Kwargs::gen_stringify_cache() const {
+  if (values_.empty()) {
+    return "Kwargs {}";
+  }
+  return "Kwargs " + Value{this, 0}.ToString();
+}
+
+auto Kwargs::Find(std::string_view name) const -> std::optional<Value> {
+  if (values_.empty()) {
+    return {};
   }
-  std::vector<std::string> res;
-  for (const auto &x : std::get<1>(it->second.value)) {
-    res.push_back(std::get<0>(x->value));
+
+  // rules have few arguments, a linear scan beats hashing here
+  const auto &root = node(0);
+  for (uint32_t i = 0; i < root.Size; i++) {
+    auto key = static_cast<uint32_t>(root.Data) + 2 * i;
+    if (views_[node(key).Data] == name) {
+      return Value{this, key + 1};
+    }
   }
+  return {};
+}
 
-  return res;
+void Kwargs::Release() {
+  *this = Kwargs{};
+  reset_stringify_cache();
 }
 
-Kwargs::StringType Kwargs::StringOptional(
-    const std::string &name, std::optional<StringType> default_value) const {
-  auto it = value_.find(name);
-  if (it == value_.end()) {
+std::string_view Kwargs::StringRequired(std::string_view name) const {
+  return StringOptional(name, std::nullopt);
+}
+
+std::string_view Kwargs::StringOptional(
+    std::string_view name,
+    std::optional<std::string_view> default_value) const {
+  auto value = Find(name);
+  if (!value) {
     if (default_value) {
       return default_value.value();
     }
     JK_THROW(core::JKBuildError("expect field '{}' but not found", name));
   }
 
-  if (it->second.value.index() != 1) {
+  if (value->Kind() != ValueKind::kString) {
     JK_THROW(core::JKBuildError("field '{}' expect type str", name));
   }
 
-  return std::get<0>(it->second.value);
+  return value->String();
 }
 
-bool Kwargs::BooleanRequired(const std::string &name) const {
-  auto it = value_.find(name);
-  if (it == value_.end()) {
+std::span<const std::string_view> Kwargs::ListRequired(
+    std::string_view name) const {
+  if (!Find(name)) {
     JK_THROW(core::JKBuildError("expect field '{}' but not found", name));
   }
+  return ListOptional(name);
+}
 
-  if (it->second.value.index() != 3) {
-    JK_THROW(core::JKBuildError("field '{}' expect type boolean", name));
+std::span<const std::string_view> Kwargs::ListOptional(
+    std::string_view name,
+    std::span<const std::string_view> default_value) const {
+  auto value = Find(name);
+  if (!value) {
+    return default_value;
+  }
+
+  auto res = value->Strings();
+  if (!res) {
+    JK_THROW(core::JKBuildError("field '{}' expect type list of str", name));
   }
+  return *res;
+}
 
-  return std::get<3>(it->second.value);
+bool Kwargs::BooleanRequired(std::string_view name) const {
+  return BooleanOptional(name, std::nullopt);
 }
 
-bool Kwargs::BooleanOptional(const std::string &name,
+bool Kwargs::BooleanOptional(std::string_view name,
                              std::optional<bool> default_value) const {
-  auto it = value_.find(name);
-  if (it == value_.end()) {
+  auto value = Find(name);
+  if (!value) {
     if (default_value) {
       return default_value.value();
     }
     JK_THROW(core::JKBuildError("expect field '{}' but not found", name));
   }
 
-  if (it->second.value.index() != 3) {
+  if (value->Kind() != ValueKind::kBoolean) {
     JK_THROW(core::JKBuildError("field '{}' expect type boolean", name));
   }
 
-  return std::get<3>(it->second.value);
+  return value->Boolean();
+}
+
+int64_t Kwargs::IntegerOptional(std::string_view name,
+                                std::optional<int64_t> default_value) const {
+  auto value = Find(name);
+  if (!value) {
+    if (default_value) {
+      return default_value.value();
+    }
+    JK_THROW(core::JKBuildError("expect field '{}' but not found", name));
+  }
+
+  if (value->Kind() != ValueKind::kInteger) {
+    JK_THROW(core::JKBuildError("field '{}' expect type int", name));
+  }
+
+  return value->Integer();
 }
 
 }  // namespace jk::utils
@@ -3,15 +3,15 @@
 
 #pragma once  // NOLINT(build/header_guard)
 
-#include <list>
+#include <cstdint>
+#include <memory>
 #include <optional>
+#include <span>
 #include <string>
 #include <string_view>
-#include <unordered_map>
-#include <variant>
+#include <utility>
 #include <vector>
 
-#include "absl/container/flat_hash_map.h"
 #include "jk/core/error.h"
 #include "jk/utils/cpp_features.hh"
 #include "jk/utils/str.hh"
@@ -23,69 +23,136 @@ class ScriptInterpreter;
 
 namespace jk::utils {
 
-struct KwargsValue {
-  using Ptr      = std::shared_ptr<KwargsValue>;
-  using MapType  = absl::flat_hash_map<std::string, Ptr>;
-  using ListType = std::vector<Ptr>;
+//! Arguments of a rule-function in BUILD.
+//!
+//! All values are stored flat: strings are copied into a chunked arena once
+//! and referenced by `std::string_view`, and every value is a node in one
+//! vector. Children of a list or dict are contiguous nodes, dict children
+//! alternate between key and value. Direct string elements of a list are
+//! interned first, so their views are contiguous and a list of strings can
+//! be returned as a span without copying.
+//!
+//! All returned views and spans are valid until `Release` is called or the
+//! object is destroyed.
+class Kwargs final : public Stringifiable {
+ public:
+  enum class ValueKind : uint8_t {
+    kString,
+    kList,
+    kDict,
+    kBoolean,
+    kInteger,
+  };
 
-  KwargsValue(const KwargsValue &) = default;
-  KwargsValue(KwargsValue &&)      = default;
-  KwargsValue(Ptr ptr) : value(ptr->value) {
-  }
+  //! A reference to one value in `Kwargs`
+  class Value {
+   public:
+    ValueKind Kind() const;
 
-  KwargsValue(const pybind11::handle &object);
+    //! Throws if the value is not a string
+    std::string_view String() const;
 
-  std::string to_string() const;
+    //! Throws if the value is not a boolean
+    bool Boolean() const;
 
-  std::variant<std::string, ListType, MapType, bool> value;
-};
+    //! Throws if the value is not an integer
+    int64_t Integer() const;
 
-class Kwargs final : public Stringifiable {
- public:
-  using ListType   = std::vector<KwargsValue>;
-  using StringType = std::string;
-  using MapType    = absl::flat_hash_map<std::string, KwargsValue>;
+    //! Number of elements of a list, or number of items of a dict
+    uint32_t Size() const;
+
+    //! Returns the `i`-th element of a list
+    Value At(uint32_t i) const;
+
+    //! Returns the `i`-th (key, value) item of a dict
+    std::pair<std::string_view, Value> Item(uint32_t i) const;
+
+    //! Returns all elements of a list, if it's a list of strings
+    std::optional<std::span<const std::string_view>> Strings() const;
+
+    std::string ToString() const;
+
+   private:
+    friend class Kwargs;
+
+    Value(const Kwargs *owner, uint32_t index) : owner_(owner), index_(index) {
+    }
+
+    const Kwargs *owner_;
+    uint32_t index_;
+  };
+
+  Kwargs();
 
   Kwargs(const pybind11::kwargs &args);
 
-  Kwargs(const Kwargs &) = default;
-  Kwargs(Kwargs &&)      = default;
+  Kwargs(const Kwargs &)            = delete;
+  Kwargs &operator=(const Kwargs &) = delete;
+  Kwargs(Kwargs &&)                 = default;
+  Kwargs &operator=(Kwargs &&)      = default;
 
-  StringType StringRequired(const std::string &name) const;
+  std::string_view StringRequired(std::string_view name) const;
 
-  std::vector<std::string> ListRequired(const std::string &name) const;
+  std::string_view StringOptional(
+      std::string_view name,
+      std::optional<std::string_view> default_value) const;
 
-  StringType StringOptional(const std::string &name,
-                            std::optional<StringType> default_value) const;
+  std::span<const std::string_view> ListRequired(std::string_view name) const;
 
-  std::vector<std::string> ListOptional(
-      const std::string &name,
-      std::optional<std::vector<std::string> > default_value) const;
+  std::span<const std::string_view> ListOptional(
+      std::string_view name,
+      std::span<const std::string_view> default_value = {}) const;
 
-  bool BooleanRequired(const std::string &name) const;
+  bool BooleanRequired(std::string_view name) const;
 
-  bool BooleanOptional(const std::string &name,
+  bool BooleanOptional(std::string_view name,
                        std::optional<bool> default_value) const;
 
-  std::string gen_stringify_cache() const final;
+  int64_t IntegerOptional(std::string_view name,
+                          std::optional<int64_t> default_value) const;
 
-  template<typename T>
-  auto Find(T &&key) const {
-    return value_.find(std::forward<T>(key));
-  }
+  std::optional<Value> Find(std::string_view name) const;
 
-  auto Begin() const {
-    return value_.begin();
-  }
+  //! Frees all storage. Fields should have been extracted before, all views
+  //! and spans returned before are invalid after it.
+  void Release();
 
-  auto End() const {
-    return value_.end();
-  }
+  std::string gen_stringify_cache() const final;
 
   friend class ::jk::core::executor::ScriptInterpreter;
 
  private:
-  absl::flat_hash_map<std::string, KwargsValue> value_;
+  struct Node {
+    ValueKind Kind;
+    //! Number of children of list or dict
+    uint32_t Size = 0;
+    //! string: index in `views_`; list, dict: index of the first child;
+    //! boolean, integer: the value
+    int64_t Data = 0;
+  };
+
+  //! Fills node `index` from a python object
+  void fill(uint32_t index, const pybind11::handle &object);
+
+  //! Fills node `index` if `object` is a string, returns false otherwise
+  bool fill_string(uint32_t index, const pybind11::handle &object);
+
+  //! Copies `s` into the arena
+  std::string_view intern(std::string_view s);
+
+  const Node &node(uint32_t index) const {
+    return values_[index];
+  }
+
+  static constexpr size_t kChunkSize = 1024;
+
+  std::vector<std::unique_ptr<char[]>> arena_;
+  size_t arena_used_     = 0;
+  size_t arena_capacity_ = 0;
+
+  std::vector<std::string_view> views_;
+  //! `values_[0]` is the dict of all arguments
+  std::vector<Node> values_;
 };
 
 }  // namespace jk::utils
@@ -30,7 +30,7 @@ bool StringEndsWith(std::string_view full_string,  // {{{
 bool StringStartsWith(std::string_view full_string,  // {{{
                       std::string_view prefix) {
   if (full_string.length() >= prefix.length()) {
-    return full_string.substr(prefix.length()) == prefix;
+    return full_string.substr(0, prefix.length()) == prefix;
   } else {
     return false;
   }
@@ -57,9 +57,9 @@ bool EqualIgnoreCase(std::string_view lhs, std::string_view rhs) {  // {{{
     if (std::tolower(lhs[i]) == std::tolower(rhs[i])) {
       continue;
     }
-    return true;
+    return false;
   }
-  return false;
+  return true;
 }  // }}}
 
 void ReplaceAllSlow(std::string *text, std::string_view from,  // {{{
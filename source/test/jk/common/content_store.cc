@@ -0,0 +1,143 @@
+// Copyright (c) 2020 - present, Hawtian Wang (twistoy.wang@gmail.com)
+//
+
+#include "jk/common/content_store.hh"
+
+#include <catch.hpp>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+
+namespace jk::common::testing {
+
+namespace fs = std::filesystem;
+
+static std::string read_file(const fs::path &p) {
+  std::ifstream ifs(p);
+  return {std::istreambuf_iterator<char>{ifs},
+          std::istreambuf_iterator<char>{}};
+}
+
+TEST_CASE("ContentStoreTest", "[common][content_store]") {
+  auto temp_folder = fs::path("/tmp") / "jk-test" / "content_store";
+  fs::remove_all(temp_folder);
+  fs::create_directories(temp_folder);
+
+  auto object = temp_folder / "a.o";
+  std::ofstream(object) << "object";
+
+  SECTION("store and restore") {
+    ContentStore store(temp_folder / "store", 1024 * 1024);
+    store.Store("1234", {{"object", object}});
+
+    auto restored = temp_folder / "out" / "b.o";
+    REQUIRE(store.Restore("1234", {{"object", restored}}));
+    REQUIRE(read_file(restored) == "object");
+
+    REQUIRE_FALSE(store.Restore("5678", {{"object", restored}}));
+    REQUIRE_FALSE(store.Restore("1234", {{"depfile", restored}}));
+  }
+
+  SECTION("link placement") {
+    ContentStore store(temp_folder / "store", 1024 * 1024,
+                       ContentStore::Placement::Link);
+    auto lock = store.Lock("1234");
+    store.Store("1234", {{"object", object}});
+
+    auto restored = temp_folder / "out" / "b.o";
+    REQUIRE(store.Restore("1234", {{"object", restored}}));
+    REQUIRE(read_file(restored) == "object");
+    REQUIRE(fs::equivalent(restored, temp_folder / "store" / "12" / "1234" /
+                                         "object"));
+
+    // shared with the workspace, so nobody modifies it in place
+    auto perms = fs::status(restored).permissions();
+    REQUIRE((perms & fs::perms::owner_write) == fs::perms::none);
+    REQUIRE((perms & fs::perms::owner_read) != fs::perms::none);
+
+    // lock files are not entries, held ones are kept
+    store.Evict();
+    REQUIRE(fs::exists(temp_folder / "store" / "12" / "1234"));
+    REQUIRE(fs::exists(temp_folder / "store" / "locks" / "1234.lock"));
+  }
+
+  SECTION("remove") {
+    ContentStore store(temp_folder / "store", 1024 * 1024);
+    store.Store("1234", {{"object", object}});
+    store.Store("5678", {{"object", object}});
+    REQUIRE(read_file(temp_folder / "store" / "size") == "8192");
+
+    store.Remove("1234");
+    REQUIRE_FALSE(store.Restore("1234", {{"object", temp_folder / "b.o"}}));
+    REQUIRE(read_file(temp_folder / "store" / "size") == "4096");
+    store.Remove("1234");
+    REQUIRE(read_file(temp_folder / "store" / "size") == "4096");
+  }
+
+  SECTION("unused locks") {
+    ContentStore store(temp_folder / "store", 1024);
+    store.Lock("1234");
+    auto held = store.Lock("5678");
+
+    store.Evict();
+    REQUIRE_FALSE(fs::exists(temp_folder / "store" / "locks" / "1234.lock"));
+    REQUIRE(fs::exists(temp_folder / "store" / "locks" / "5678.lock"));
+
+    // locks again after its file was removed
+    auto lock = store.Lock("1234");
+    REQUIRE(fs::exists(temp_folder / "store" / "locks" / "1234.lock"));
+  }
+
+  SECTION("evict least recently used") {
+    // two entries of a block each don't fit
+    ContentStore store(temp_folder / "store", 6000);
+    store.Store("1234", {{"object", object}});
+    REQUIRE(fs::exists(temp_folder / "store" / "12" / "1234"));
+
+    fs::last_write_time(temp_folder / "store" / "12" / "1234",
+                        fs::file_time_type::clock::now() -
+                            std::chrono::hours(1));
+    // counted size exceeds the limit, evicts on this write
+    store.Store("5678", {{"object", object}});
+
+    REQUIRE_FALSE(fs::exists(temp_folder / "store" / "12" / "1234"));
+    REQUIRE(fs::exists(temp_folder / "store" / "56" / "5678"));
+    REQUIRE(read_file(temp_folder / "store" / "size") == "4096");
+  }
+
+  SECTION("size counter") {
+    ContentStore store(temp_folder / "store", 1024 * 1024);
+    store.Store("1234", {{"object", object}, {"diagnostics", object}});
+    store.Store("1234", {{"object", object}});
+    // an entry counts at least a block
+    REQUIRE(read_file(temp_folder / "store" / "size") == "4096");
+
+    // shared by all writers of the store
+    ContentStore other(temp_folder / "store", 1024 * 1024);
+    other.Store("5678", {{"object", object}});
+    REQUIRE(read_file(temp_folder / "store" / "size") == "8192");
+
+    // eviction resyncs it with the real size
+    fs::remove_all(temp_folder / "store" / "56");
+    store.Evict();
+    REQUIRE(read_file(temp_folder / "store" / "size") == "4096");
+  }
+
+  SECTION("empty entries are evicted") {
+    // like the lint cache, existence of an entry is all it stores
+    ContentStore store(temp_folder / "store", 6000);
+    store.Store("1234", {});
+    REQUIRE(read_file(temp_folder / "store" / "size") == "4096");
+
+    fs::last_write_time(temp_folder / "store" / "12" / "1234",
+                        fs::file_time_type::clock::now() -
+                            std::chrono::hours(1));
+    store.Store("5678", {});
+    REQUIRE_FALSE(store.Restore("1234", {}));
+    REQUIRE(store.Restore("5678", {}));
+  }
+}
+
+}  // namespace jk::common::testing
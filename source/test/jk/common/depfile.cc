@@ -0,0 +1,77 @@
+// Copyright (c) 2020 - present, Hawtian Wang (twistoy.wang@gmail.com)
+//
+
+#include "jk/common/depfile.hh"
+
+#include <catch.hpp>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+namespace jk::common::testing {
+
+namespace fs = std::filesystem;
+
+TEST_CASE("DepfileTest", "[common][depfile]") {
+  SECTION("parse") {
+    auto deps = ParseDepfile(
+        "a/x.cc.o: a/x.cc a/x.h \\\n"
+        "  a/my\\ file.h\n"
+        "\n"
+        "a/x.h:\n"
+        "\n"
+        "a/my\\ file.h:\n");
+    REQUIRE(deps.size() == 1);
+    REQUIRE(deps["a/x.cc.o"] ==
+            std::vector<std::string>{"a/x.cc", "a/x.h", "a/my\\ file.h"});
+  }
+
+  SECTION("format and parse back") {
+    DependencyMap deps{{"x.o", {"x.cc", "c.h"}}, {"y.o", {"y.cc", "c.h"}}};
+    auto content = FormatDependencies(deps);
+    REQUIRE(content.find("c.h:\n") != std::string::npos);
+    REQUIRE(ParseDepfile(content) == deps);
+  }
+
+  SECTION("compact") {
+    auto temp_folder = fs::path("/tmp") / "jk-test" / "depfile";
+    fs::remove_all(temp_folder);
+    fs::create_directories(temp_folder);
+    auto log = temp_folder / "debug" / "deps.make";
+
+    auto read = [](const fs::path &p) {
+      std::ifstream ifs(p);
+      return std::string{std::istreambuf_iterator<char>{ifs},
+                         std::istreambuf_iterator<char>{}};
+    };
+
+    // nothing to merge, an empty log is still written for make to include
+    CompactDepsLog(log);
+    REQUIRE(fs::exists(log));
+    REQUIRE(read(log).empty());
+
+    // depfiles appended by compile commands, as `cat x.d >> journal`
+    auto append = [&](const std::string &content) {
+      std::ofstream ofs(DepsJournalFile(log), std::ios::app);
+      ofs << content;
+    };
+    append("x.o: x.cc a.h\n");
+    append("y.o: y.cc\n");
+
+    CompactDepsLog(log);
+    REQUIRE_FALSE(fs::exists(DepsJournalFile(log)));
+    REQUIRE(ParseDepfile(read(log)) ==
+            DependencyMap{{"x.o", {"x.cc", "a.h"}}, {"y.o", {"y.cc"}}});
+
+    // later rules of a target replace earlier ones
+    append("x.o: x.cc b.h\n");
+    append("x.o: x.cc c.h\n");
+    CompactDepsLog(log);
+    REQUIRE(ParseDepfile(read(log)) ==
+            DependencyMap{{"x.o", {"x.cc", "c.h"}}, {"y.o", {"y.cc"}}});
+  }
+}
+
+}  // namespace jk::common::testing
@@ -0,0 +1,252 @@
+// Copyright (c) 2020 - present, Hawtian Wang (twistoy.wang@gmail.com)
+//
+
+#include "jk/common/download.hh"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <catch.hpp>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "jk/core/error.h"
+#include "jk/utils/digest.hh"
+
+namespace jk::common::testing {
+
+namespace fs = std::filesystem;
+
+//! A minimal HTTP/1.0 server of one file, serves connections one by one.
+class FileServer {
+ public:
+  explicit FileServer(std::string content, bool ranges = true)
+      : content_(std::move(content)), ranges_(ranges) {
+    fd_ = ::socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr{};
+    addr.sin_family      = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    ::bind(fd_, reinterpret_cast<sockaddr *>(&addr), sizeof(addr));
+    ::listen(fd_, 16);
+
+    socklen_t len = sizeof(addr);
+    ::getsockname(fd_, reinterpret_cast<sockaddr *>(&addr), &len);
+    port_ = ntohs(addr.sin_port);
+
+    thread_ = std::thread([this] {
+      serve();
+    });
+  }
+
+  ~FileServer() {
+    stop_ = true;
+    ::shutdown(fd_, SHUT_RDWR);
+    ::close(fd_);
+    thread_.join();
+  }
+
+  std::string Url() const {
+    return "http://127.0.0.1:" + std::to_string(port_) + "/file.tar.gz";
+  }
+
+  //! Next `count` GET responses are cut after `bytes` bytes of body.
+  void DropAfter(size_t bytes, uint32_t count) {
+    std::lock_guard lk(mutex_);
+    drop_bytes_ = bytes;
+    drop_count_ = count;
+  }
+
+  //! Starts of all requested ranges, 0 for requests without range.
+  std::vector<uint64_t> RangeStarts() const {
+    std::lock_guard lk(mutex_);
+    return range_starts_;
+  }
+
+ private:
+  void serve() {
+    while (!stop_) {
+      int conn = ::accept(fd_, nullptr, nullptr);
+      if (conn < 0) {
+        continue;
+      }
+      handle(conn);
+      ::close(conn);
+    }
+  }
+
+  void handle(int conn) {
+    std::string request;
+    char buf[4096];
+    while (request.find("\r\n\r\n") == std::string::npos) {
+      auto n = ::recv(conn, buf, sizeof(buf), 0);
+      if (n <= 0) {
+        return;
+      }
+      request.append(buf, n);
+    }
+
+    bool head = request.starts_with("HEAD");
+    uint64_t begin = 0, end = content_.size() - 1;
+    bool ranged = false;
+    if (auto pos = request.find("Range: bytes="); ranges_ && pos != npos) {
+      std::sscanf(request.c_str() + pos, "Range: bytes=%lu-%lu", &begin, &end);
+      ranged = true;
+    }
+
+    size_t limit = content_.size();
+    {
+      std::lock_guard lk(mutex_);
+      if (!head) {
+        range_starts_.push_back(begin);
+        if (drop_count_ > 0) {
+          drop_count_--;
+          limit = drop_bytes_;
+        }
+      }
+    }
+
+    auto length = end - begin + 1;
+    std::string header =
+        ranged ? "HTTP/1.0 206 Partial Content\r\n" : "HTTP/1.0 200 OK\r\n";
+    header += "Content-Length: " + std::to_string(length) + "\r\n";
+    header += "ETag: \"v1\"\r\n";
+    if (ranges_) {
+      header += "Accept-Ranges: bytes\r\n";
+    }
+    header += "\r\n";
+    send_all(conn, header);
+    if (!head) {
+      send_all(conn, std::string_view{content_}.substr(
+                         begin, std::min<uint64_t>(length, limit)));
+    }
+  }
+
+  static void send_all(int conn, std::string_view data) {
+    while (!data.empty()) {
+      auto n = ::send(conn, data.data(), data.size(), MSG_NOSIGNAL);
+      if (n <= 0) {
+        return;
+      }
+      data.remove_prefix(n);
+    }
+  }
+
+  static constexpr auto npos = std::string::npos;
+
+  std::string content_;
+  bool ranges_;
+  int fd_;
+  uint16_t port_;
+  std::thread thread_;
+  std::atomic<bool> stop_{false};
+
+  mutable std::mutex mutex_;
+  size_t drop_bytes_   = 0;
+  uint32_t drop_count_ = 0;
+  std::vector<uint64_t> range_starts_;
+};
+
+static std::string read_file(const fs::path &p) {
+  std::ifstream ifs(p, std::ios::binary);
+  return {std::istreambuf_iterator<char>{ifs},
+          std::istreambuf_iterator<char>{}};
+}
+
+static std::string make_content(size_t size) {
+  std::string res;
+  res.reserve(size);
+  for (size_t i = 0; i < size; i++) {
+    res.push_back(static_cast<char>(i * 7 + i / 251));
+  }
+  return res;
+}
+
+TEST_CASE("DownloadTest", "[common][download]") {
+  auto temp_folder = fs::path("/tmp") / "jk-test" / "download";
+  fs::remove_all(temp_folder);
+  fs::create_directories(temp_folder);
+
+  auto content = make_content(1024 * 1024);
+  auto output  = temp_folder / "file.tar.gz";
+
+  DownloadOptions options;
+  options.MinSegmentSize = 64 * 1024;
+  options.Connections    = 4;
+
+  SECTION("parallel segments") {
+    FileServer server(content);
+    options.Expected = Checksum::Parse(
+        "sha512:" + utils::Digest("sha512").Update(content).HexDigest());
+    Download(server.Url(), output, options);
+
+    REQUIRE(read_file(output) == content);
+    REQUIRE(server.RangeStarts().size() == 4);
+    REQUIRE_FALSE(fs::exists(temp_folder / "file.tar.gz.part"));
+    REQUIRE_FALSE(fs::exists(temp_folder / "file.tar.gz.part.state"));
+  }
+
+  SECTION("server without ranges") {
+    FileServer server(content, false);
+    Download(server.Url(), output, options);
+
+    REQUIRE(read_file(output) == content);
+    REQUIRE(server.RangeStarts() == std::vector<uint64_t>{0});
+  }
+
+  SECTION("retry dropped segments from where it stopped") {
+    FileServer server(content);
+    server.DropAfter(1000, 1);
+    options.Expected =
+        Checksum::Parse(utils::Digest().Update(content).HexDigest());
+    Download(server.Url(), output, options);
+
+    REQUIRE(read_file(output) == content);
+    auto starts = server.RangeStarts();
+    REQUIRE(starts.size() == 5);
+    REQUIRE(std::find(starts.begin(), starts.end(), 1000) != starts.end());
+  }
+
+  SECTION("resume interrupted download") {
+    FileServer server(content);
+    server.DropAfter(1000, 4);
+    options.Retries  = 0;
+    options.Expected = Checksum::Parse(
+        "blake2b512:" +
+        utils::Digest("blake2b512").Update(content).HexDigest());
+    REQUIRE_THROWS_AS(Download(server.Url(), output, options),
+                      core::JKBuildError);
+    REQUIRE_FALSE(fs::exists(output));
+    REQUIRE(fs::exists(temp_folder / "file.tar.gz.part.state"));
+
+    Download(server.Url(), output, options);
+    REQUIRE(read_file(output) == content);
+    auto starts = server.RangeStarts();
+    REQUIRE(std::count(starts.begin(), starts.end(), 0) == 1);
+  }
+
+  SECTION("sha256 mismatch") {
+    FileServer server(content);
+    options.Expected = Checksum::Parse(std::string(64, '0'));
+    REQUIRE_THROWS_AS(Download(server.Url(), output, options),
+                      core::JKBuildError);
+    REQUIRE_FALSE(fs::exists(output));
+    REQUIRE_FALSE(fs::exists(temp_folder / "file.tar.gz.part"));
+  }
+
+  SECTION("unsupported checksum") {
+    REQUIRE_THROWS_AS(Checksum::Parse("blake3:1234"), core::JKBuildError);
+  }
+}
+
+}  // namespace jk::common::testing
@@ -0,0 +1,151 @@
+// Copyright (c) 2020 - present, Hawtian Wang (twistoy.wang@gmail.com)
+//
+
+#include "jk/common/lint.hh"
+
+#include <catch.hpp>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace jk::common::testing {
+
+namespace fs = std::filesystem;
+
+TEST_CASE("LintTest", "[common][lint]") {
+  auto temp_folder = fs::path("/tmp") / "jk-test" / "lint";
+  fs::remove_all(temp_folder);
+  fs::create_directories(temp_folder);
+
+  std::vector<std::string> files;
+  for (int i = 0; i < 5; i++) {
+    auto file = temp_folder / ("f" + std::to_string(i) + ".cc");
+    std::ofstream(file) << "int f" << i << "();\n";
+    files.push_back(file.string());
+  }
+
+  SECTION("batching") {
+    auto batches = MakeLintBatches(files, "cpplint", nullptr, 2);
+    REQUIRE(batches.size() == 3);
+    REQUIRE(batches[0].Files == std::vector<std::string>{files[0], files[1]});
+    REQUIRE(batches[1].Files == std::vector<std::string>{files[2], files[3]});
+    REQUIRE(batches[2].Files == std::vector<std::string>{files[4]});
+    for (const auto &batch : batches) {
+      REQUIRE(batch.Keys.size() == batch.Files.size());
+    }
+
+    // unreadable files are still linted, but never cached
+    auto missing = MakeLintBatches({(temp_folder / "missing.cc").string(), ""},
+                                   "cpplint", nullptr, 2);
+    REQUIRE(missing.size() == 1);
+    REQUIRE(missing[0].Files.size() == 1);
+    REQUIRE(missing[0].Keys[0].empty());
+  }
+
+  SECTION("cache key") {
+    auto key = LintCacheKey("cpplint", files[0]);
+    REQUIRE(key);
+    REQUIRE(key == LintCacheKey("cpplint", files[0]));
+    REQUIRE(key != LintCacheKey("cpplint.py", files[0]));
+    REQUIRE(key != LintCacheKey("cpplint", files[1]));
+
+    std::ofstream(files[0]) << "int g();\n";
+    REQUIRE(key != LintCacheKey("cpplint", files[0]));
+  }
+
+  SECTION("linter identity") {
+    auto linter = temp_folder / "cpplint.py";
+    std::ofstream(linter) << "# cpplint\n";
+    auto identity = LinterIdentity(linter.string());
+    REQUIRE(identity == LinterIdentity(linter.string()));
+
+    // an upgraded linter lints everything again
+    std::ofstream(linter) << "# cpplint, a newer version\n";
+    REQUIRE(identity != LinterIdentity(linter.string()));
+    REQUIRE(LintCacheKey(identity, files[0]) !=
+            LintCacheKey(LinterIdentity(linter.string()), files[0]));
+  }
+
+  SECTION("configs") {
+    auto key = LintCacheKey("cpplint", files[0]);
+
+    std::ofstream(temp_folder / "CPPLINT.cfg") << "linelength=100\n";
+    auto with_config = LintCacheKey("cpplint", files[0]);
+    REQUIRE(key != with_config);
+
+    // configs of parent directories apply too
+    std::ofstream(temp_folder.parent_path() / "CPPLINT.cfg")
+        << "filter=-build/c++11\n";
+    auto with_parent = LintCacheKey("cpplint", files[0]);
+    REQUIRE(with_config != with_parent);
+
+    // unless stopped by `set noparent`
+    std::ofstream(temp_folder / "CPPLINT.cfg")
+        << "set noparent\nlinelength=100\n";
+    auto no_parent = LintCacheKey("cpplint", files[0]);
+    std::ofstream(temp_folder.parent_path() / "CPPLINT.cfg")
+        << "filter=-whitespace\n";
+    REQUIRE(no_parent == LintCacheKey("cpplint", files[0]));
+
+    fs::remove(temp_folder.parent_path() / "CPPLINT.cfg");
+  }
+
+  SECTION("cache skip") {
+    ContentStore store(temp_folder / "cache", 1024 * 1024);
+
+    auto batches = MakeLintBatches(files, "cpplint", &store, 64);
+    REQUIRE(batches.size() == 1);
+    StoreLintResults(batches[0], 0, store);
+
+    REQUIRE(MakeLintBatches(files, "cpplint", &store, 64).empty());
+
+    // changed contents are linted again
+    std::ofstream(files[3]) << "int g();\n";
+    auto again = MakeLintBatches(files, "cpplint", &store, 64);
+    REQUIRE(again.size() == 1);
+    REQUIRE(again[0].Files == std::vector<std::string>{files[3]});
+
+    // so is everything if the linter changed
+    REQUIRE(MakeLintBatches(files, "cpplint.py", &store, 64)[0].Files ==
+            files);
+  }
+
+  SECTION("failure attribution") {
+    ContentStore store(temp_folder / "cache", 1024 * 1024);
+
+    auto batches = MakeLintBatches(files, "cpplint", &store, 64);
+    REQUIRE(batches.size() == 1);
+    auto &batch   = batches[0];
+    batch.LogFile = temp_folder / "0.log";
+    {
+      std::ofstream ofs(batch.LogFile);
+      ofs << files[1] << ":3:  Missing space  [whitespace/comma] [3]\n";
+      // a prefix of another file is not the file
+      ofs << files[2] << "x:1:  foo [build/include] [4]\n";
+      ofs << "Total errors found: 1\n";
+    }
+
+    auto failed = LintFailedFiles(batch);
+    REQUIRE(failed.size() == 1);
+    REQUIRE(failed.contains(files[1]));
+
+    StoreLintResults(batch, 1, store);
+    auto again = MakeLintBatches(files, "cpplint", &store, 64);
+    REQUIRE(again.size() == 1);
+    REQUIRE(again[0].Files == std::vector<std::string>{files[1]});
+  }
+
+  SECTION("crashed linter caches nothing") {
+    ContentStore store(temp_folder / "cache", 1024 * 1024);
+
+    auto batches       = MakeLintBatches(files, "cpplint", &store, 64);
+    batches[0].LogFile = temp_folder / "0.log";
+    std::ofstream(batches[0].LogFile) << "Traceback:\n";
+
+    StoreLintResults(batches[0], 1, store);
+    REQUIRE(MakeLintBatches(files, "cpplint", &store, 64)[0].Files == files);
+  }
+}
+
+}  // namespace jk::common::testing
@@ -0,0 +1,77 @@
+// Copyright (c) 2020 - present, Hawtian Wang (twistoy.wang@gmail.com)
+//
+
+#include "jk/common/process.hh"
+
+#include <catch.hpp>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <thread>
+
+namespace jk::common::testing {
+
+namespace fs = std::filesystem;
+
+static std::string read_file(const fs::path &p) {
+  std::ifstream ifs(p);
+  return {std::istreambuf_iterator<char>{ifs},
+          std::istreambuf_iterator<char>{}};
+}
+
+TEST_CASE("RunProcessTest", "[common][process]") {
+  auto temp_folder = fs::path("/tmp") / "jk-test" / "process";
+  fs::remove_all(temp_folder);
+  fs::create_directories(temp_folder);
+
+  SECTION("env and log file") {
+    ProcessOptions options;
+    options.Env     = {{"JK_TEST_VALUE", "42"}};
+    options.LogFile = temp_folder / "out.log";
+
+    auto res = RunProcess(
+        {"/bin/sh", "-c", "echo $JK_TEST_VALUE; echo err >&2; exit 3"},
+        options);
+    REQUIRE(res.ExitCode == 3);
+    REQUIRE_FALSE(res.TimedOut);
+    REQUIRE(read_file(temp_folder / "out.log") == "42\nerr\n");
+  }
+
+  SECTION("timeout") {
+    ProcessOptions options;
+    options.Timeout = std::chrono::milliseconds(100);
+
+    auto res = RunProcess({"/bin/sh", "-c", "sleep 10"}, options);
+    REQUIRE(res.TimedOut);
+    REQUIRE(res.Elapsed < std::chrono::seconds(5));
+  }
+
+  SECTION("timeout kills grandchildren") {
+    ProcessOptions options;
+    options.Timeout = std::chrono::milliseconds(200);
+
+    auto pid_file = temp_folder / "pid";
+    auto res      = RunProcess(
+        {"/bin/sh", "-c",
+         "sleep 10 & echo $! > " + pid_file.string() + "; wait"},
+        options);
+    REQUIRE(res.TimedOut);
+
+    // killed, maybe not reaped yet by whoever adopted it
+    auto pid   = read_file(pid_file);
+    auto stat  = fs::path("/proc") / pid.substr(0, pid.find('\n')) / "stat";
+    auto alive = [&stat]() {
+      auto content = read_file(stat);
+      auto state   = content.find(") ");
+      return state != std::string::npos && content[state + 2] != 'Z';
+    };
+    for (int i = 0; i < 100 && alive(); i++) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    REQUIRE_FALSE(alive());
+  }
+}
+
+}  // namespace jk::common::testing
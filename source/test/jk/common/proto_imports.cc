@@ -0,0 +1,85 @@
+// Copyright (c) 2020 - present, Hawtian Wang (twistoy.wang@gmail.com)
+//
+
+#include "jk/common/proto_imports.hh"
+
+#include <catch.hpp>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+namespace jk::common::testing {
+
+namespace fs = std::filesystem;
+
+TEST_CASE("ScanProtoImportsTest", "[common][proto_imports]") {
+  auto content = R"(
+syntax = "proto3";
+// import "commented.proto";
+/* import "block/commented.proto"; */
+import "a/b.proto";
+import public 'c.proto';
+import weak "d.proto";
+
+message Foo {
+  string import = 1;
+}
+)";
+
+  REQUIRE(ScanProtoImports(content) ==
+          std::vector<std::string>{"a/b.proto", "c.proto", "d.proto"});
+}
+
+TEST_CASE("ProtoImportScannerTest", "[common][proto_imports]") {
+  auto root = fs::path("/tmp") / "jk-test" / "proto_imports";
+  fs::remove_all(root);
+  fs::create_directories(root / "p");
+
+  std::ofstream(root / "p" / "a.proto") << R"(import "p/b.proto";)";
+  std::ofstream(root / "p" / "b.proto")
+      << R"(import "p/c.proto"; import "google/protobuf/any.proto";)";
+  std::ofstream(root / "p" / "c.proto") << R"(import "p/a.proto";)";
+
+  ProtoImportScanner scanner;
+  REQUIRE(scanner.TransitiveImports(root, root / "p" / "b.proto") ==
+          std::vector<std::string>{(root / "p" / "a.proto").string(),
+                                   (root / "p" / "c.proto").string()});
+  REQUIRE(scanner.TransitiveImports(root, root / "p" / "a.proto") ==
+          std::vector<std::string>{(root / "p" / "b.proto").string(),
+                                   (root / "p" / "c.proto").string()});
+  REQUIRE(scanner.TransitiveImports(
+              root, std::vector<fs::path>{root / "p" / "a.proto",
+                                          root / "p" / "b.proto"}) ==
+          std::vector<std::string>{(root / "p" / "a.proto").string(),
+                                   (root / "p" / "b.proto").string(),
+                                   (root / "p" / "c.proto").string()});
+}
+
+TEST_CASE("WriteProtoImportsFragmentTest", "[common][proto_imports]") {
+  auto root = fs::path("/tmp") / "jk-test" / "proto_imports_fragment";
+  fs::remove_all(root);
+  auto output = root / "imports.make";
+
+  auto read = [&]() {
+    std::ifstream ifs(output);
+    return std::string{std::istreambuf_iterator<char>{ifs},
+                       std::istreambuf_iterator<char>{}};
+  };
+
+  WriteProtoImportsFragment(output, {"/a.proto", "/b.proto"});
+  REQUIRE(read() == ProtoImportsFragment({"/a.proto", "/b.proto"}));
+  REQUIRE(read().find("PROTO_IMPORTS := /a.proto /b.proto\n") !=
+          std::string::npos);
+
+  SECTION("touched if unchanged") {
+    auto old = fs::file_time_type::clock::now() - std::chrono::hours(1);
+    fs::last_write_time(output, old);
+    WriteProtoImportsFragment(output, {"/a.proto", "/b.proto"});
+    REQUIRE(fs::last_write_time(output) > old);
+  }
+}
+
+}  // namespace jk::common::testing
@@ -0,0 +1,68 @@
+// Copyright (c) 2020 - present, Hawtian Wang (twistoy.wang@gmail.com)
+//
+
+#include "jk/common/version_stamp.hh"
+
+#include <catch.hpp>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+
+namespace jk::common::testing {
+
+namespace fs = std::filesystem;
+
+static std::string read_file(const fs::path &p) {
+  std::ifstream ifs(p);
+  return {std::istreambuf_iterator<char>{ifs},
+          std::istreambuf_iterator<char>{}};
+}
+
+TEST_CASE("GitDescFragmentTest", "[common][version_stamp]") {
+  auto temp_folder = fs::path("/tmp") / "jk-test" / "version_stamp";
+  fs::remove_all(temp_folder);
+  auto fragment = temp_folder / "git_desc" / "git_desc.make";
+
+  SECTION("command line define") {
+    auto content = GitDescFragment("v1.0-3-gabcdef");
+    REQUIRE(content.find(R"(GIT_DESC := -DGIT_DESC="\"v1.0-3-gabcdef\"")") !=
+            std::string::npos);
+  }
+
+  SECTION("escaped for c, shell and make") {
+    auto content = GitDescFragment(R"(v"$#)");
+    REQUIRE(content.find(R"(-DGIT_DESC="\"v\\\"\$$\#\"")") !=
+            std::string::npos);
+  }
+
+  SECTION("written only if changed") {
+    REQUIRE(WriteGitDescFragment(fragment, "v1.0"));
+    REQUIRE(read_file(fragment) == GitDescFragment("v1.0"));
+    REQUIRE_FALSE(WriteGitDescFragment(fragment, "v1.0"));
+
+    REQUIRE(WriteGitDescFragment(fragment, "v1.1"));
+    REQUIRE(read_file(fragment) == GitDescFragment("v1.1"));
+  }
+
+  SECTION("git describe") {
+    fs::create_directories(temp_folder);
+    REQUIRE(GitDescribe(temp_folder).empty());
+  }
+
+  SECTION("find repository") {
+    auto repo      = temp_folder / "repo";
+    auto submodule = repo / "third_party" / "sub";
+    fs::create_directories(repo / ".git");
+    fs::create_directories(submodule / "src");
+    std::ofstream(submodule / ".git") << "gitdir: ../../.git/modules/sub\n";
+    fs::create_directories(repo / "pkg" / "a");
+
+    REQUIRE(FindGitRepository(repo) == repo);
+    REQUIRE(FindGitRepository(repo / "pkg" / "a") == repo);
+    REQUIRE(FindGitRepository(submodule) == submodule);
+    REQUIRE(FindGitRepository(submodule / "src") == submodule);
+  }
+}
+
+}  // namespace jk::common::testing
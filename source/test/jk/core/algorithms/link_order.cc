@@ -0,0 +1,47 @@
+// Copyright (c) 2020 - present, Hawtian Wang (twistoy.wang@gmail.com)
+//
+
+#include "jk/core/algorithms/link_order.hh"
+
+#include <catch.hpp>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "jk/core/algorithms/tarjan.hh"
+#include "jk/core/models/session.hh"
+
+namespace jk::core::algorithms::testing {
+
+TEST_CASE("LinkOrderCacheTest", "[core][algorithms][link_order]") {
+  models::Session session;
+  session.BuildTypes = {"DEBUG", "RELEASE"};
+
+  // 3 -> 1 -> 0, 3 -> 2 -> 0, 4 -> 2
+  std::vector<StronglyConnectedComponent> sccs(5);
+  sccs[1].Deps = {0};
+  sccs[2].Deps = {0};
+  sccs[3].Deps = {1, 2};
+  sccs[4].Deps = {2};
+
+  LinkOrderCache cache;
+  cache.Build(&session, sccs);
+
+  SECTION("dependencies before what they depend on") {
+    auto deps = cache.Dependencies(3);
+    REQUIRE(deps.size() == 3);
+    REQUIRE(deps.back() == 0);
+
+    REQUIRE(cache.Dependencies(4) == std::vector<uint32_t>{2, 0});
+    REQUIRE(cache.Dependencies(0).empty());
+  }
+
+  SECTION("fragments of each build type") {
+    REQUIRE(cache.Get(1, "RELEASE").Arguments ==
+            std::vector<std::string>{"-Wl,--start-group", "-Wl,--end-group"});
+    REQUIRE(cache.Get(1, "RELEASE").Files.empty());
+    REQUIRE_THROWS_AS(cache.Get(1, "PROFILING"), JKBuildError);
+  }
+}
+
+}  // namespace jk::core::algorithms::testing
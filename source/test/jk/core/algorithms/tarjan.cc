@@ -0,0 +1,60 @@
+// Copyright (c) 2020 - present, Hawtian Wang (twistoy.wang@gmail.com)
+//
+
+#include "jk/core/algorithms/tarjan.hh"
+
+#include <algorithm>
+#include <catch.hpp>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "jk/core/algorithms/topological_sort.hh"
+#include "jk/core/models/rule_graph.hh"
+
+namespace jk::core::algorithms::testing {
+
+TEST_CASE("TarjanTest", "[core][algorithms][tarjan]") {
+  SECTION("components are found after their dependencies") {
+    // 0 -> 1 <-> 2 -> 3, 0 -> 3
+    models::RuleGraph graph(4, {{0, 1}, {1, 2}, {2, 1}, {2, 3}, {0, 3}});
+    auto sccs = StronglyConnectedComponents(graph, std::vector<uint32_t>{0});
+
+    REQUIRE(sccs.size() == 3);
+    REQUIRE(sccs[0] == std::vector<uint32_t>{3});
+    std::sort(sccs[1].begin(), sccs[1].end());
+    REQUIRE(sccs[1] == std::vector<uint32_t>{1, 2});
+    REQUIRE(sccs[2] == std::vector<uint32_t>{0});
+  }
+
+  SECTION("long chains don't overflow the stack") {
+    const uint32_t n = 1000000;
+    std::vector<std::pair<uint32_t, uint32_t>> edges;
+    for (uint32_t i = 0; i + 1 < n; i++) {
+      edges.emplace_back(i, i + 1);
+    }
+    edges.emplace_back(n - 1, n / 2);
+    models::RuleGraph graph(n, edges);
+
+    auto sccs = StronglyConnectedComponents(graph, std::vector<uint32_t>{0});
+    REQUIRE(sccs.size() == n / 2 + 1);
+    REQUIRE(sccs[0].size() == n / 2);
+    REQUIRE(sccs.back() == std::vector<uint32_t>{0});
+  }
+}
+
+TEST_CASE("TopologicalLevelsTest", "[core][algorithms][topological_sort]") {
+  // 0 <- 1 <- 3, 0 <- 2 <- 3, 4
+  std::vector<StronglyConnectedComponent> sccs(5);
+  sccs[1].Deps = {0};
+  sccs[2].Deps = {0};
+  sccs[3].Deps = {1, 2};
+
+  auto levels = TopologicalLevels(sccs);
+  REQUIRE(levels.size() == 3);
+  REQUIRE(levels[0] == std::vector<uint32_t>{0, 4});
+  REQUIRE(levels[1] == std::vector<uint32_t>{1, 2});
+  REQUIRE(levels[2] == std::vector<uint32_t>{3});
+}
+
+}  // namespace jk::core::algorithms::testing
@@ -0,0 +1,107 @@
+// Copyright (c) 2020 - present, Hawtian Wang (twistoy.wang@gmail.com)
+//
+
+#include "jk/core/filesystem/configuration.hh"
+
+#include <catch.hpp>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "fmt/format.h"
+#include "jk/core/error.h"
+#include "jk/core/filesystem/project.hh"
+
+namespace jk::core::filesystem::testing {
+
+static Configuration parse(const JKProject &project, const std::string &s) {
+  std::istringstream iss(s);
+  return Configuration(&project, toml::parse(iss, "jk.toml"));
+}
+
+TEST_CASE("ConfigurationTest", "[core][filesystem][configuration]") {
+  JKProject project(common::AbsolutePath{"/tmp/jk-test/configuration"});
+
+  SECTION("linker defaults") {
+    auto config = Configuration(&project, toml::value());
+    REQUIRE(config.linker.empty());
+    REQUIRE(config.linker_threads == 0);
+    // the link pool is opt-in
+    REQUIRE(config.link_jobs < 0);
+    REQUIRE(config.link_job_memory == 4096);
+  }
+
+  SECTION("linker") {
+    auto config = parse(project, R"(
+linker = "lld"
+linker_threads = 4
+link_jobs = 0
+link_job_memory = 8192
+)");
+    REQUIRE(config.linker == "lld");
+    REQUIRE(config.linker_threads == 4);
+    REQUIRE(config.link_jobs == 0);
+    REQUIRE(config.link_job_memory == 8192);
+
+    REQUIRE(parse(project, R"(link_jobs = 2)").link_jobs == 2);
+    REQUIRE_THROWS_AS(parse(project, R"(linker = "ld.foo")"),
+                      core::JKBuildError);
+  }
+
+  SECTION("linker threads need a threaded linker") {
+    REQUIRE_THROWS_AS(parse(project, R"(linker_threads = 4)"),
+                      core::JKBuildError);
+    REQUIRE_THROWS_AS(parse(project, R"(
+linker = "bfd"
+linker_threads = 4
+)"),
+                      core::JKBuildError);
+
+    for (auto linker : {"gold", "lld", "mold"}) {
+      auto config = parse(project, fmt::format(R"(
+linker = "{}"
+linker_threads = 2
+)",
+                                               linker));
+      REQUIRE(config.linker_threads == 2);
+    }
+  }
+
+  SECTION("compile cache size") {
+    REQUIRE(Configuration(&project, toml::value()).compile_cache_max_size ==
+            5120);
+    REQUIRE(parse(project, R"(compile_cache_max_size = 64)")
+                .compile_cache_max_size == 64);
+    // passed to an unsigned flag, a negative size would be a huge limit
+    REQUIRE_THROWS_AS(parse(project, R"(compile_cache_max_size = 0)"),
+                      core::JKBuildError);
+    REQUIRE_THROWS_AS(parse(project, R"(compile_cache_max_size = -1)"),
+                      core::JKBuildError);
+  }
+
+  SECTION("build types") {
+    auto config = parse(project, R"(
+[build_types.release]
+cxxflags_extra = ["-O2"]
+
+[build_types.asan]
+cflags_extra = ["-fsanitize=address"]
+)");
+    REQUIRE(config.build_types.size() == 4);
+    // overrides a builtin type regardless of case
+    REQUIRE(config.BuildType("RELEASE").cxxflags_extra ==
+            std::vector<std::string>{"-O2"});
+    REQUIRE(config.BuildType("RELEASE").cflags_extra ==
+            config.release_cflags_extra);
+    REQUIRE(config.BuildType("ASAN").cflags_extra ==
+            std::vector<std::string>{"-fsanitize=address"});
+
+    REQUIRE_THROWS_AS(parse(project, R"(
+[build_types.asan]
+[build_types.ASAN]
+)"),
+                      core::JKBuildError);
+  }
+}
+
+}  // namespace jk::core::filesystem::testing
@@ -0,0 +1,111 @@
+// Copyright (c) 2020 - present, Hawtian Wang (twistoy.wang@gmail.com)
+//
+
+#include "jk/core/generators/makefile.hh"
+
+#include <catch.hpp>
+#include <string>
+#include <vector>
+
+#include "absl/strings/match.h"
+#include "fmt/format.h"
+#include "range/v3/view/all.hpp"
+#include "range/v3/view/empty.hpp"
+#include "range/v3/view/single.hpp"
+#include "test/jk/core/compile/fake_buffer_writer.hh"
+
+namespace jk::core::generators::testing {
+
+TEST_CASE("MakefileGeneratorTest", "[core][generators][makefile]") {
+  ::jk::test::FakeBufferWriterFactory writer_factory;
+  auto path = common::AbsolutePath{"/tmp/jk-test/build.make"};
+
+  SECTION("wrap prerequisites") {
+    std::vector<std::string> deps;
+    for (auto i = 0; i < 20; i++) {
+      deps.push_back(fmt::format("/tmp/project/src/file_{}.o", i));
+    }
+
+    {
+      Makefile makefile(path, {&writer_factory});
+      makefile.Target("lib.a", ranges::views::all(deps),
+                      ranges::views::empty<builder::CustomCommandLine>);
+    }
+
+    const auto &content = writer_factory.Files[path.Stringify()];
+    REQUIRE_FALSE(
+        absl::StrContains(content, "lib.a: /tmp/project/src/file_1.o\n"));
+    REQUIRE(absl::StrContains(content, "lib.a: /tmp/project/src/file_0.o "
+                                       "/tmp/project/src/file_1.o \\\n\t"));
+  }
+
+  SECTION("prefix and list variables") {
+    {
+      Makefile makefile(path, {&writer_factory});
+      makefile.PrefixVariable("WORKING_FOLDER", "/tmp/project/.build/rule");
+      auto objects = makefile.ListVariable(
+          "DEBUG_OBJECTS",
+          std::vector<std::string>{"/tmp/project/.build/rule/a.o",
+                                   "/tmp/project/.build/rule_b/b.o"});
+      REQUIRE(objects == "$(DEBUG_OBJECTS)");
+
+      makefile.Target("/tmp/project/.build/rule/lib.a",
+                      ranges::views::single(objects),
+                      ranges::views::single(builder::CustomCommandLine::Make(
+                          {"@touch", "/tmp/project/.build/rule/lib.a"})));
+    }
+
+    const auto &content = writer_factory.Files[path.Stringify()];
+    REQUIRE(absl::StrContains(content,
+                              "WORKING_FOLDER = /tmp/project/.build/rule\n"));
+    REQUIRE(absl::StrContains(content,
+                              "DEBUG_OBJECTS = \\\n\t$(WORKING_FOLDER)/a.o "
+                              "\\\n\t/tmp/project/.build/rule_b/b.o\n"));
+    REQUIRE(absl::StrContains(content,
+                              "$(WORKING_FOLDER)/lib.a: $(DEBUG_OBJECTS)\n"
+                              "\t@touch $(WORKING_FOLDER)/lib.a\n"));
+  }
+
+  SECTION("grouped target") {
+    // the shape of protoc outputs: one recipe updates all of them, and runs
+    // again if any of them is missing
+    {
+      Makefile makefile(path, {&writer_factory});
+      makefile.PrefixVariable("WORKING_FOLDER", "/tmp/project/.build/pb");
+      makefile.GroupedTarget(
+          std::vector<std::string>{"/tmp/project/.build/pb/a.pb.cc",
+                                   "/tmp/project/.build/pb/a.pb.h"},
+          std::vector<std::string>{"/tmp/project/a.proto"},
+          ranges::views::single(builder::CustomCommandLine::Make(
+              {"protoc", "--cpp_out=/tmp/project/.build/pb", "a.proto"})),
+          "/tmp/project/.build/pb/protoc.stamp");
+    }
+
+    const auto &content = writer_factory.Files[path.Stringify()];
+    REQUIRE(absl::StrContains(
+        content,
+        "ifneq ($(filter grouped-target,$(.FEATURES)),)\n"
+        "$(WORKING_FOLDER)/a.pb.cc $(WORKING_FOLDER)/a.pb.h &: "
+        "/tmp/project/a.proto\n"
+        "\tprotoc --cpp_out=$(WORKING_FOLDER) a.proto\n"
+        "else\n"));
+    // make before 4.3 reads `&:` as independent targets, which run protoc
+    // once per output; it updates one stamp instead
+    REQUIRE(absl::StrContains(
+        content,
+        "$(WORKING_FOLDER)/protoc.stamp: /tmp/project/a.proto \\\n"
+        "\t$(if $(filter-out $(wildcard $(WORKING_FOLDER)/a.pb.cc "
+        "$(WORKING_FOLDER)/a.pb.h),$(WORKING_FOLDER)/a.pb.cc "
+        "$(WORKING_FOLDER)/a.pb.h),$(WORKING_FOLDER)/protoc.stamp.force)\n"
+        "\tprotoc --cpp_out=$(WORKING_FOLDER) a.proto\n"
+        "\t@touch $(WORKING_FOLDER)/protoc.stamp\n"));
+    REQUIRE(absl::StrContains(content,
+                              ".PHONY: $(WORKING_FOLDER)/protoc.stamp.force\n"
+                              "$(WORKING_FOLDER)/a.pb.cc "
+                              "$(WORKING_FOLDER)/a.pb.h: "
+                              "$(WORKING_FOLDER)/protoc.stamp ;\n"
+                              "endif\n"));
+  }
+}
+
+}  // namespace jk::core::generators::testing
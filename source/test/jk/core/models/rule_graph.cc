@@ -0,0 +1,53 @@
+// Copyright (c) 2020 - present, Hawtian Wang (twistoy.wang@gmail.com)
+//
+
+#include "jk/core/models/rule_graph.hh"
+
+#include <catch.hpp>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace jk::core::models::testing {
+
+TEST_CASE("RuleGraphTest", "[core][models][rule_graph]") {
+  // 0 -> 1 -> 3
+  //  \-> 2 -/
+  // 4 -> 2
+  RuleGraph graph(5, {{0, 1}, {0, 2}, {1, 3}, {2, 3}, {4, 2}});
+
+  SECTION("edges") {
+    REQUIRE(graph.Size() == 5);
+    REQUIRE(std::vector(graph.Dependencies(0).begin(),
+                        graph.Dependencies(0).end()) ==
+            std::vector<uint32_t>{1, 2});
+    REQUIRE(graph.Dependencies(3).empty());
+    REQUIRE(std::vector(graph.Dependents(2).begin(),
+                        graph.Dependents(2).end()) ==
+            std::vector<uint32_t>{0, 4});
+    REQUIRE(graph.Rule(0) == nullptr);
+  }
+
+  SECTION("closure in dfs pre-order") {
+    REQUIRE(graph.Closure(0) == std::vector<uint32_t>{0, 1, 3, 2});
+    REQUIRE(graph.Closure(std::vector<uint32_t>{4, 1}) ==
+            std::vector<uint32_t>{4, 2, 3, 1});
+  }
+
+  SECTION("reverse closure") {
+    REQUIRE(graph.ReverseClosure(std::vector<uint32_t>{3}) ==
+            std::vector<uint32_t>{3, 1, 2, 0, 4});
+  }
+
+  SECTION("paths") {
+    std::vector<uint32_t> from{4, 0}, to{3};
+    REQUIRE(graph.SomePath(from, to) == std::vector<uint32_t>{4, 2, 3});
+    REQUIRE(graph.SomePath(to, from).empty());
+    REQUIRE(graph.AllPaths(from, to) == std::vector<uint32_t>{4, 2, 3, 0, 1});
+    REQUIRE(graph.AllPaths(std::vector<uint32_t>{0},
+                           std::vector<uint32_t>{2}) ==
+            std::vector<uint32_t>{0, 2});
+  }
+}
+
+}  // namespace jk::core::models::testing
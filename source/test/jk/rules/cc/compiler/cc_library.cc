@@ -4,9 +4,11 @@
 #include "jk/impls/rules/cc_library.hh"
 
 #include <memory>
+#include <optional>
 #include <sstream>
 #include <string>
 #include <unordered_set>
+#include <utility>
 #include <vector>
 
 #include "boost/dll.hpp"
@@ -15,17 +17,23 @@
 #include "jk/core/executor/worker_pool.hh"
 #include "jk/core/filesystem/expander.hh"
 #include "jk/core/filesystem/project.hh"
+#include "jk/core/generators/compiledb.hh"
 #include "jk/core/interfaces/writer.hh"
 #include "jk/core/models/build_package.hh"
 #include "jk/core/models/build_package_factory.hh"
 #include "jk/core/models/build_rule.hh"
 #include "jk/core/models/session.hh"
+#include "jk/impls/compilers/compiledb/cc_library_compiler.hh"
 #include "jk/impls/compilers/makefile/cc_library_compiler.hh"
+#include "jk/impls/models/cc/source_file.hh"
 #include "jk/impls/rules/cc_library.hh"
 #include "jk/impls/writers/buffer_writer.hh"
 #include "jk/utils/array.hh"
 #include "jk/utils/kwargs.hh"
 #include "jk/utils/str.hh"
+#include "nlohmann/json.hpp"
+#include "pybind11/embed.h"
+#include "pybind11/eval.h"
 #include "test/jk/core/compile/fake_buffer_writer.hh"
 #include "test/jk/core/compile/nop_expander.hh"
 
@@ -337,6 +345,139 @@ TEST_CASE("compiler.makefile.cc_library.target_with_dep",  // {{{
 
 */
 
+//! Exposes unity batching of the makefile compiler.
+struct UnityCompiler : public compilers::makefile::CCLibraryCompiler {
+  using CCLibraryCompiler::make_unity_batches;
+};
+
+TEST_CASE("compiler.makefile.cc_library.unity_batches",
+          "[compiler][makefile][cc_library]") {
+  std::optional<pybind11::scoped_interpreter> interpreter;
+  if (!Py_IsInitialized()) {
+    interpreter.emplace();
+  }
+
+  auto root = common::AbsolutePath{"/tmp/jk-test/unity"};
+
+  core::models::Session session;
+  session.Project = std::make_unique<core::filesystem::JKProject>(root);
+  auto writer_factory = std::make_unique< ::jk::test::FakeBufferWriterFactory>();
+  auto files          = &writer_factory->Files;
+  session.WriterFactory = std::move(writer_factory);
+
+  core::models::BuildPackageFactory package_factory;
+  auto package = package_factory.Package("lib").first;
+  rules::CCLibrary rule(package, utils::Kwargs(pybind11::kwargs(
+                                     pybind11::eval("dict(name='lib')"))));
+  rule.ExpandedSourceFiles = {"a.cc", "b.cc", "c.cc", "d.cc", "e.c", "f.cc"};
+
+  auto working_folder = root.Sub(".build", "lib");
+  UnityCompiler compiler;
+
+  // batches, and names of sources compiled as usual
+  auto make_batches = [&]() {
+    std::vector<std::unique_ptr<models::cc::SourceFile>> source_files;
+    for (const auto &filename : rule.ExpandedSourceFiles) {
+      source_files.push_back(
+          std::make_unique<models::cc::SourceFile>(filename, &rule));
+    }
+    auto batches = compiler.make_unity_batches(&session, working_folder, &rule,
+                                               &source_files);
+
+    std::vector<std::string> rest;
+    for (const auto &sf : source_files) {
+      rest.push_back(sf->FullQualifiedPath.Path.filename().string());
+    }
+    return std::make_pair(std::move(batches), rest);
+  };
+
+  auto members = [](const auto &batch) {
+    std::vector<std::string> res;
+    for (const auto &sf : batch.Members) {
+      res.push_back(sf->FullQualifiedPath.Path.filename().string());
+    }
+    return res;
+  };
+
+  SECTION("disabled") {
+    auto [batches, rest] = make_batches();
+    REQUIRE(batches.empty());
+    REQUIRE(rest.size() == 6);
+  }
+
+  SECTION("batch size") {
+    rule.UnityBatch      = 2;
+    auto [batches, rest] = make_batches();
+
+    REQUIRE(batches.size() == 2);
+    REQUIRE(members(batches[0]) == std::vector<std::string>{"a.cc", "b.cc"});
+    REQUIRE(members(batches[1]) == std::vector<std::string>{"c.cc", "d.cc"});
+    // a c source is never merged, the last batch only has f.cc
+    REQUIRE(rest == std::vector<std::string>{"e.c", "f.cc"});
+
+    auto unity_file = working_folder.Sub("unity", "unity_0.cc").Stringify();
+    REQUIRE(files->contains(unity_file));
+    REQUIRE(files->at(unity_file).find(root.Sub("lib", "b.cc").Stringify()) !=
+            std::string::npos);
+
+    REQUIRE(batches[1]
+                .Source->ResolveFullQualifiedObjectPath(working_folder, "DEBUG")
+                .Stringify() ==
+            working_folder.Sub("DEBUG", "unity", "unity_1.cc.o").Stringify());
+    REQUIRE(batches[1]
+                .Source->ResolveFullQualifiedDotDPath(working_folder, "DEBUG")
+                .Stringify() ==
+            working_folder.Sub("DEBUG", "unity", "unity_1.cc.d").Stringify());
+  }
+
+  SECTION("default batch size of unity build") {
+    session.UnityBuild        = true;
+    session.DefaultUnityBatch = 8;
+    auto [batches, rest]      = make_batches();
+
+    REQUIRE(batches.size() == 1);
+    REQUIRE(members(batches[0]) ==
+            std::vector<std::string>{"a.cc", "b.cc", "c.cc", "d.cc", "f.cc"});
+    REQUIRE(rest == std::vector<std::string>{"e.c"});
+  }
+
+  SECTION("excludes and always compile files") {
+    rule.UnityBatch = 2;
+    rule.ExpandedUnityExcludeFiles.insert(root.Sub("lib", "b.cc").Stringify());
+    rule.ExpandedAlwaysCompileFiles.insert(
+        root.Sub("lib", "c.cc").Stringify());
+    auto [batches, rest] = make_batches();
+
+    REQUIRE(batches.size() == 1);
+    REQUIRE(members(batches[0]) == std::vector<std::string>{"a.cc", "d.cc"});
+    REQUIRE(rest == std::vector<std::string>{"b.cc", "c.cc", "e.c", "f.cc"});
+  }
+
+  SECTION("single member") {
+    rule.UnityBatch          = 2;
+    rule.ExpandedSourceFiles = {"a.cc", "e.c"};
+    auto [batches, rest]     = make_batches();
+
+    REQUIRE(batches.empty());
+    REQUIRE(rest == std::vector<std::string>{"e.c", "a.cc"});
+  }
+
+  SECTION("compiledb keeps members") {
+    session.UnityBuild          = true;
+    session.CompilationDatabase =
+        std::make_unique<core::generators::Compiledb>(root);
+    compilers::compiledb::CCLibraryCompiler().Compile(&session, {}, &rule);
+
+    auto doc = nlohmann::json::parse(session.CompilationDatabase->dump());
+    std::vector<std::string> compiled;
+    for (const auto &value : doc) {
+      compiled.push_back(value["file"].get<std::string>());
+    }
+    REQUIRE(compiled.size() == 6);
+    REQUIRE(compiled.front() == root.Sub("lib", "a.cc").Stringify());
+  }
+}
+
 }  // namespace jk::impls::cc::test
 
 // vim: fdm=marker
@@ -0,0 +1,133 @@
+// Copyright (c) 2020 - present, Hawtian Wang (twistoy.wang@gmail.com)
+//
+
+#include "jk/utils/kwargs.hh"
+
+#include <optional>
+#include <string>
+#include <string_view>
+
+#include "catch.hpp"
+#include "jk/core/error.h"
+#include "pybind11/embed.h"
+#include "pybind11/eval.h"
+
+namespace jk::utils::test {
+
+//! Arguments of `dict(...)` expression `expr`
+static Kwargs make_kwargs(const std::string &expr) {
+  return Kwargs(pybind11::kwargs(pybind11::eval(expr)));
+}
+
+TEST_CASE("Kwargs", "[utils][kwargs]") {
+  std::optional<pybind11::scoped_interpreter> interpreter;
+  if (!Py_IsInitialized()) {
+    interpreter.emplace();
+  }
+
+  using Kind = Kwargs::ValueKind;
+
+  SECTION("nested lists and dicts") {
+    auto kwargs = make_kwargs(
+        "dict(a=[['x', 'y'], {'k': ['v1', 'v2']}], d={'o': {'i': 1}})");
+
+    auto a = kwargs.Find("a");
+    REQUIRE(a);
+    REQUIRE(a->Kind() == Kind::kList);
+    REQUIRE(a->Size() == 2);
+
+    auto inner = a->At(0).Strings();
+    REQUIRE(inner);
+    REQUIRE(inner->size() == 2);
+    REQUIRE((*inner)[0] == "x");
+    REQUIRE((*inner)[1] == "y");
+
+    auto [key, value] = a->At(1).Item(0);
+    REQUIRE(key == "k");
+    REQUIRE(value.Strings()->size() == 2);
+    REQUIRE((*value.Strings())[1] == "v2");
+
+    auto [outer_key, outer] = kwargs.Find("d")->Item(0);
+    REQUIRE(outer_key == "o");
+    REQUIRE(outer.Kind() == Kind::kDict);
+    REQUIRE(outer.Item(0).first == "i");
+    REQUIRE(outer.Item(0).second.Integer() == 1);
+
+    REQUIRE(a->ToString() == R"([["x", "y"], {k: ["v1", "v2"]}])");
+  }
+
+  SECTION("mixed list") {
+    auto kwargs = make_kwargs("dict(srcs=['a.cc', 1, 'b.cc', ['c.cc']])");
+
+    auto srcs = kwargs.Find("srcs");
+    REQUIRE_FALSE(srcs->Strings());
+    REQUIRE(srcs->Size() == 4);
+    REQUIRE(srcs->At(0).String() == "a.cc");
+    REQUIRE(srcs->At(1).Integer() == 1);
+    REQUIRE(srcs->At(2).String() == "b.cc");
+    REQUIRE(srcs->At(3).Kind() == Kind::kList);
+    REQUIRE_THROWS_AS(kwargs.ListOptional("srcs"), core::JKBuildError);
+
+    auto empty = make_kwargs("dict(srcs=[])");
+    REQUIRE(empty.Find("srcs")->Strings());
+    REQUIRE(empty.ListRequired("srcs").empty());
+  }
+
+  SECTION("bool is not int") {
+    auto kwargs = make_kwargs("dict(flag=True, off=False, n=1)");
+
+    REQUIRE(kwargs.Find("flag")->Kind() == Kind::kBoolean);
+    REQUIRE(kwargs.Find("n")->Kind() == Kind::kInteger);
+    REQUIRE(kwargs.BooleanRequired("flag"));
+    REQUIRE_FALSE(kwargs.BooleanRequired("off"));
+    REQUIRE(kwargs.IntegerOptional("n", 0) == 1);
+    REQUIRE_THROWS_AS(kwargs.BooleanRequired("n"), core::JKBuildError);
+    REQUIRE_THROWS_AS(kwargs.IntegerOptional("flag", 0), core::JKBuildError);
+    REQUIRE(kwargs.IntegerOptional("missing", 7) == 7);
+  }
+
+  SECTION("dict with several items") {
+    auto kwargs = make_kwargs("dict(env={'A': '1', 'B': ['2', '3'], 'C': 4})");
+
+    auto env = kwargs.Find("env");
+    REQUIRE(env->Size() == 3);
+    REQUIRE(env->Item(0).first == "A");
+    REQUIRE(env->Item(0).second.String() == "1");
+    REQUIRE(env->Item(1).first == "B");
+    REQUIRE(env->Item(1).second.Strings()->size() == 2);
+    REQUIRE(env->Item(2).first == "C");
+    REQUIRE(env->Item(2).second.Integer() == 4);
+  }
+
+  SECTION("strings larger than a chunk") {
+    // larger than the chunk size of the arena, and many small strings
+    // crossing chunk boundaries
+    auto kwargs = make_kwargs(
+        "dict(big='z' * 5000, names=['n%04d' % i for i in range(1000)], "
+        "after='x')");
+
+    auto big = kwargs.StringRequired("big");
+    REQUIRE(big.size() == 5000);
+    REQUIRE(big == std::string(5000, 'z'));
+
+    auto names = kwargs.ListRequired("names");
+    REQUIRE(names.size() == 1000);
+    REQUIRE(names[0] == "n0000");
+    REQUIRE(names[999] == "n0999");
+    REQUIRE(kwargs.StringRequired("after") == "x");
+  }
+
+  SECTION("release") {
+    auto kwargs = make_kwargs("dict(name='foo', deps=['a'])");
+    REQUIRE(kwargs.StringRequired("name") == "foo");
+    REQUIRE(kwargs.Stringify() == R"(Kwargs {name: "foo", deps: ["a"]})");
+
+    kwargs.Release();
+    REQUIRE_FALSE(kwargs.Find("name"));
+    REQUIRE(kwargs.ListOptional("deps").empty());
+    REQUIRE(kwargs.Stringify() == "Kwargs {}");
+    REQUIRE_THROWS_AS(kwargs.StringRequired("name"), core::JKBuildError);
+  }
+}
+
+}  // namespace jk::utils::test
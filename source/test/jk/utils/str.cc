@@ -16,6 +16,19 @@ TEST_CASE("Check ending", "[utils]") {
   REQUIRE_FALSE(StringEndsWith("TESTABC", "ABCD"));
 }
 
+TEST_CASE("Check beginning", "[utils]") {
+  REQUIRE(StringStartsWith("TESTABC", "TEST"));
+  REQUIRE(StringStartsWith("TESTABC", ""));
+  REQUIRE_FALSE(StringStartsWith("TESTABC", "ABC"));
+  REQUIRE_FALSE(StringStartsWith("TESTTEST", "TEST1"));
+}
+
+TEST_CASE("Compare ignoring case", "[utils]") {
+  REQUIRE(EqualIgnoreCase("abcDEF", "ABCdef"));
+  REQUIRE_FALSE(EqualIgnoreCase("abc", "abd"));
+  REQUIRE_FALSE(EqualIgnoreCase("abc", "abcd"));
+}
+
 TEST_CASE("Join String", "[utils]") {
   std::vector<std::string> vec{"a", "b", "c", "d"};
   REQUIRE(JoinString(", ", vec.begin(), vec.end()) == "a, b, c, d");